@@ -0,0 +1,95 @@
+// bench.c — Benchmark runner: timer, random numbers and the command table
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#define _POSIX_C_SOURCE 199309L
+#include <time.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+
+#include "bench.h"
+
+double bench_time_ms(void) {
+#ifdef _WIN32
+    static LARGE_INTEGER freq;
+    if (freq.QuadPart == 0) QueryPerformanceFrequency(&freq);
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return (double)now.QuadPart / (double)freq.QuadPart * 1000.0;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1e6;
+#endif
+}
+
+// xorshift32: rand() differs between C runtimes, this doesn't
+static unsigned int g_rng = 1;
+
+void bench_seed(unsigned int seed) {
+    g_rng = seed ? seed : 1;
+}
+
+static unsigned int bench_next(void) {
+    g_rng ^= g_rng << 13;
+    g_rng ^= g_rng >> 17;
+    g_rng ^= g_rng << 5;
+    return g_rng;
+}
+
+float bench_randf(float min, float max) {
+    return min + (float)(bench_next() >> 8) / 16777216.0f * (max - min);
+}
+
+int bench_randi(int n) {
+    return (int)(bench_next() % (unsigned int)n);
+}
+
+typedef struct {
+    const char* name;
+    int (*run)(int argc, char** argv);
+    const char* what;
+} BenchCommand;
+
+static const BenchCommand g_commands[] = {
+    { "churn",   bench_churn,   "Spawn/destroy cost at 1k, 10k and 100k live entities" },
+    { "live",    bench_live,    "physics_update cost: 1k live of 9k spawned vs 1k of 1k" },
+    { "simd",    bench_simd,    "Integration + friction kernel per SIMD level, 1k/10k/100k bodies" },
+    { "narrow",  bench_narrow,  "Circle/circle and circle/rect kernels vs the Entity checks, per SIMD level" },
+    { "threads", bench_threads, "physics_update on 10k bouncing barrels at 1-16 threads" },
+    { "hash",    bench_hash,    "Spatial hash vs uniform grid, dense and sparse 10k-body worlds" },
+    { "mixed",   bench_mixed,   "16 px + 512 px colliders: coarse/fine grid, quadtree, hgrid" },
+    { "statics", bench_statics, "physics_update with 5000 static walls and 10/100/1000 movers" },
+    { "bvh",     bench_bvh,     "Grid vs AABB tree static layer: 5000 walls, pairs and region queries" },
+};
+
+#define COMMAND_COUNT ((int)(sizeof(g_commands) / sizeof(g_commands[0])))
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        printf("usage: bench <name> [args]   (or: bench all)\n\n");
+        for (int i = 0; i < COMMAND_COUNT; i++) {
+            printf("  %-12s %s\n", g_commands[i].name, g_commands[i].what);
+        }
+        return 0;
+    }
+
+    int all = strcmp(argv[1], "all") == 0;
+    int ran = 0, failed = 0;
+    for (int i = 0; i < COMMAND_COUNT; i++) {
+        if (!all && strcmp(argv[1], g_commands[i].name) != 0) continue;
+        printf("--- %s ---\n", g_commands[i].name);
+        if (g_commands[i].run(argc - 2, argv + 2) != 0) failed++;
+        ran++;
+    }
+
+    if (ran == 0) {
+        printf("Unknown benchmark '%s' (run without arguments for the list)\n", argv[1]);
+        return 1;
+    }
+    return failed ? 1 : 0;
+}
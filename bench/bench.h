@@ -0,0 +1,30 @@
+// bench.h — Engine benchmarks (run as: bench <name> [args], or bench to list them)
+//
+// Each benchmark drives the engine modules directly (no window or renderer), so
+// numbers compare engine code paths on the same machine, not frame times.
+//
+#ifndef BENCH_H
+#define BENCH_H
+
+// Milliseconds from a monotonic high-resolution clock
+double bench_time_ms(void);
+
+// Deterministic random numbers (same sequence on every platform)
+void bench_seed(unsigned int seed);
+float bench_randf(float min, float max);
+int bench_randi(int n);  // 0 .. n - 1
+
+// --- BENCHMARKS ---
+// Each returns 0 on success (non-zero if a result check failed)
+
+int bench_churn(int argc, char** argv);        // bench_entities.c
+int bench_live(int argc, char** argv);
+int bench_simd(int argc, char** argv);         // bench_physics.c
+int bench_threads(int argc, char** argv);
+int bench_narrow(int argc, char** argv);
+int bench_hash(int argc, char** argv);         // bench_spatial.c
+int bench_mixed(int argc, char** argv);
+int bench_statics(int argc, char** argv);
+int bench_bvh(int argc, char** argv);
+
+#endif
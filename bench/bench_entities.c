@@ -0,0 +1,105 @@
+// bench_entities.c — Entity storage benchmarks
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "entity.h"
+#include "physics.h"
+
+// --- CHURN ---
+// Bullets/particles: with 'live' entities alive, destroy a random one and spawn
+// a replacement, over and over. With the free list, the cost per spawn+destroy
+// should not depend on how many entities are alive (at 100k the random victims
+// miss the cache, which shows; destroying them in slot order stays flat)
+
+static double churn_run(int live, int ops) {
+    GameState* state = calloc(1, sizeof(GameState));
+    Entity** alive = malloc((size_t)live * sizeof(Entity*));
+    if (!state || !alive) {
+        free(state);
+        free(alive);
+        return -1.0;
+    }
+
+    for (int i = 0; i < live; i++) alive[i] = spawn_ball(state, 0.0f, 0.0f, 4.0f, COLOR_RED);
+
+    double start = bench_time_ms();
+    for (int i = 0; i < ops; i++) {
+        int k = bench_randi(live);
+        entity_destroy(state, alive[k]);
+        alive[k] = spawn_ball(state, 0.0f, 0.0f, 4.0f, COLOR_RED);
+    }
+    double elapsed = bench_time_ms() - start;
+
+    entity_shutdown(state);
+    free(state);
+    free(alive);
+    return elapsed * 1e6 / ops;
+}
+
+int bench_churn(int argc, char** argv) {
+    int ops = argc > 0 ? atoi(argv[0]) : 1000000;
+    int sizes[] = { 1000, 10000, 100000 };
+
+    bench_seed(1);
+    for (int i = 0; i < 3; i++) {
+        double ns = churn_run(sizes[i], ops);
+        if (ns < 0.0) {
+            printf("Out of memory\n");
+            return 1;
+        }
+        printf("%7d live: %6.1f ns per destroy + spawn (%d ops)\n", sizes[i], ns, ops);
+    }
+    return 0;
+}
+
+// --- LIVE LIST ---
+// A level that spawned 9k entities and destroyed 8k of them against one that only
+// ever had 1k: engine loops walk GameState.live, so both should cost the same
+
+static double live_run(int spawned, int kept, int steps) {
+    GameState* state = calloc(1, sizeof(GameState));
+    Entity** spawned_list = malloc((size_t)spawned * sizeof(Entity*));
+    if (!state || !spawned_list) {
+        free(state);
+        free(spawned_list);
+        return -1.0;
+    }
+
+    bench_seed(2);
+    for (int i = 0; i < spawned; i++) {
+        Entity* e = spawn_ball(state, bench_randf(0.0f, 2000.0f), bench_randf(0.0f, 2000.0f), 3.0f, COLOR_RED);
+        e->vel_x = bench_randf(-100.0f, 100.0f);
+        e->vel_y = bench_randf(-100.0f, 100.0f);
+        spawned_list[i] = e;
+    }
+    for (int i = 0; i < spawned - kept; i++) entity_destroy(state, spawned_list[i]);
+
+    physics_init(2000.0f, 2000.0f, 64.0f);
+    physics_update(state, 1.0f / 60.0f);  // Warm up the buffers
+
+    double start = bench_time_ms();
+    for (int i = 0; i < steps; i++) physics_update(state, 1.0f / 60.0f);
+    double elapsed = bench_time_ms() - start;
+
+    physics_shutdown();
+    entity_shutdown(state);
+    free(state);
+    free(spawned_list);
+    return elapsed / steps;
+}
+
+int bench_live(int argc, char** argv) {
+    int steps = argc > 0 ? atoi(argv[0]) : 300;
+
+    double sparse = live_run(9000, 1000, steps);
+    double packed = live_run(1000, 1000, steps);
+    if (sparse < 0.0 || packed < 0.0) {
+        printf("Out of memory\n");
+        return 1;
+    }
+    printf("1k live, 9k slots used: %.3f ms per physics_update\n", sparse);
+    printf("1k live, 1k slots used: %.3f ms per physics_update\n", packed);
+    return 0;
+}
@@ -0,0 +1,274 @@
+// bench_physics.c — Physics kernel benchmarks
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "entity.h"
+#include "physics.h"
+#include "physics_simd.h"
+
+// --- INTEGRATION ---
+// simd_integrate at each supported level on 1k/10k/100k bodies (position update
+// plus friction). The correctness side is tests/test_physics_simd.c
+
+int bench_simd(int argc, char** argv) {
+    int total = argc > 0 ? atoi(argv[0]) : 20000000;  // Body updates per measurement
+    int sizes[] = { 1000, 10000, 100000 };
+    SimdLevel best = simd_detect();
+
+    printf("Detected: %s\n", simd_level_name(best));
+    bench_seed(3);
+    for (int s = 0; s < 3; s++) {
+        int n = sizes[s];
+        float* data = malloc((size_t)n * 5 * sizeof(float));
+        float* work = malloc((size_t)n * 5 * sizeof(float));
+        if (!data || !work) {
+            free(data);
+            free(work);
+            printf("Out of memory\n");
+            return 1;
+        }
+        for (int i = 0; i < n * 4; i++) data[i] = bench_randf(-300.0f, 300.0f);
+        for (int i = n * 4; i < n * 5; i++) data[i] = bench_randf(0.0f, 600.0f);
+
+        double scalar_ms = 0.0;
+        printf("%6d bodies:", n);
+        for (int level = SIMD_LEVEL_SCALAR; level <= (int)best; level++) {
+            simd_set_level((SimdLevel)level);
+
+            // Rounds of 100 steps from the same start, so every size measures
+            // bodies that are still moving (not ones friction already stopped)
+            int rounds = total / (n * 100);
+            if (rounds < 1) rounds = 1;
+            double elapsed = 0.0;
+            for (int r = 0; r < rounds; r++) {
+                memcpy(work, data, (size_t)n * 5 * sizeof(float));
+                double start = bench_time_ms();
+                for (int step = 0; step < 100; step++) {
+                    simd_integrate(work, work + n, work + 2 * n, work + 3 * n, work + 4 * n, n, 1.0f / 600.0f);
+                }
+                elapsed += bench_time_ms() - start;
+            }
+            double ms = elapsed / (rounds * 100.0);
+            if (level == SIMD_LEVEL_SCALAR) scalar_ms = ms;
+            printf("  %s %.4f ms (%.2fx)", simd_level_name((SimdLevel)level), ms, scalar_ms / ms);
+        }
+        printf("\n");
+        free(data);
+        free(work);
+    }
+    simd_set_level(best);
+    return 0;
+}
+
+// --- THREAD SCALING ---
+// physics_update on 10k bouncing barrels (r = 16, elastic, no friction) in a
+// 4000 x 4000 walled world, at 1, 2, 4, 8 and 16 threads (physics_set_threads).
+// The checksum of positions and velocities must match for every count
+
+static double threads_run(int threads, int steps, double* checksum) {
+    const float world = 4000.0f;
+    GameState* state = calloc(1, sizeof(GameState));
+    if (!state) return -1.0;
+
+    bench_seed(1);
+    physics_set_threads(threads);
+    physics_init(world, world, 64.0f);
+    spawn_world_bounds(state, world, world);
+    for (int i = 0; i < 10000; i++) {
+        Entity* b = spawn_ball(state, bench_randf(100.0f, world - 100.0f),
+                               bench_randf(100.0f, world - 100.0f), 16.0f, COLOR_RED);
+        if (!b) break;
+        b->mass = 0.2f;
+        b->friction = 0.0f;
+        b->restitution = 1.0f;
+        b->collider.layer = LAYER_ENEMY;
+        b->collider.mask = LAYER_WALL | LAYER_ENEMY | LAYER_PLAYER;
+        b->vel_x = bench_randf(-200.0f, 200.0f);
+        b->vel_y = bench_randf(-200.0f, 200.0f);
+    }
+    for (int i = 0; i < 20; i++) physics_update(state, 1.0f / 60.0f);
+
+    double start = bench_time_ms();
+    for (int i = 0; i < steps; i++) physics_update(state, 1.0f / 60.0f);
+    double elapsed = bench_time_ms() - start;
+
+    double sum = 0.0;
+    for (int i = 0; i < state->live_count; i++) {
+        Entity* e = entity_at(state, state->live[i]);
+        sum += e->x + e->y * 0.5 + e->vel_x;
+    }
+    *checksum = sum;
+
+    physics_shutdown();
+    entity_shutdown(state);
+    free(state);
+    return elapsed / steps;
+}
+
+int bench_threads(int argc, char** argv) {
+    int steps = argc > 0 ? atoi(argv[0]) : 300;
+    double base = 0.0;
+
+    for (int threads = 1; threads <= 16; threads *= 2) {
+        double checksum = 0.0;
+        double ms = threads_run(threads, steps, &checksum);
+        if (ms < 0.0) {
+            printf("Out of memory\n");
+            return 1;
+        }
+        if (threads == 1) base = ms;
+        printf("%2d thread(s): %.3f ms per step (%.2fx), checksum %.6f\n",
+               threads, ms, base / ms, checksum);
+    }
+    physics_set_threads(1);
+    return 0;
+}
+
+// --- NARROW-PHASE KERNELS ---
+// Per shape combination: check_circle_circle / check_circle_rect on Entity pairs
+// against simd_circle_circle / simd_circle_rect on the packed arrays at each
+// supported level. 10k pairs in random order over 20k bodies, each B placed
+// within 'spread' of its A: close pairs mostly hit, far ones mostly miss
+
+#define NARROW_PAIRS 10000
+
+typedef struct {
+    Entity* entities;           // A bodies at [0, n), B bodies at [n, 2n)
+    float *cx, *cy, *hw, *hh;   // The same, packed (hw = radius for circles)
+    int *ia, *ib, *slot;        // Pair k: ia[k] vs ib[k], result to out[slot[k]]
+    Manifold* out;
+} NarrowScene;
+
+static void narrow_scene_free(NarrowScene* s) {
+    free(s->entities);
+    free(s->cx); free(s->cy); free(s->hw); free(s->hh);
+    free(s->ia); free(s->ib); free(s->slot);
+    free(s->out);
+}
+
+// B is a circle (circle/circle) or a rect (circle/rect); A is always a circle
+static int narrow_scene_init(NarrowScene* s, int rect_b, float spread) {
+    int n = NARROW_PAIRS;
+    memset(s, 0, sizeof(NarrowScene));
+    s->entities = calloc((size_t)n * 2, sizeof(Entity));
+    s->cx = malloc((size_t)n * 2 * sizeof(float));
+    s->cy = malloc((size_t)n * 2 * sizeof(float));
+    s->hw = malloc((size_t)n * 2 * sizeof(float));
+    s->hh = malloc((size_t)n * 2 * sizeof(float));
+    s->ia = malloc((size_t)n * sizeof(int));
+    s->ib = malloc((size_t)n * sizeof(int));
+    s->slot = malloc((size_t)n * sizeof(int));
+    s->out = malloc((size_t)n * sizeof(Manifold));
+    if (!s->entities || !s->cx || !s->cy || !s->hw || !s->hh ||
+        !s->ia || !s->ib || !s->slot || !s->out) {
+        narrow_scene_free(s);
+        return 0;
+    }
+
+    for (int i = 0; i < n * 2; i++) {
+        Entity* e = &s->entities[i];
+        if (i < n) {
+            e->x = bench_randf(0.0f, 4000.0f);
+            e->y = bench_randf(0.0f, 4000.0f);
+        } else {
+            e->x = s->entities[i - n].x + bench_randf(-spread, spread);
+            e->y = s->entities[i - n].y + bench_randf(-spread, spread);
+        }
+        if (i >= n && rect_b) {
+            e->collider.type = SHAPE_RECT;
+            e->collider.rect.width = bench_randf(16.0f, 64.0f);
+            e->collider.rect.height = bench_randf(16.0f, 64.0f);
+            s->hw[i] = e->collider.rect.width / 2.0f;
+            s->hh[i] = e->collider.rect.height / 2.0f;
+        } else {
+            e->collider.type = SHAPE_CIRCLE;
+            e->collider.circle.radius = bench_randf(8.0f, 24.0f);
+            s->hw[i] = s->hh[i] = e->collider.circle.radius;
+        }
+        s->cx[i] = e->x;
+        s->cy[i] = e->y;
+    }
+
+    // Pairs in random order, so neither path streams through memory
+    for (int k = 0; k < n; k++) s->ia[k] = k;
+    for (int k = n - 1; k > 0; k--) {
+        int j = bench_randi(k + 1);
+        int t = s->ia[k]; s->ia[k] = s->ia[j]; s->ia[j] = t;
+    }
+    for (int k = 0; k < n; k++) {
+        s->ib[k] = s->ia[k] + n;
+        s->slot[k] = k;
+    }
+    return 1;
+}
+
+// ns per pair over 'rounds' passes; *hits gets the hits of one pass
+static double narrow_entity_path(NarrowScene* s, int rect_b, int rounds, int* hits) {
+    double start = bench_time_ms();
+    int count = 0;
+    for (int r = 0; r < rounds; r++) {
+        count = 0;
+        for (int k = 0; k < NARROW_PAIRS; k++) {
+            const Entity* a = &s->entities[s->ia[k]];
+            const Entity* b = &s->entities[s->ib[k]];
+            Manifold m = rect_b ? check_circle_rect(a, b) : check_circle_circle(a, b);
+            if (m.hit) s->out[count++] = m;
+        }
+    }
+    *hits = count;
+    return (bench_time_ms() - start) * 1e6 / ((double)rounds * NARROW_PAIRS);
+}
+
+static double narrow_kernel_path(NarrowScene* s, int rect_b, int rounds, int* hits) {
+    double start = bench_time_ms();
+    int count = 0;
+    for (int r = 0; r < rounds; r++) {
+        if (rect_b) {
+            count = simd_circle_rect(s->cx, s->cy, s->hw, s->hh, s->ia, s->ib,
+                                     NARROW_PAIRS, s->slot, s->out);
+        } else {
+            count = simd_circle_circle(s->cx, s->cy, s->hw, s->ia, s->ib,
+                                       NARROW_PAIRS, s->slot, s->out);
+        }
+    }
+    *hits = count;
+    return (bench_time_ms() - start) * 1e6 / ((double)rounds * NARROW_PAIRS);
+}
+
+int bench_narrow(int argc, char** argv) {
+    int rounds = argc > 0 ? atoi(argv[0]) : 500;
+    SimdLevel best = simd_detect();
+    const char* shapes[] = { "circle/circle", "circle/rect" };
+    float spreads[] = { 32.0f, 128.0f };
+
+    bench_seed(7);
+    for (int shape = 0; shape < 2; shape++) {
+        for (int sp = 0; sp < 2; sp++) {
+            NarrowScene scene;
+            if (!narrow_scene_init(&scene, shape, spreads[sp])) {
+                printf("Out of memory\n");
+                return 1;
+            }
+
+            int hits = 0;
+            double entity_ns = narrow_entity_path(&scene, shape, rounds, &hits);
+            printf("%-13s  %2d%% hits: Entity path %.1f ns", shapes[shape],
+                   hits * 100 / NARROW_PAIRS, entity_ns);
+
+            for (int level = SIMD_LEVEL_SCALAR; level <= (int)best; level++) {
+                simd_set_level((SimdLevel)level);
+                int kernel_hits = 0;
+                double ns = narrow_kernel_path(&scene, shape, rounds, &kernel_hits);
+                printf(", %s %.1f ns", simd_level_name((SimdLevel)level), ns);
+                if (kernel_hits != hits) printf(" (%d hits, expected %d)", kernel_hits, hits);
+            }
+            printf(" per pair\n");
+            narrow_scene_free(&scene);
+        }
+    }
+    simd_set_level(best);
+    return 0;
+}
@@ -0,0 +1,348 @@
+// bench_spatial.c — Broad-phase benchmarks (SpatialIndex backends)
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "entity.h"
+#include "physics.h"
+#include "spatial.h"
+
+// Random balls in a w x h world ('big_every' > 0: every n-th one has 'big_radius')
+static GameState* spawn_scene(int count, float w, float h, float radius,
+                              int big_every, float big_radius) {
+    GameState* state = calloc(1, sizeof(GameState));
+    if (!state) return NULL;
+
+    for (int i = 0; i < count; i++) {
+        float r = (big_every > 0 && i % big_every == 0) ? big_radius : radius;
+        Entity* e = spawn_ball(state, bench_randf(0.0f, w), bench_randf(0.0f, h), r, COLOR_RED);
+        if (!e) break;
+        e->collider.layer = LAYER_ENEMY;
+        e->collider.mask = LAYER_ENEMY;
+    }
+    return state;
+}
+
+static void free_scene(GameState* state) {
+    entity_shutdown(state);
+    free(state);
+}
+
+// One physics-style frame: start the frame, insert every live collider, pair them.
+// Returns ms per frame averaged over 'frames' (after one warm-up frame)
+static double pair_frames(SpatialIndex* index, GameState* state, int frames, int* out_pairs) {
+    SpatialPairList pairs = {0};
+    double elapsed = 0.0;
+
+    for (int f = 0; f <= frames; f++) {
+        double start = bench_time_ms();
+        spatial_clear(index);
+        for (int i = 0; i < state->live_count; i++) spatial_insert(index, entity_at(state, state->live[i]));
+        spatial_find_pairs(index, &pairs);
+        if (f > 0) elapsed += bench_time_ms() - start;
+    }
+
+    if (out_pairs) *out_pairs = pairs.count;
+    spatial_pair_list_free(&pairs);
+    return elapsed / frames;
+}
+
+static const char* type_name(SpatialType type) {
+    switch (type) {
+        case SPATIAL_TYPE_GRID:     return "grid";
+        case SPATIAL_TYPE_HASH:     return "hash";
+        case SPATIAL_TYPE_QUADTREE: return "quadtree";
+        case SPATIAL_TYPE_SAP:      return "sap";
+        case SPATIAL_TYPE_BVH:      return "bvh";
+        case SPATIAL_TYPE_HGRID:    return "hgrid";
+    }
+    return "?";
+}
+
+// --- SPATIAL HASH ---
+// 10k balls (r = 8), 32 px cells: a dense 2000^2 world, where the bounded grid's
+// direct cell indexing should win, and a sparse 50000^2 one, where the grid
+// pays for millions of empty cells and the hash only for occupied ones
+
+int bench_hash(int argc, char** argv) {
+    int frames = argc > 0 ? atoi(argv[0]) : 20;
+    float worlds[] = { 2000.0f, 50000.0f };
+    SpatialType types[] = { SPATIAL_TYPE_GRID, SPATIAL_TYPE_HASH };
+
+    for (int w = 0; w < 2; w++) {
+        for (int t = 0; t < 2; t++) {
+            bench_seed(4);
+            GameState* state = spawn_scene(10000, worlds[w], worlds[w], 8.0f, 0, 0.0f);
+            SpatialConfig config = {0};
+            config.type = types[t];
+            config.world_width = worlds[w];
+            config.world_height = worlds[w];
+            config.cell_size = 32.0f;
+            SpatialIndex* index = state ? spatial_create(config) : NULL;
+            if (!index) {
+                if (state) free_scene(state);
+                printf("Out of memory\n");
+                return 1;
+            }
+
+            int pairs = 0;
+            double ms = pair_frames(index, state, frames, &pairs);
+            printf("%-6s %5.0f^2 world, %s: %.3f ms per frame (%d pairs)\n",
+                   w == 0 ? "dense" : "sparse", worlds[w], type_name(types[t]), ms, pairs);
+
+            spatial_destroy(index);
+            free_scene(state);
+        }
+    }
+    return 0;
+}
+
+// --- MIXED SIZES ---
+// 20000 small (16 px) movers and 8 big (512 px) ones on an 8192^2 world, 200
+// frames: a grid sized to the big colliders, a fine grid, the quadtree and HGRID
+
+static double mixed_run(SpatialType type, float cell_size, int frames, int* out_pairs) {
+    const float world = 8192.0f;
+    bench_seed(11);
+    GameState* state = spawn_scene(20000, world, world, 8.0f, 0, 0.0f);
+    if (!state) return -1.0;
+    for (int i = 0; i < 8; i++) {
+        Entity* e = spawn_ball(state, bench_randf(0.0f, world), bench_randf(0.0f, world), 256.0f, COLOR_RED);
+        if (!e) break;
+        e->collider.layer = LAYER_ENEMY;
+        e->collider.mask = LAYER_ENEMY;
+    }
+    for (int i = 0; i < state->live_count; i++) {
+        Entity* e = entity_at(state, state->live[i]);
+        float speed = e->collider.circle.radius > 100.0f ? 30.0f : 60.0f;
+        e->vel_x = bench_randf(-speed, speed);
+        e->vel_y = bench_randf(-speed, speed);
+    }
+
+    SpatialConfig config = {0};
+    config.type = type;
+    config.world_width = world;
+    config.world_height = world;
+    config.cell_size = cell_size;
+    SpatialIndex* index = spatial_create(config);
+    if (!index) {
+        free_scene(state);
+        return -1.0;
+    }
+
+    SpatialPairList pairs = {0};
+    double elapsed = 0.0;
+    long total_pairs = 0;
+    for (int f = 0; f < frames; f++) {
+        for (int i = 0; i < state->live_count; i++) {
+            Entity* e = entity_at(state, state->live[i]);
+            e->x += e->vel_x / 60.0f;
+            e->y += e->vel_y / 60.0f;
+            if (e->x < 0.0f || e->x > world) e->vel_x = -e->vel_x;
+            if (e->y < 0.0f || e->y > world) e->vel_y = -e->vel_y;
+        }
+
+        double start = bench_time_ms();
+        spatial_clear(index);
+        for (int i = 0; i < state->live_count; i++) spatial_insert(index, entity_at(state, state->live[i]));
+        total_pairs += spatial_find_pairs(index, &pairs);
+        elapsed += bench_time_ms() - start;
+    }
+
+    *out_pairs = (int)(total_pairs / frames);
+    spatial_pair_list_free(&pairs);
+    spatial_destroy(index);
+    free_scene(state);
+    return elapsed / frames;
+}
+
+int bench_mixed(int argc, char** argv) {
+    int frames = argc > 0 ? atoi(argv[0]) : 200;
+    struct { const char* name; SpatialType type; float cell; } runs[] = {
+        { "grid, 512 px cells", SPATIAL_TYPE_GRID, 512.0f },
+        { "grid, 32 px cells",  SPATIAL_TYPE_GRID, 32.0f },
+        { "quadtree",           SPATIAL_TYPE_QUADTREE, 32.0f },
+        { "hgrid",              SPATIAL_TYPE_HGRID, 0.0f },
+    };
+
+    for (int r = 0; r < 4; r++) {
+        int pairs = 0;
+        double ms = mixed_run(runs[r].type, runs[r].cell, frames, &pairs);
+        if (ms < 0.0) {
+            printf("Out of memory\n");
+            return 1;
+        }
+        printf("%-20s %.3f ms per frame (%d pairs per frame)\n", runs[r].name, ms, pairs);
+    }
+    return 0;
+}
+
+// --- STATIC LEVEL ---
+// physics_update on a level of 5000 static walls with 10, 100 and 1000 moving
+// balls. The static layer stays built between steps, so the cost should follow
+// the movers rather than the walls
+
+static double statics_run(int walls, int movers, int steps) {
+    const float world = 4000.0f;
+    GameState* state = calloc(1, sizeof(GameState));
+    if (!state) return -1.0;
+
+    bench_seed(3);
+    for (int i = 0; i < walls; i++) {
+        spawn_primitive_wall(state, bench_randf(0.0f, world), bench_randf(0.0f, world),
+                             bench_randf(8.0f, 48.0f), bench_randf(8.0f, 48.0f));
+    }
+    for (int i = 0; i < movers; i++) {
+        Entity* e = spawn_ball(state, bench_randf(0.0f, world), bench_randf(0.0f, world), 8.0f, COLOR_RED);
+        if (!e) break;
+        e->friction = 0.0f;
+        e->vel_x = bench_randf(-200.0f, 200.0f);
+        e->vel_y = bench_randf(-200.0f, 200.0f);
+    }
+
+    physics_init(world, world, 64.0f);
+    for (int i = 0; i < 20; i++) physics_update(state, 1.0f / 60.0f);
+
+    double start = bench_time_ms();
+    for (int i = 0; i < steps; i++) physics_update(state, 1.0f / 60.0f);
+    double elapsed = bench_time_ms() - start;
+
+    physics_shutdown();
+    free_scene(state);
+    return elapsed / steps;
+}
+
+int bench_statics(int argc, char** argv) {
+    int steps = argc > 0 ? atoi(argv[0]) : 200;
+    int movers[] = { 10, 100, 1000 };
+
+    for (int m = 0; m < 3; m++) {
+        double with_walls = statics_run(5000, movers[m], steps);
+        double alone = statics_run(0, movers[m], steps);
+        if (with_walls < 0.0 || alone < 0.0) {
+            printf("Out of memory\n");
+            return 1;
+        }
+        printf("%4d movers: %.3f ms per step with 5000 walls, %.3f ms without\n",
+               movers[m], with_walls, alone);
+    }
+    return 0;
+}
+
+// --- STATIC LAYER BACKEND ---
+// Level of 5000 walls (every fifth a long 200-800 px corridor wall) with 500 moving
+// balls in an 8000 px world, moving layer on a 64 px grid, static layer on the same
+// grid or an AABB tree (config.use_static_type). Frames move the balls, re-insert
+// them and find the pairs, with the walls inserted once (as the physics step does)
+// or re-inserted every frame too. Then 20k random box, point and segment queries
+
+static void bvh_layer_run(int use_tree, int reinsert, int frames) {
+    const float world = 8000.0f;
+    GameState* state = calloc(1, sizeof(GameState));
+    if (!state) return;
+
+    bench_seed(5);
+    for (int i = 0; i < 5000; i++) {
+        float x = bench_randf(0.0f, world);
+        float y = bench_randf(0.0f, world);
+        if (i % 5 == 0) {
+            spawn_primitive_wall(state, x, y, bench_randf(200.0f, 800.0f), 16.0f);
+        } else {
+            spawn_primitive_wall(state, x, y, bench_randf(16.0f, 48.0f), bench_randf(16.0f, 48.0f));
+        }
+    }
+    for (int i = 0; i < 500; i++) {
+        Entity* e = spawn_ball(state, bench_randf(0.0f, world), bench_randf(0.0f, world), 8.0f, COLOR_RED);
+        if (!e) break;
+        e->vel_x = bench_randf(-200.0f, 200.0f);
+        e->vel_y = bench_randf(-200.0f, 200.0f);
+    }
+
+    SpatialConfig config = {0};
+    config.type = SPATIAL_TYPE_GRID;
+    config.world_width = world;
+    config.world_height = world;
+    config.cell_size = 64.0f;
+    config.use_static_type = use_tree;
+    config.static_type = SPATIAL_TYPE_BVH;
+    SpatialIndex* index = spatial_create(config);
+    if (!index) {
+        free_scene(state);
+        return;
+    }
+
+    double build = bench_time_ms();
+    for (int i = 0; i < state->live_count; i++) {
+        Entity* e = entity_at(state, state->live[i]);
+        if (e->mass == 0.0f) spatial_insert_static(index, e);
+    }
+    Entity* out[1024];
+    spatial_query_point(index, 0.0f, 0.0f, ~0u, out, 1024);   // Builds the layer
+    build = bench_time_ms() - build;
+
+    SpatialPairList pairs = {0};
+    double elapsed = 0.0;
+    for (int f = 0; f <= frames; f++) {
+        for (int i = 0; i < state->live_count; i++) {
+            Entity* e = entity_at(state, state->live[i]);
+            if (e->mass == 0.0f) continue;
+            e->x += e->vel_x / 60.0f;
+            e->y += e->vel_y / 60.0f;
+        }
+
+        double start = bench_time_ms();
+        spatial_clear(index);
+        if (reinsert) spatial_clear_static(index);
+        for (int i = 0; i < state->live_count; i++) {
+            Entity* e = entity_at(state, state->live[i]);
+            if (e->mass != 0.0f) {
+                spatial_insert(index, e);
+            } else if (reinsert) {
+                spatial_insert_static(index, e);
+            }
+        }
+        spatial_find_pairs(index, &pairs);
+        if (f > 0) elapsed += bench_time_ms() - start;
+    }
+
+    long hits = 0;
+    double box = bench_time_ms();
+    for (int q = 0; q < 20000; q++) {
+        float x = bench_randf(0.0f, world), y = bench_randf(0.0f, world);
+        hits += spatial_query_box(index, x, y, x + 100.0f, y + 100.0f, ~0u, out, 1024);
+    }
+    box = bench_time_ms() - box;
+
+    double point = bench_time_ms();
+    for (int q = 0; q < 20000; q++) {
+        hits += spatial_query_point(index, bench_randf(0.0f, world), bench_randf(0.0f, world), ~0u, out, 1024);
+    }
+    point = bench_time_ms() - point;
+
+    double segment = bench_time_ms();
+    for (int q = 0; q < 20000; q++) {
+        float x = bench_randf(0.0f, world), y = bench_randf(0.0f, world);
+        hits += spatial_query_segment(index, x, y, x + bench_randf(-1500.0f, 1500.0f),
+                                      y + bench_randf(-1500.0f, 1500.0f), ~0u, out, 1024);
+    }
+    segment = bench_time_ms() - segment;
+
+    printf("%-4s, walls %s: build %.2f ms, %.3f ms per frame (%d pairs), "
+           "20k box %.2f ms, point %.2f ms, segment %.2f ms (%ld hits)\n",
+           use_tree ? "bvh" : "grid", reinsert ? "every frame" : "once",
+           build, elapsed / frames, pairs.count, box, point, segment, hits);
+
+    spatial_pair_list_free(&pairs);
+    spatial_destroy(index);
+    free_scene(state);
+}
+
+int bench_bvh(int argc, char** argv) {
+    int frames = argc > 0 ? atoi(argv[0]) : 200;
+    for (int reinsert = 0; reinsert < 2; reinsert++) {
+        bvh_layer_run(0, reinsert, frames);
+        bvh_layer_run(1, reinsert, frames);
+    }
+    return 0;
+}
@@ -50,11 +50,28 @@ typedef enum {
     SORT_LAYER_OVERHEAD = 3,     // Tree tops, roofs (always on top)
 } SortLayer;
 
+// ENTITY HANDLES
+// An id packs the slot index (low bits) with a generation counter (high bits).
+// The generation is bumped every time a slot is recycled, so a handle kept to a
+// destroyed entity never resolves to whatever spawned in its slot afterwards.
+typedef uint32_t EntityHandle;
+
+#define ENTITY_INDEX_BITS      20
+#define ENTITY_INDEX_MASK      ((1u << ENTITY_INDEX_BITS) - 1)
+#define ENTITY_GENERATION_MAX  (0xFFFFFFFFu >> ENTITY_INDEX_BITS)
+
+#define ENTITY_HANDLE_NONE     0u  // Never a valid id (generations start at 1)
+#define ENTITY_HANDLE_INDEX(h)      ((h) & ENTITY_INDEX_MASK)
+#define ENTITY_HANDLE_GENERATION(h) ((h) >> ENTITY_INDEX_BITS)
+#define ENTITY_MAKE_HANDLE(index, gen) (((uint32_t)(gen) << ENTITY_INDEX_BITS) | (uint32_t)(index))
+
 // ENTITIY
 typedef struct {
-    uint32_t id; // unique identifier
-    uint32_t tag; // who am I?
+    EntityHandle id; // unique identifier (slot index + generation)
+    uint32_t tag; // who am I? (bitmask; change it with entity_set_tag so tag queries stay in sync)
     int active; // 1 = alive, 0 = dead/recyclable (for recycling entities)
+    int next_free; // While dead: next slot in the free list (see GameState.free_head)
+    int live_index; // While alive: position in GameState.live
 
     float x, y; // position
     float rotation; // degrees
@@ -108,11 +125,33 @@ typedef struct {
         uint32_t mask;  // Who do I hit?
         int is_colliding; // Debug flag (Flash red)
 
+        // 1 = continuous collision: swept along its motion every step so it can't
+        // pass through thin walls when fast (projectiles; costs a query per step)
+        int ccd;
+
     } collider;
 
 } Entity;
 
-#define MAX_ENTITIES 10000
+// ENTITY STORAGE
+// Entities live in fixed-size pages allocated on demand, so storage grows without
+// ever moving an entity (Entity* stay valid for the life of the slot).
+// The hard cap is set by how many slot indices fit in a handle.
+#define ENTITY_CHUNK_BITS  10
+#define ENTITY_CHUNK_SIZE  (1 << ENTITY_CHUNK_BITS)                     // 1024 entities per page
+#define ENTITY_MAX_CHUNKS  ((int)((ENTITY_INDEX_MASK + 1) >> ENTITY_CHUNK_BITS))
+#define MAX_ENTITIES       (ENTITY_MAX_CHUNKS * ENTITY_CHUNK_SIZE)        // ~1M
+
+// TAG INDEX
+// One packed membership list per tag bit, so tag queries only visit matching
+// entities. Lists are allocated the first time their bit is used.
+#define ENTITY_TAG_BITS 32
+
+typedef struct {
+    int *members;   // Slot indices of live entities carrying this bit (packed)
+    int *position;  // Slot index -> position in members (valid only for members)
+    int count;
+} TagList;
 
 
 typedef struct {
@@ -121,13 +160,24 @@ typedef struct {
 } Camera;
 
 typedef struct {
-    Entity entities[MAX_ENTITIES];
-    int count;
-    uint32_t next_id; // next unique identifier ; increment after each spawn
+    Entity *chunks[ENTITY_MAX_CHUNKS]; // Entity pages (see entity_at)
+    int chunk_count;
+    int capacity;     // Slots backed by allocated pages (chunk_count * ENTITY_CHUNK_SIZE)
+    int count;        // High-water mark of used slots
+    int free_head;    // First dead slot to recycle (valid when free_count > 0)
+    int free_count;   // Number of dead slots in the free list
+    int *live;        // Packed slot indices of active entities (iterate these, not 0..count)
+    int live_count;
+    TagList tag_lists[ENTITY_TAG_BITS]; // Maintained by entity_set_tag / entity_destroy
     Camera camera;
     Color background;
 } GameState;
 
+// Entity in slot 'index' (0 <= index < state->count)
+static inline Entity* entity_at(GameState *state, int index) {
+    return &state->chunks[index >> ENTITY_CHUNK_BITS][index & (ENTITY_CHUNK_SIZE - 1)];
+}
+
 // RENDERER API
 void init_renderer();
 
@@ -150,6 +200,7 @@ void end_camera_mode();
 // ENGINE CORE API (automatic systems)
 void engine_update(GameState *state, float dt);
 void engine_render(GameState *state);
+void engine_shutdown(void);  // Frees the engine's own buffers (call after close_game)
 
 // GAME API
 void init_game(GameState *state);
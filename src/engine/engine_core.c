@@ -14,8 +14,17 @@ void engine_update(GameState *state, float dt) {
 
 // --- Y-SORTING ---
 // We sort pointers to entities, not the entities themselves (faster, preserves array)
-static Entity* sorted_entities[MAX_ENTITIES];
+// Grown to the live entity count as needed
+static Entity** sorted_entities = NULL;
 static int sorted_count = 0;
+static int sorted_capacity = 0;
+
+void engine_shutdown(void) {
+    free(sorted_entities);
+    sorted_entities = NULL;
+    sorted_count = 0;
+    sorted_capacity = 0;
+}
 
 // Comparison function for qsort: layer → z_order → Y position
 static int compare_entities_for_sort(const void* a, const void* b) {
@@ -56,13 +65,21 @@ void engine_render(GameState *state) {
     // Let game render world-space content first (tilemaps, backgrounds)
     render_world(state);
     
-    // Build sorted list of active entities
-    sorted_count = 0;
-    for (int i = 0; i < state->count; i++) {
-        if (state->entities[i].active) {
-            sorted_entities[sorted_count++] = &state->entities[i];
+    // Build sorted list of active entities (straight from the packed live list)
+    if (state->live_count > sorted_capacity) {
+        int new_capacity = sorted_capacity ? sorted_capacity : 1024;
+        while (new_capacity < state->live_count) new_capacity *= 2;
+
+        Entity** grown = realloc(sorted_entities, (size_t)new_capacity * sizeof(Entity*));
+        if (grown) {
+            sorted_entities = grown;
+            sorted_capacity = new_capacity;
         }
     }
+    sorted_count = (state->live_count < sorted_capacity) ? state->live_count : sorted_capacity;
+    for (int i = 0; i < sorted_count; i++) {
+        sorted_entities[i] = entity_at(state, state->live[i]);
+    }
     
     // Sort by layer, then by Y (if enabled)
     if (g_y_sort_enabled) {
@@ -148,9 +165,9 @@ void engine_render(GameState *state) {
 
     // Render debug draw (for collision boxes)
     if (g_debug_draw) {
-        for (int i = 0; i < state->count; i++) {
-            Entity *e = &state->entities[i];
-            if (!e->active || !e->collider.active) continue;
+        for (int i = 0; i < state->live_count; i++) {
+            Entity *e = entity_at(state, state->live[i]);
+            if (!e->collider.active) continue;
             
             float cx = e->x + e->collider.offset_x;
             float cy = e->y + e->collider.offset_y;
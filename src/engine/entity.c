@@ -1,5 +1,7 @@
 #include "entity.h"
+#include "physics.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 static void entity_set_defaults(Entity *e) {
@@ -24,36 +26,167 @@ static void entity_set_defaults(Entity *e) {
     e->shadow_opacity = 0.8f;
 }
 
-Entity* entity_alloc(GameState *state) {
-    // First, try to recycle a dead entity
-    for (int i = 0; i < state->count; i++) {
-        if (!state->entities[i].active) {
-            Entity *e = &state->entities[i];
-            
-            uint32_t old_id = e->id;  // Preserve ID slot? No, assign new!
-            memset(e, 0, sizeof(Entity));
-            entity_set_defaults(e);
-
-            e->id = state->next_id++;  // Assign NEW unique ID
-            return e;
+// --- TAG LISTS ---
+
+// Lists are sized to the entity capacity (entity_grow_storage keeps them in step)
+static void tag_list_add(TagList *list, int index, int capacity) {
+    if (!list->members) {
+        list->members = malloc((size_t)capacity * sizeof(int));
+        list->position = malloc((size_t)capacity * sizeof(int));
+        if (!list->members || !list->position) {
+            printf("CRITICAL: Out of memory for tag list!\n");
+            free(list->members); free(list->position);
+            list->members = NULL; list->position = NULL;
+            return;
         }
     }
-    
-    // No recyclable slot, allocate new
-    if (state->count >= MAX_ENTITIES) {
-        printf("CRITICAL: Entity limit reached!\n");
-        return NULL;
+    list->position[index] = list->count;
+    list->members[list->count++] = index;
+}
+
+// Swap-remove: the last member takes over the removed one's position
+static void tag_list_remove(TagList *list, int index) {
+    if (!list->members) return;
+    int pos = list->position[index];
+    if (pos < 0 || pos >= list->count || list->members[pos] != index) return; // Not a member
+
+    int last = list->members[--list->count];
+    list->members[pos] = last;
+    list->position[last] = pos;
+}
+
+// Add/remove the slot from every list whose bit differs between old_tag and new_tag
+static void tag_lists_update(GameState *state, int index, uint32_t old_tag, uint32_t new_tag) {
+    uint32_t changed = old_tag ^ new_tag;
+    for (int bit = 0; changed; bit++, changed >>= 1) {
+        if (!(changed & 1u)) continue;
+        if (new_tag & (1u << bit)) {
+            tag_list_add(&state->tag_lists[bit], index, state->capacity);
+        } else {
+            tag_list_remove(&state->tag_lists[bit], index);
+        }
     }
-    
-    Entity *e = &state->entities[state->count++];
+}
+
+// --- STORAGE ---
+
+// Add one page of entities and grow the per-slot arrays to match
+// Existing pages never move, so Entity* handed out earlier stay valid
+static int entity_grow_storage(GameState *state) {
+    if (state->chunk_count >= ENTITY_MAX_CHUNKS) return 0;
+    int new_capacity = state->capacity + ENTITY_CHUNK_SIZE;
+
+    // Grow the slot-indexed arrays first: a failed realloc leaves the old ones intact
+    int *live = realloc(state->live, (size_t)new_capacity * sizeof(int));
+    if (!live) return 0;
+    state->live = live;
+
+    for (int bit = 0; bit < ENTITY_TAG_BITS; bit++) {
+        TagList *list = &state->tag_lists[bit];
+        if (!list->members) continue;  // Allocated at full capacity on first use
+
+        int *members = realloc(list->members, (size_t)new_capacity * sizeof(int));
+        if (!members) return 0;
+        list->members = members;
+
+        int *position = realloc(list->position, (size_t)new_capacity * sizeof(int));
+        if (!position) return 0;
+        list->position = position;
+    }
+
+    Entity *chunk = calloc(ENTITY_CHUNK_SIZE, sizeof(Entity));
+    if (!chunk) return 0;
+
+    state->chunks[state->chunk_count++] = chunk;
+    state->capacity = new_capacity;
+    return 1;
+}
+
+Entity* entity_alloc(GameState *state) {
+    Entity *e;
+    int index;
+    uint32_t generation = 1;
+
+    // First, try to recycle a dead entity (O(1): pop the free list)
+    if (state->free_count > 0) {
+        index = state->free_head;
+        e = entity_at(state, index);
+        state->free_head = e->next_free;
+        state->free_count--;
+
+        // Bump the generation so old handles to this slot go stale (skip 0 on wrap)
+        generation = ENTITY_HANDLE_GENERATION(e->id) + 1;
+        if (generation > ENTITY_GENERATION_MAX) generation = 1;
+    } else {
+        // No recyclable slot, allocate new (adding a page if we're full)
+        if (state->count >= state->capacity && !entity_grow_storage(state)) {
+            printf("CRITICAL: Entity limit reached (%d entities)!\n", state->count);
+            return NULL;
+        }
+        index = state->count++;
+        e = entity_at(state, index);
+    }
+
     memset(e, 0, sizeof(Entity));
     entity_set_defaults(e);
 
-    e->id = state->next_id++;  // Assign unique ID
+    e->id = ENTITY_MAKE_HANDLE(index, generation);
+
+    // Append to the packed live list
+    e->live_index = state->live_count;
+    state->live[state->live_count++] = index;
+
+    // Physics reads it (with whatever the spawner sets) at the next step
+    physics_refresh(e);
     return e;
 }
-void entity_destroy(Entity *e) {
+
+// Marks the entity dead and pushes its slot on the free list for reuse
+void entity_destroy(GameState *state, Entity *e) {
+    if (!e || !e->active) return;  // Already dead (don't push the slot twice)
+
+    int index = (int)ENTITY_HANDLE_INDEX(e->id);
+    tag_lists_update(state, index, e->tag, 0);
+    physics_remove(e);
+
+    // Swap-remove from the live list (the last live entity takes our position)
+    int last = state->live[--state->live_count];
+    state->live[e->live_index] = last;
+    entity_at(state, last)->live_index = e->live_index;
+
     e->active = 0;
+    e->next_free = state->free_head;
+    state->free_head = index;
+    state->free_count++;
+}
+
+// Frees entity pages and bookkeeping; the GameState is empty afterwards
+void entity_shutdown(GameState *state) {
+    for (int bit = 0; bit < ENTITY_TAG_BITS; bit++) {
+        TagList *list = &state->tag_lists[bit];
+        free(list->members);
+        free(list->position);
+        memset(list, 0, sizeof(TagList));
+    }
+
+    for (int i = 0; i < state->chunk_count; i++) {
+        free(state->chunks[i]);
+        state->chunks[i] = NULL;
+    }
+    free(state->live);
+    state->live = NULL;
+
+    state->chunk_count = 0;
+    state->capacity = 0;
+    state->count = 0;
+    state->live_count = 0;
+    state->free_count = 0;
+}
+
+void entity_set_tag(GameState *state, Entity *e, uint32_t tag) {
+    if (!e || !e->active) return;
+    tag_lists_update(state, (int)ENTITY_HANDLE_INDEX(e->id), e->tag, tag);
+    e->tag = tag;
 }
 
 Entity* spawn_sprite(GameState *state, Texture *tex, float x, float y) {
@@ -131,36 +264,58 @@ void spawn_world_bounds(GameState *state, float width, float height) {
     spawn_primitive_wall(state, width + t/2, height/2, t, height);   // Right
 }
 
-// Find entity by unique ID (returns NULL if not found or inactive)
-Entity* get_entity_by_id(GameState *state, uint32_t id) {
-    for (int i = 0; i < state->count; i++) {
-        Entity *e = &state->entities[i];
-        if (e->active && e->id == id) {
-            return e;
-        }
-    }
-    return NULL;
+// Find entity by handle (returns NULL if not found, inactive, or the slot was recycled)
+Entity* get_entity_by_id(GameState *state, EntityHandle id) {
+    uint32_t index = ENTITY_HANDLE_INDEX(id);
+    if (id == ENTITY_HANDLE_NONE || index >= (uint32_t)state->count) return NULL;
+
+    Entity *e = entity_at(state, (int)index);
+    if (!e->active || e->id != id) return NULL;  // Dead, or generation mismatch
+    return e;
 }
 
-// Find first entity with matching tag (bitmask)
+// Find an entity with matching tag (bitmask)
 Entity* find_entity_with_tag(GameState *state, uint32_t tag) {
-    for (int i = 0; i < state->count; i++) {
-        Entity *e = &state->entities[i];
-        if (e->active && (e->tag & tag)) {
-            return e;
-        }
-    }
-    return NULL;
+    TagQuery q = tag_query(state, tag);
+    return tag_query_next(&q);
 }
 
 // Find ALL entities with matching tag, returns count found
 int find_all_with_tag(GameState *state, uint32_t tag, Entity **out, int max) {
     int found = 0;
-    for (int i = 0; i < state->count && found < max; i++) {
-        Entity *e = &state->entities[i];
-        if (e->active && (e->tag & tag)) {
-            out[found++] = e;
-        }
+    TagQuery q = tag_query(state, tag);
+    Entity *e;
+    while (found < max && (e = tag_query_next(&q))) {
+        out[found++] = e;
     }
     return found;
-}
\ No newline at end of file
+}
+
+TagQuery tag_query(GameState *state, uint32_t tag) {
+    TagQuery q = { state, tag, -1, -1 };
+    return q;
+}
+
+// Lists are walked from the back so swap-removing the current entity
+// (entity_destroy on it) only moves an already-visited member
+Entity* tag_query_next(TagQuery *q) {
+    for (;;) {
+        while (q->pos < 0) {
+            // Advance to the next queried bit with a non-empty list
+            do {
+                q->bit++;
+                if (q->bit >= ENTITY_TAG_BITS) return NULL;
+            } while (!(q->tag & (1u << q->bit)));
+            q->pos = q->state->tag_lists[q->bit].count - 1;
+        }
+
+        int index = q->state->tag_lists[q->bit].members[q->pos--];
+        Entity *e = entity_at(q->state, index);
+
+        // Multi-bit queries: an entity is reported under its lowest matching bit only
+        uint32_t lower_bits = q->tag & ((1u << q->bit) - 1u);
+        if (e->tag & lower_bits) continue;
+
+        return e;
+    }
+}
@@ -5,7 +5,11 @@
 
 // Core Allocator
 Entity* entity_alloc(GameState *state);
-void entity_destroy(Entity *e);
+void entity_destroy(GameState *state, Entity *e);
+void entity_shutdown(GameState *state);  // Frees entity storage and bookkeeping
+
+// Tags
+void entity_set_tag(GameState *state, Entity *e, uint32_t tag);
 
 // Generic Spawners
 Entity* spawn_sprite(GameState *state, Texture *tex, float x, float y);
@@ -14,8 +18,23 @@ Entity* spawn_ball(GameState *state, float x, float y, float radius, Color color
 void spawn_world_bounds(GameState *state, float width, float height);
 
 // Finders
-Entity* get_entity_by_id(GameState *state, uint32_t id);
+Entity* get_entity_by_id(GameState *state, EntityHandle id);
 Entity* find_entity_with_tag(GameState *state, uint32_t tag);
 int find_all_with_tag(GameState *state, uint32_t tag, Entity **out, int max);
 
+// Tag query: walks the per-tag lists without copying, cost ~ number of matches
+// Usage: TagQuery q = tag_query(state, TAG_ENEMY); Entity *e;
+//        while ((e = tag_query_next(&q))) { ... }
+// Destroying the entity just returned is safe; other spawns/destroys/tag
+// changes during the loop are not.
+typedef struct {
+    GameState *state;
+    uint32_t tag;       // Bits being queried
+    int bit;            // Current tag bit
+    int pos;            // Next position in the current bit's list (walks downward)
+} TagQuery;
+
+TagQuery tag_query(GameState *state, uint32_t tag);
+Entity* tag_query_next(TagQuery *q);
+
 #endif
\ No newline at end of file
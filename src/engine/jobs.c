@@ -0,0 +1,210 @@
+// jobs.c — Worker thread pool (Win32 threads / pthreads)
+//
+// Workers sleep on a condition variable between loops. A loop publishes the
+// function and range, bumps the generation and wakes everyone; worker k runs
+// chunk k (workers past the chunk count go back to sleep), the caller runs
+// chunk 0 and then waits for the others to check in.
+//
+
+#ifndef _WIN32
+    #define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "jobs.h"
+#include <stdint.h>
+
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+
+    typedef HANDLE JobThread;
+    typedef SRWLOCK JobMutex;
+    typedef CONDITION_VARIABLE JobCond;
+    #define JOB_THREAD_PROC DWORD WINAPI
+
+    static void mutex_init(JobMutex* m)    { InitializeSRWLock(m); }
+    static void mutex_destroy(JobMutex* m) { (void)m; }
+    static void mutex_lock(JobMutex* m)    { AcquireSRWLockExclusive(m); }
+    static void mutex_unlock(JobMutex* m)  { ReleaseSRWLockExclusive(m); }
+    static void cond_init(JobCond* c)      { InitializeConditionVariable(c); }
+    static void cond_destroy(JobCond* c)   { (void)c; }
+    static void cond_wait(JobCond* c, JobMutex* m) { SleepConditionVariableSRW(c, m, INFINITE, 0); }
+    static void cond_broadcast(JobCond* c) { WakeAllConditionVariable(c); }
+    static void cond_signal(JobCond* c)    { WakeConditionVariable(c); }
+
+    static int thread_start(JobThread* t, LPTHREAD_START_ROUTINE proc, void* arg) {
+        *t = CreateThread(NULL, 0, proc, arg, 0, NULL);
+        return *t != NULL;
+    }
+    static void thread_join(JobThread t) {
+        WaitForSingleObject(t, INFINITE);
+        CloseHandle(t);
+    }
+#else
+    #include <pthread.h>
+    #include <unistd.h>
+
+    typedef pthread_t JobThread;
+    typedef pthread_mutex_t JobMutex;
+    typedef pthread_cond_t JobCond;
+    #define JOB_THREAD_PROC void*
+
+    static void mutex_init(JobMutex* m)    { pthread_mutex_init(m, NULL); }
+    static void mutex_destroy(JobMutex* m) { pthread_mutex_destroy(m); }
+    static void mutex_lock(JobMutex* m)    { pthread_mutex_lock(m); }
+    static void mutex_unlock(JobMutex* m)  { pthread_mutex_unlock(m); }
+    static void cond_init(JobCond* c)      { pthread_cond_init(c, NULL); }
+    static void cond_destroy(JobCond* c)   { pthread_cond_destroy(c); }
+    static void cond_wait(JobCond* c, JobMutex* m) { pthread_cond_wait(c, m); }
+    static void cond_broadcast(JobCond* c) { pthread_cond_broadcast(c); }
+    static void cond_signal(JobCond* c)    { pthread_cond_signal(c); }
+
+    static int thread_start(JobThread* t, void* (*proc)(void*), void* arg) {
+        return pthread_create(t, NULL, proc, arg) == 0;
+    }
+    static void thread_join(JobThread t) {
+        pthread_join(t, NULL);
+    }
+#endif
+
+static struct {
+    int running;
+    int thread_count;           // Including the calling thread
+    JobThread threads[JOBS_MAX_THREADS];  // [1, thread_count) are workers
+
+    JobMutex lock;
+    JobCond wake;               // New loop published (or quit)
+    JobCond done;               // Last worker of the loop finished
+    unsigned int generation;    // Bumped once per loop
+    int pending;                // Workers still running the current loop
+    int quit;
+
+    // Current loop
+    JobFunc fn;
+    void* data;
+    int count;
+    int chunks;
+} g_pool = { .thread_count = 1 };
+
+static int chunk_begin(int count, int chunk, int chunks) {
+    return (int)((long long)count * chunk / chunks);
+}
+
+static JOB_THREAD_PROC worker_main(void* arg) {
+    int chunk = (int)(intptr_t)arg;
+    unsigned int seen = 0;
+
+    mutex_lock(&g_pool.lock);
+    for (;;) {
+        while (g_pool.generation == seen && !g_pool.quit) cond_wait(&g_pool.wake, &g_pool.lock);
+        if (g_pool.quit) break;
+        seen = g_pool.generation;
+        if (chunk >= g_pool.chunks) continue;  // Not needed this time
+
+        JobFunc fn = g_pool.fn;
+        void* data = g_pool.data;
+        int count = g_pool.count;
+        int chunks = g_pool.chunks;
+        mutex_unlock(&g_pool.lock);
+
+        fn(data, chunk_begin(count, chunk, chunks), chunk_begin(count, chunk + 1, chunks), chunk);
+
+        mutex_lock(&g_pool.lock);
+        if (--g_pool.pending == 0) cond_signal(&g_pool.done);
+    }
+    mutex_unlock(&g_pool.lock);
+    return 0;
+}
+
+int jobs_hardware_threads(void) {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (int)info.dwNumberOfProcessors;
+#elif defined(_SC_NPROCESSORS_ONLN)
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return (n > 0) ? (int)n : 1;
+#else
+    return 1;
+#endif
+}
+
+int jobs_init(int thread_count) {
+    jobs_shutdown();
+
+    int n = (thread_count > 0) ? thread_count : jobs_hardware_threads();
+    if (n > JOBS_MAX_THREADS) n = JOBS_MAX_THREADS;
+    if (n <= 1) return 1;
+
+    mutex_init(&g_pool.lock);
+    cond_init(&g_pool.wake);
+    cond_init(&g_pool.done);
+    g_pool.generation = 0;
+    g_pool.pending = 0;
+    g_pool.quit = 0;
+    g_pool.chunks = 0;
+
+    // Keep whatever workers could be started
+    int started = 1;
+    while (started < n && thread_start(&g_pool.threads[started], worker_main, (void*)(intptr_t)started)) {
+        started++;
+    }
+
+    g_pool.thread_count = started;
+    g_pool.running = 1;
+    return started;
+}
+
+void jobs_shutdown(void) {
+    if (!g_pool.running) return;
+
+    mutex_lock(&g_pool.lock);
+    g_pool.quit = 1;
+    cond_broadcast(&g_pool.wake);
+    mutex_unlock(&g_pool.lock);
+
+    for (int i = 1; i < g_pool.thread_count; i++) thread_join(g_pool.threads[i]);
+
+    cond_destroy(&g_pool.done);
+    cond_destroy(&g_pool.wake);
+    mutex_destroy(&g_pool.lock);
+    g_pool.running = 0;
+    g_pool.thread_count = 1;
+}
+
+int jobs_thread_count(void) {
+    return g_pool.thread_count;
+}
+
+int jobs_chunk_count(int count, int min_per_chunk) {
+    if (min_per_chunk < 1) min_per_chunk = 1;
+    int chunks = count / min_per_chunk;
+    if (chunks > g_pool.thread_count) chunks = g_pool.thread_count;
+    return (chunks < 1) ? 1 : chunks;
+}
+
+void jobs_parallel_for(int count, int min_per_chunk, JobFunc fn, void* data) {
+    if (count <= 0) return;
+
+    int chunks = jobs_chunk_count(count, min_per_chunk);
+    if (chunks == 1) {
+        fn(data, 0, count, 0);
+        return;
+    }
+
+    mutex_lock(&g_pool.lock);
+    g_pool.fn = fn;
+    g_pool.data = data;
+    g_pool.count = count;
+    g_pool.chunks = chunks;
+    g_pool.pending = chunks - 1;
+    g_pool.generation++;
+    cond_broadcast(&g_pool.wake);
+    mutex_unlock(&g_pool.lock);
+
+    fn(data, 0, chunk_begin(count, 1, chunks), 0);
+
+    mutex_lock(&g_pool.lock);
+    while (g_pool.pending > 0) cond_wait(&g_pool.done, &g_pool.lock);
+    mutex_unlock(&g_pool.lock);
+}
@@ -0,0 +1,40 @@
+// jobs.h — Worker thread pool for data-parallel loops
+//
+// A fixed set of worker threads that split one index range between them.
+// Chunk k always gets the same slice of the range for a given chunk count,
+// and the calling thread runs chunk 0, so callers that keep per-chunk output
+// and merge it in chunk order get the same result regardless of scheduling.
+// Win32 threads on Windows, pthreads elsewhere.
+//
+#ifndef JOBS_H
+#define JOBS_H
+
+#define JOBS_MAX_THREADS 16
+
+// Runs indices [start, end) of the range as chunk 'chunk' (0 .. chunks - 1)
+typedef void (*JobFunc)(void* data, int start, int end, int chunk);
+
+// Start the pool with 'thread_count' threads including the caller
+// (0 = one per hardware thread, clamped to JOBS_MAX_THREADS; 1 = no workers).
+// Restarts the pool if it is already running. Returns the thread count in use
+int jobs_init(int thread_count);
+
+// Stop and join the workers (later loops run on the calling thread)
+void jobs_shutdown(void);
+
+// Threads available to jobs_parallel_for (1 when the pool isn't running)
+int jobs_thread_count(void);
+
+// Hardware threads reported by the OS
+int jobs_hardware_threads(void);
+
+// How many chunks jobs_parallel_for will use for 'count' items when each
+// chunk should get at least 'min_per_chunk' of them
+int jobs_chunk_count(int count, int min_per_chunk);
+
+// Split [0, count) into jobs_chunk_count(count, min_per_chunk) contiguous
+// slices and run 'fn' on each; returns once every chunk is done.
+// Chunk k covers [count * k / chunks, count * (k + 1) / chunks)
+void jobs_parallel_for(int count, int min_per_chunk, JobFunc fn, void* data);
+
+#endif
@@ -1,16 +1,787 @@
 #include "physics.h"
 #include "spatial.h"
+#include "physics_simd.h"
+#include "jobs.h"
 #include "math_common.h"
 #include <math.h>
+#include <float.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <stdint.h>
 
 // Spatial index for broad-phase collision detection
 static SpatialIndex* g_spatial = NULL;
 
-// Buffer for spatial query results
-#define MAX_QUERY_RESULTS 128
-static Entity* query_buffer[MAX_QUERY_RESULTS];
+// Candidate pairs from the broad phase (reused every step)
+static SpatialPairList g_pairs = {0};
+
+// --- NARROW PHASE OUTPUT ---
+// Detection only reads entities, so pair ranges are tested on the worker pool.
+// Each chunk writes its hits into the contact array starting at its first pair
+// (a chunk can't have more hits than pairs, so the slices never overlap), and
+// the hits are resolved serially chunk by chunk: the same pair order for any
+// thread count.
+typedef struct {
+    int pair;               // Index into g_pairs
+    int body_a, body_b;     // Body indices of the pair's entities
+    Manifold m;
+} Contact;
+
+static Contact* g_contacts = NULL;  // One slot per candidate pair
+static int g_contact_capacity = 0;
+static int g_chunk_start[JOBS_MAX_THREADS];
+static int g_chunk_hits[JOBS_MAX_THREADS];
+
+// Smallest pair range worth handing to another thread
+#define NARROW_MIN_PAIRS 512
+
+// Pairs sorted by shape combination per round of SIMD kernel calls
+#define NARROW_BLOCK 64
+
+// Worker threads requested with physics_set_threads (0 = one per hardware thread)
+// Single-threaded until the game asks for more
+static int g_thread_request = 1;
+
+// --- BATCHED SOLVER STATE ---
+// PHYSICS_SOLVER_BATCHED colors the contact graph greedily in pair order: each
+// contact takes the lowest batch that neither of its dynamic bodies is in yet
+// (static bodies are only read, so any number of contacts can share one). A batch
+// never touches a body twice, so its contacts are resolved in parallel, and the
+// batches run one after another. Coloring and batch order only depend on the pair
+// order, so the result is the same on every run and for any thread count.
+// Batches work on the packed body arrays (each batch sweeps the whole world, which
+// the small arrays survive far better than Entity records) and are written back after.
+static PhysicsSolver g_solver = PHYSICS_SOLVER_SERIAL;
+
+#define SOLVER_MAX_BATCHES 64   // Batches tracked per body (one bit each)
+#define SOLVER_MIN_CONTACTS 256 // Smallest batch slice worth handing to another thread
+
+static Contact* g_batched = NULL;   // Contacts grouped by batch (pair order within a batch)
+static unsigned char* g_batch_of = NULL;  // Per contact (pair order): its batch
+static int g_batched_capacity = 0;
+static uint64_t* g_body_batches = NULL;   // Per body: bit k = in batch k
+static int g_body_batches_capacity = 0;
+
+// --- ITERATIVE SOLVER STATE ---
+// PHYSICS_SOLVER_ITERATIVE runs sequential impulses: every contact is visited
+// g_iterations times, each visit nudging its accumulated normal impulse (kept >= 0)
+// toward the value that stops the bodies approaching, or bounces them. The final
+// impulse is cached per entity pair and the next step starts from it (warm
+// starting), so resting contacts in a pile begin near their answer instead of
+// from zero and settle in a few iterations. Penetration is then removed in one
+// position pass. With one iteration and nothing cached, the velocity result is the
+// same as resolve_collision's.
+static int g_iterations = 4;
+
+#define SOLVER_SLOP 0.5f                // Penetration left alone (px), so resting contacts stay in touch
+#define SOLVER_CORRECTION 0.8f          // Share of the remaining penetration removed per step
+#define SOLVER_BOUNCE_THRESHOLD 10.0f   // Slower approaches don't bounce (px/s)
+
+typedef struct {
+    int body_a, body_b;
+    float normal_x, normal_y;   // A -> B
+    float depth;
+    float inv_k;                // 1 / (inv_mass_a + inv_mass_b)
+    float target;               // Normal velocity to reach (bounce)
+    float impulse;              // Accumulated normal impulse
+    uint64_t key;               // Entity pair (see contact_key)
+} SolverContact;
+
+static SolverContact* g_solver_contacts = NULL;
+static int g_solver_contact_capacity = 0;
+
+// Impulse cache: open addressing on the pair key (0 = empty slot), rebuilt every
+// step from that step's contacts; the previous step's table is the lookup side
+typedef struct {
+    uint64_t key;
+    float impulse;
+} CachedImpulse;
+
+static CachedImpulse* g_impulse_cache[2] = {NULL, NULL};
+static int g_impulse_cache_capacity[2] = {0, 0};   // Power of two
+static int g_impulse_cache_current = 0;             // Table written this step
+
+// --- SLEEPING ---
+// A dynamic body that stays slower than g_sleep_speed for g_sleep_time seconds may
+// sleep, but only together with its island (the dynamic bodies it touches, and the
+// ones they touch...), so a pile settles and wakes as one. Sleepers have their own
+// run in the body arrays, between the awake bodies and the statics, which the step
+// never walks, and they sit in the broad phase's static layer, which never pairs
+// them with each other or with walls. Nothing polls them: an island wakes when an
+// awake body touches one of its bodies (before the contacts are solved, or in a
+// sub-step), when game code moves, pushes or refreshes one (the setters,
+// physics_refresh), destroys one, or calls physics_wake. Each island keeps a list
+// of its bodies, so waking one costs its size.
+static float g_sleep_speed = 0.0f;  // 0 = off
+static float g_sleep_time = 0.5f;
+
+typedef struct {
+    EntityHandle id;        // Entity the state belongs to (a recycled slot starts awake)
+    int island;             // Asleep: label of its island (the slot of one member); -1 = awake
+    float still_time;       // Seconds spent under g_sleep_speed
+    int next;               // Asleep: slot of the next body of its island; -1 = last
+
+    // When the slot is an island label
+    int island_first;       // Slot of its first body
+} SleepState;
+
+static SleepState* g_sleep = NULL;  // Per entity slot
+static int g_sleep_capacity = 0;
+static int g_sleep_ready = 0;       // Sized for this step's entities (sleeping runs this step)
+static int g_sleep_settling = 0;    // Bodies put to sleep this step
+
+static int* g_island_parent = NULL;  // Per dynamic body: union-find over the contacts
+static float* g_island_still = NULL; // Per island root: least still_time of its bodies
+static int g_island_capacity = 0;
+
+// --- CONTINUOUS COLLISION ---
+// Awake bodies with collider.ccd are swept from where the step started to where
+// integration put them, against everything in the spatial index (other bodies at
+// their end-of-step position). If the sweep hits something, the body is moved
+// back to the time of impact, CCD_SKIN px into what it hit: the narrow phase then
+// finds that contact and the solver bounces or stops it like any other, and the
+// rest of the step's motion is dropped. A body that moved less than its own half
+// size skips the sweep (it would overlap anything it passed at one end or the other).
+#define CCD_SKIN 1.0f   // Overlap left for the narrow phase (px)
+
+typedef struct {
+    int body;
+    float start_x, start_y; // Position before integration
+} CcdBody;
+
+static CcdBody* g_ccd = NULL;       // Bodies flagged ccd, in body order
+static int g_ccd_count = 0;
+static int g_ccd_capacity = 0;
+
+// --- SUB-STEPPING ---
+// With physics_set_substeps(n > 1), an awake body that would travel more than
+// SUBSTEP_TRAVEL times its smallest half extent in one step takes up to n shorter
+// steps instead (within its radius per step, a circle can't get its center past
+// a wall's surface, where the overlap tests lose track of which side it came
+// from). Its first one goes through the regular pipeline with everyone else; the
+// rest run after it for the fast bodies alone: move, query the spatial index
+// around the body and resolve what it touches like resolve_collision does (the
+// bodies it hits stay where the step left them). The index was filled before the
+// solver ran, so the bodies the solver moved get their entries refreshed first
+// (substep_refresh). Fast bodies are not re-binned between their sub-steps (each
+// move would rebuild the cells for the next query), so they find each other only
+// near where their first sub-step left them. Slow bodies only pay the speed
+// check. Bodies flagged ccd are swept over the whole step instead.
+#define SUBSTEP_TRAVEL 1.0f
+
+static int g_max_substeps = 1;  // 1 = off
+
+typedef struct {
+    int body;
+    int steps;                  // Sub-steps this step (> 1)
+    float start_x, start_y;     // Before integration
+    float start_vel_x, start_vel_y;
+} SubstepBody;
+
+static SubstepBody* g_substep = NULL;
+static int g_substep_count = 0;
+static int g_substep_capacity = 0;
+
+// Region query results (CCD sweeps, sub-steps)
+static Entity** g_query_hits = NULL;
+static int g_query_hits_capacity = 0;
+
+// --- STATIC LAYER ---
+// Statics and sleepers stay in the spatial index's static layer across steps.
+// A static is inserted when its body joins the static run and refreshed only
+// when it is synced or moved (physics_refresh, physics_set_position), so the
+// step never visits it. A sleeper is inserted at the end of the step it falls
+// asleep in. Both are refreshed (spatial_update) only when their AABB, layer or
+// mask changed, and removed when they wake, turn dynamic, lose their collider or
+// are destroyed (physics_remove)
+typedef struct {
+    EntityHandle id;        // ENTITY_HANDLE_NONE = not in the static layer
+    float min_x, min_y, max_x, max_y;
+    uint32_t layer, mask;
+} StaticRecord;
+
+static StaticRecord* g_statics = NULL;  // Per entity slot
+static int g_statics_capacity = 0;
+
+// --- BODY STORAGE (structure of arrays) ---
+// Physics owns its bodies: the hot physics/transform fields of every live entity
+// are kept in packed arrays across steps, and the step's passes (integration,
+// binning, narrow phase, solvers, sleep, sub-steps) only read and write these.
+// A body is added when its entity is spawned and swap-removed when it is
+// destroyed (physics_remove). Entities are synced explicitly: the spawned ones
+// and the ones passed to physics_refresh are queued, and the queue is read at
+// the start of the next step; physics_set_position / physics_set_velocity write
+// both sides right away. After the step, the moving bodies' positions and
+// velocities are written back to their entities (the copy game code reads).
+// The arrays are split in three runs: awake dynamic bodies first, then the
+// sleeping ones, then the statics (mass 0). A body changes run by swapping with
+// the body at the edge of its run (see bodies_move).
+typedef struct {
+    int count;              // Bodies in use
+    int dynamic_count;      // Bodies [0, dynamic_count) are dynamic
+    int awake_count;        // Bodies [0, awake_count) are awake (the rest of the dynamic ones sleep)
+    int capacity;
+
+    Entity **entity;        // Owning entity (for write-back)
+    int *slot;              // Its slot index (sleep state lookups)
+    float *x, *y;           // Position
+    float *vel_x, *vel_y;   // Velocity (px/s)
+    float *friction;        // Linear slowdown (px/s²)
+    float *inv_mass;        // 0 = static
+    float *restitution;
+
+    // Collider (only meaningful when has_collider is set)
+    unsigned char *has_collider;
+    unsigned char *shape;   // ShapeType
+    unsigned char *ccd;     // collider.ccd
+    float *offset_x, *offset_y;
+    float *half_w, *half_h; // Half extents (radius for circles)
+    float *center_x, *center_y; // Collider center (x + offset_x, y + offset_y)
+
+    // Per entity slot
+    int *body_of_slot;      // Body index; -1 = none
+    unsigned char *queued;  // Waiting in g_pending
+    int slot_capacity;
+} PhysicsBodies;
+
+// Runs of the body arrays, front to back
+enum { BODY_AWAKE, BODY_ASLEEP, BODY_STATIC };
+
+static PhysicsBodies g_bodies = {0};
+
+// Entity slots to sync at the start of the next step (spawned, or passed to
+// physics_refresh); each slot is queued at most once
+static int* g_pending = NULL;
+static int g_pending_count = 0;
+static int g_pending_capacity = 0;
+
+// Entities flagged is_colliding this step (cleared at the start of the next)
+static Entity** g_colliding = NULL;
+static int g_colliding_count = 0;
+static int g_colliding_capacity = 0;
+
+static int bodies_reserve(PhysicsBodies *b, int capacity) {
+    if (capacity <= b->capacity) return 1;
+
+    int new_capacity = b->capacity ? b->capacity : 256;
+    while (new_capacity < capacity) new_capacity *= 2;
+
+    // Grow every array; on failure keep the old (still valid) buffers
+    #define BODIES_GROW(field) do { \
+        void *p = realloc(b->field, (size_t)new_capacity * sizeof(*b->field)); \
+        if (!p) return 0; \
+        b->field = p; \
+    } while (0)
+
+    BODIES_GROW(entity);
+    BODIES_GROW(slot);
+    BODIES_GROW(x); BODIES_GROW(y);
+    BODIES_GROW(vel_x); BODIES_GROW(vel_y);
+    BODIES_GROW(friction);
+    BODIES_GROW(inv_mass);
+    BODIES_GROW(restitution);
+    BODIES_GROW(has_collider);
+    BODIES_GROW(shape);
+    BODIES_GROW(ccd);
+    BODIES_GROW(offset_x); BODIES_GROW(offset_y);
+    BODIES_GROW(half_w); BODIES_GROW(half_h);
+    BODIES_GROW(center_x); BODIES_GROW(center_y);
+
+    #undef BODIES_GROW
+
+    b->capacity = new_capacity;
+    return 1;
+}
+
+// Room for entity slots [0, slots) in the per-slot arrays
+static int bodies_reserve_slots(PhysicsBodies *b, int slots) {
+    if (slots <= b->slot_capacity) return 1;
+
+    int new_capacity = b->slot_capacity ? b->slot_capacity : 256;
+    while (new_capacity < slots) new_capacity *= 2;
+
+    int *map = realloc(b->body_of_slot, (size_t)new_capacity * sizeof(int));
+    if (!map) return 0;
+    b->body_of_slot = map;
+    unsigned char *queued = realloc(b->queued, (size_t)new_capacity);
+    if (!queued) return 0;
+    b->queued = queued;
+
+    for (int i = b->slot_capacity; i < new_capacity; i++) {
+        b->body_of_slot[i] = -1;
+        b->queued[i] = 0;
+    }
+    b->slot_capacity = new_capacity;
+    return 1;
+}
+
+static void bodies_free(PhysicsBodies *b) {
+    free(b->entity);
+    free(b->slot);
+    free(b->x); free(b->y);
+    free(b->vel_x); free(b->vel_y);
+    free(b->friction);
+    free(b->inv_mass);
+    free(b->restitution);
+    free(b->has_collider);
+    free(b->shape);
+    free(b->ccd);
+    free(b->offset_x); free(b->offset_y);
+    free(b->half_w); free(b->half_h);
+    free(b->center_x); free(b->center_y);
+    free(b->body_of_slot);
+    free(b->queued);
+    memset(b, 0, sizeof(PhysicsBodies));
+}
+
+// Read entity e into body i
+static void bodies_store(PhysicsBodies *b, int i, Entity *e) {
+    b->entity[i] = e;
+    b->slot[i] = (int)ENTITY_HANDLE_INDEX(e->id);
+    b->x[i] = e->x;
+    b->y[i] = e->y;
+    b->vel_x[i] = e->vel_x;
+    b->vel_y[i] = e->vel_y;
+    b->friction[i] = e->friction;
+    b->inv_mass[i] = (e->mass == 0.0f) ? 0.0f : 1.0f / e->mass;
+    b->restitution[i] = e->restitution;
+    b->body_of_slot[b->slot[i]] = i;
+
+    b->has_collider[i] = (unsigned char)(e->collider.active != 0);
+    b->shape[i] = (unsigned char)e->collider.type;
+    b->ccd[i] = (unsigned char)(e->collider.ccd != 0);
+    b->offset_x[i] = e->collider.offset_x;
+    b->offset_y[i] = e->collider.offset_y;
+    if (e->collider.type == SHAPE_CIRCLE) {
+        b->half_w[i] = e->collider.circle.radius;
+        b->half_h[i] = e->collider.circle.radius;
+    } else { // SHAPE_RECT
+        b->half_w[i] = e->collider.rect.width / 2.0f;
+        b->half_h[i] = e->collider.rect.height / 2.0f;
+    }
+    b->center_x[i] = b->x[i] + b->offset_x[i];
+    b->center_y[i] = b->y[i] + b->offset_y[i];
+}
+
+static void bodies_swap(PhysicsBodies *b, int i, int j) {
+    if (i == j) return;
+
+    #define BODIES_SWAP(type, field) do { \
+        type t = b->field[i]; \
+        b->field[i] = b->field[j]; \
+        b->field[j] = t; \
+    } while (0)
+
+    BODIES_SWAP(Entity*, entity);
+    BODIES_SWAP(int, slot);
+    BODIES_SWAP(float, x); BODIES_SWAP(float, y);
+    BODIES_SWAP(float, vel_x); BODIES_SWAP(float, vel_y);
+    BODIES_SWAP(float, friction);
+    BODIES_SWAP(float, inv_mass);
+    BODIES_SWAP(float, restitution);
+    BODIES_SWAP(unsigned char, has_collider);
+    BODIES_SWAP(unsigned char, shape);
+    BODIES_SWAP(unsigned char, ccd);
+    BODIES_SWAP(float, offset_x); BODIES_SWAP(float, offset_y);
+    BODIES_SWAP(float, half_w); BODIES_SWAP(float, half_h);
+    BODIES_SWAP(float, center_x); BODIES_SWAP(float, center_y);
+
+    #undef BODIES_SWAP
+
+    b->body_of_slot[b->slot[i]] = i;
+    b->body_of_slot[b->slot[j]] = j;
+}
+
+static int body_run(const PhysicsBodies *b, int i) {
+    if (i < b->awake_count) return BODY_AWAKE;
+    return (i < b->dynamic_count) ? BODY_ASLEEP : BODY_STATIC;
+}
+
+// Move body i into another run, one run edge at a time (it swaps with the body at
+// the edge, which keeps its run). Returns its new index
+static int bodies_move(PhysicsBodies *b, int i, int run) {
+    int from = body_run(b, i);
+    while (from > run) {
+        int *edge = (from == BODY_STATIC) ? &b->dynamic_count : &b->awake_count;
+        bodies_swap(b, i, *edge);
+        i = (*edge)++;
+        from--;
+    }
+    while (from < run) {
+        int *edge = (from == BODY_AWAKE) ? &b->awake_count : &b->dynamic_count;
+        bodies_swap(b, i, --(*edge));
+        i = *edge;
+        from++;
+    }
+    return i;
+}
+
+// Swap-remove body i (the last body takes its index)
+static void bodies_remove(PhysicsBodies *b, int i) {
+    int slot = b->slot[bodies_move(b, i, BODY_STATIC)];
+    bodies_swap(b, b->body_of_slot[slot], --b->count);
+    b->body_of_slot[slot] = -1;
+}
+
+// Body of a live entity, or -1 (not synced yet)
+static int body_of(const PhysicsBodies *b, const Entity *e) {
+    uint32_t slot = ENTITY_HANDLE_INDEX(e->id);
+    if (slot >= (uint32_t)b->slot_capacity) return -1;
+    int i = b->body_of_slot[slot];
+    return (i >= 0 && b->entity[i] == e) ? i : -1;
+}
+
+static SleepState* body_sleep(const PhysicsBodies *b, int i) {
+    return &g_sleep[b->slot[i]];
+}
+
+static int sleep_reserve(GameState *state) {
+    if (state->count <= g_sleep_capacity) return 1;
+
+    SleepState *p = realloc(g_sleep, (size_t)state->count * sizeof(SleepState));
+    if (!p) return 0;
+    memset(p + g_sleep_capacity, 0, (size_t)(state->count - g_sleep_capacity) * sizeof(SleepState));
+    for (int i = g_sleep_capacity; i < state->count; i++) {
+        p[i].island = -1;
+        p[i].next = -1;
+        p[i].island_first = -1;
+    }
+    g_sleep = p;
+    g_sleep_capacity = state->count;
+    return 1;
+}
+
+static int ccd_reserve(int count) {
+    if (count <= g_ccd_capacity) return 1;
+
+    CcdBody *p = realloc(g_ccd, (size_t)count * sizeof(CcdBody));
+    if (!p) return 0;
+    g_ccd = p;
+    g_ccd_capacity = count;
+    return 1;
+}
+
+// List the awake bodies flagged ccd (without room for the list, nothing is swept this step)
+static void ccd_collect(const PhysicsBodies *b) {
+    g_ccd_count = 0;
+    if (!ccd_reserve(b->awake_count)) return;
+
+    for (int i = 0; i < b->awake_count; i++) {
+        if (b->ccd[i] && b->has_collider[i]) g_ccd[g_ccd_count++].body = i;
+    }
+}
+
+static int statics_reserve(GameState *state) {
+    if (state->count <= g_statics_capacity) return 1;
+
+    StaticRecord *p = realloc(g_statics, (size_t)state->count * sizeof(StaticRecord));
+    if (!p) return 0;
+    memset(p + g_statics_capacity, 0, (size_t)(state->count - g_statics_capacity) * sizeof(StaticRecord));
+    g_statics = p;
+    g_statics_capacity = state->count;
+    return 1;
+}
+
+// --- STATIC LAYER UPKEEP ---
+
+// Body i is static or asleep: insert it into the static layer, or refresh its
+// entry if its AABB, layer or mask changed since it was last tracked
+static void statics_track(PhysicsBodies *b, int i) {
+    Entity *e = b->entity[i];
+    StaticRecord *r = &g_statics[b->slot[i]];
+    float min_x = b->center_x[i] - b->half_w[i];
+    float min_y = b->center_y[i] - b->half_h[i];
+    float max_x = b->center_x[i] + b->half_w[i];
+    float max_y = b->center_y[i] + b->half_h[i];
+
+    if (r->id != e->id) {
+        spatial_insert_static(g_spatial, e);
+    } else if (r->min_x == min_x && r->min_y == min_y && r->max_x == max_x && r->max_y == max_y &&
+               r->layer == e->collider.layer && r->mask == e->collider.mask) {
+        return;
+    } else {
+        spatial_update(g_spatial, e);
+    }
+
+    r->id = e->id;
+    r->min_x = min_x;
+    r->min_y = min_y;
+    r->max_x = max_x;
+    r->max_y = max_y;
+    r->layer = e->collider.layer;
+    r->mask = e->collider.mask;
+}
+
+// Body i woke up or lost its collider: drop its static-layer entry, if any
+static inline void statics_untrack(PhysicsBodies *b, int i) {
+    StaticRecord *r = &g_statics[b->slot[i]];
+    if (r->id == ENTITY_HANDLE_NONE) return;
+    spatial_remove(g_spatial, b->entity[i]);
+    r->id = ENTITY_HANDLE_NONE;
+}
+
+// Static or sleeping body i was added or changed (synced, moved by the game, put
+// to sleep, or the index was recreated): the only times its entry is touched
+static void statics_refresh(PhysicsBodies *b, int i) {
+    if (!g_spatial) return;
+    if (b->has_collider[i]) {
+        statics_track(b, i);
+    } else {
+        statics_untrack(b, i);
+    }
+}
+
+// --- SLEEPING ISLANDS ---
+
+// Asleep, or put to sleep this step (it leaves the awake run when the step ends)
+static int body_asleep(const PhysicsBodies *b, int i) {
+    if (i < 0 || i >= b->dynamic_count || b->slot[i] >= g_sleep_capacity) return 0;
+    return body_sleep(b, i)->island >= 0;
+}
+
+// Wake the island labelled 'label': its sleepers join the awake run and move from
+// the static layer to the moving one. Only sleepers change index (each swaps with
+// the first sleeper), so awake and static bodies keep theirs
+static void sleep_wake_island(PhysicsBodies *b, int label) {
+    int slot = g_sleep[label].island_first;
+    g_sleep[label].island_first = -1;
+
+    while (slot >= 0) {
+        SleepState *s = &g_sleep[slot];
+        int next = s->next;
+        s->island = -1;
+        s->next = -1;
+        s->still_time = 0.0f;
+
+        int i = b->body_of_slot[slot];
+        if (i >= b->awake_count) {
+            i = bodies_move(b, i, BODY_AWAKE);
+            statics_untrack(b, i);
+            if (g_spatial && b->has_collider[i]) {
+                spatial_insert_bounds(g_spatial, b->entity[i],
+                                      b->center_x[i] - b->half_w[i], b->center_y[i] - b->half_h[i],
+                                      b->center_x[i] + b->half_w[i], b->center_y[i] + b->half_h[i]);
+            }
+        }
+        slot = next;
+    }
+}
+
+// Body i was hit outside the contact list (sub-steps, the pair-by-pair fallback)
+static void sleep_wake_body(PhysicsBodies *b, int i) {
+    if (body_asleep(b, i)) sleep_wake_island(b, body_sleep(b, i)->island);
+}
+
+// End of the step: the bodies put to sleep this step leave the awake run for the
+// sleeping one, and the moving layer for the static one
+static void sleep_settle(PhysicsBodies *b) {
+    if (g_sleep_settling == 0) return;
+    g_sleep_settling = 0;
+
+    for (int i = b->awake_count - 1; i >= 0; i--) {
+        if (!body_asleep(b, i)) continue;
+        int k = bodies_move(b, i, BODY_ASLEEP);
+        if (g_spatial) spatial_remove(g_spatial, b->entity[k]);  // Its moving-layer entry
+        statics_refresh(b, k);
+    }
+}
+
+// Read the queued entities into their bodies, adding the new ones: a body with
+// mass 0 goes to the statics, a dynamic one stays awake (a sleeper's island wakes,
+// a static that gained mass starts awake)
+static int bodies_sync(PhysicsBodies *b, GameState *state) {
+    if (!bodies_reserve(b, state->live_count) || !bodies_reserve_slots(b, state->count) ||
+        !statics_reserve(state)) {
+        printf("Physics: CRITICAL - Out of memory for %d bodies\n", state->live_count);
+        return 0;
+    }
+
+    for (int k = 0; k < g_pending_count; k++) {
+        int slot = g_pending[k];
+        b->queued[slot] = 0;
+        if (slot >= state->count) continue;     // Left over from an earlier GameState
+        Entity *e = entity_at(state, slot);
+        if (!e->active) continue;               // Destroyed since (physics_remove dropped its body)
+
+        int i = b->body_of_slot[slot];
+        if (i < 0) {
+            i = b->count++;                     // New: starts at the end of the statics
+            if (slot < g_sleep_capacity) {
+                g_sleep[slot].island = -1;
+                g_sleep[slot].still_time = 0.0f;
+            }
+        } else if (body_asleep(b, i)) {
+            sleep_wake_island(b, body_sleep(b, i)->island);
+            i = b->body_of_slot[slot];
+        }
+        bodies_store(b, i, e);
+
+        int from = body_run(b, i);
+        int run = (e->mass == 0.0f) ? BODY_STATIC : BODY_AWAKE;
+        i = bodies_move(b, i, run);
+        if (run == BODY_STATIC) {
+            statics_refresh(b, i);
+        } else if (from == BODY_STATIC) {
+            statics_untrack(b, i);
+        }
+    }
+    g_pending_count = 0;
+    return 1;
+}
+
+static void colliding_mark(Entity *e) {
+    if (e->collider.is_colliding) return;
+    if (g_colliding_count == g_colliding_capacity) {
+        int new_capacity = g_colliding_capacity ? g_colliding_capacity * 2 : 256;
+        Entity **p = realloc(g_colliding, (size_t)new_capacity * sizeof(Entity*));
+        if (!p) return;  // Out of memory: left unflagged
+        g_colliding = p;
+        g_colliding_capacity = new_capacity;
+    }
+    e->collider.is_colliding = 1;
+    g_colliding[g_colliding_count++] = e;
+}
+
+// Reset last step's collision debug flags
+static void colliding_clear(void) {
+    for (int i = 0; i < g_colliding_count; i++) g_colliding[i]->collider.is_colliding = 0;
+    g_colliding_count = 0;
+}
+
+// Apply velocity and linear friction to bodies [start, end)
+// Runs the widest SIMD kernel the CPU supports (see physics_simd.c)
+static void bodies_integrate(PhysicsBodies *b, int start, int end, float dt) {
+    if (end <= start) return;
+    simd_integrate(b->x + start, b->y + start, b->vel_x + start, b->vel_y + start,
+                   b->friction + start, end - start, dt);
+}
+
+static inline void body_recenter(PhysicsBodies *b, int i) {
+    b->center_x[i] = b->x[i] + b->offset_x[i];
+    b->center_y[i] = b->y[i] + b->offset_y[i];
+}
+
+// Write the awake bodies' positions and velocities back to their entities
+// (sleepers don't move; the ones woken this step are in the awake run)
+static void bodies_publish(const PhysicsBodies *b) {
+    for (int i = 0; i < b->awake_count; i++) {
+        Entity *e = b->entity[i];
+        e->x = b->x[i];
+        e->y = b->y[i];
+        e->vel_x = b->vel_x[i];
+        e->vel_y = b->vel_y[i];
+    }
+}
+
+// --- CONTACTS ON THE BODY ARRAYS ---
+// Same arithmetic as the Entity versions below (the centers and half extents are
+// computed the same way), so they give the same results
+
+static Manifold bodies_rect_rect(const PhysicsBodies *b, int ia, int ib) {
+    Manifold m = {0};
+
+    float dx = b->center_x[ib] - b->center_x[ia];
+    float dy = b->center_y[ib] - b->center_y[ia];
+    float overlap_x = (b->half_w[ia] + b->half_w[ib]) - fabsf(dx);
+    float overlap_y = (b->half_h[ia] + b->half_h[ib]) - fabsf(dy);
+    if (overlap_x <= 0 || overlap_y <= 0) return m;
+
+    m.hit = 1;
+    if (overlap_x < overlap_y) {
+        m.depth = overlap_x;
+        m.normal_x = (dx < 0) ? -1.0f : 1.0f;
+        m.normal_y = 0;
+    } else {
+        m.depth = overlap_y;
+        m.normal_x = 0;
+        m.normal_y = (dy < 0) ? -1.0f : 1.0f;
+    }
+    return m;
+}
+
+// check_collision_dispatch for bodies ia and ib (circles go through the SIMD
+// kernels one pair at a time, like the narrow phase's leftovers)
+static Manifold bodies_check(const PhysicsBodies *b, int ia, int ib) {
+    Manifold m = {0};
+    int out = 0;
+    int circle_a = b->shape[ia] == SHAPE_CIRCLE;
+    int circle_b = b->shape[ib] == SHAPE_CIRCLE;
+
+    if (circle_a && circle_b) {
+        simd_circle_circle(b->center_x, b->center_y, b->half_w, &ia, &ib, 1, &out, &m);
+    } else if (circle_a && b->shape[ib] == SHAPE_RECT) {
+        simd_circle_rect(b->center_x, b->center_y, b->half_w, b->half_h, &ia, &ib, 1, &out, &m);
+    } else if (circle_b && b->shape[ia] == SHAPE_RECT) {
+        simd_circle_rect(b->center_x, b->center_y, b->half_w, b->half_h, &ib, &ia, 1, &out, &m);
+        if (m.hit) {
+            m.normal_x *= -1;  // Kernel normal is circle -> rect
+            m.normal_y *= -1;
+        }
+    } else if (b->shape[ia] == SHAPE_RECT && b->shape[ib] == SHAPE_RECT) {
+        m = bodies_rect_rect(b, ia, ib);
+    }
+    return m;
+}
+
+
+// resolve_collision on the body arrays (same arithmetic, so the same result);
+// static bodies are only read
+static void bodies_resolve(PhysicsBodies *b, int ia, int ib, const Manifold *m) {
+    float inv_mass_a = b->inv_mass[ia];
+    float inv_mass_b = b->inv_mass[ib];
+    float total_inv_mass = inv_mass_a + inv_mass_b;
+
+    if (total_inv_mass == 0.0f) return;
+
+    // Separation
+    float move_per_inv_mass = m->depth / total_inv_mass;
+    if (inv_mass_a > 0.0f) {
+        b->x[ia] -= m->normal_x * move_per_inv_mass * inv_mass_a;
+        b->y[ia] -= m->normal_y * move_per_inv_mass * inv_mass_a;
+    }
+    if (inv_mass_b > 0.0f) {
+        b->x[ib] += m->normal_x * move_per_inv_mass * inv_mass_b;
+        b->y[ib] += m->normal_y * move_per_inv_mass * inv_mass_b;
+    }
+
+    // Impulse
+    float rv_x = b->vel_x[ib] - b->vel_x[ia];
+    float rv_y = b->vel_y[ib] - b->vel_y[ia];
+    float vel_along_normal = (rv_x * m->normal_x) + (rv_y * m->normal_y);
+    if (vel_along_normal > 0) return;
+
+    float e = fminf(b->restitution[ia], b->restitution[ib]);
+    float j = -(1.0f + e) * vel_along_normal;
+    j /= total_inv_mass;
+
+    float impulse_x = m->normal_x * j;
+    float impulse_y = m->normal_y * j;
+    if (inv_mass_a > 0.0f) {
+        b->vel_x[ia] -= impulse_x * inv_mass_a;
+        b->vel_y[ia] -= impulse_y * inv_mass_a;
+    }
+    if (inv_mass_b > 0.0f) {
+        b->vel_x[ib] += impulse_x * inv_mass_b;
+        b->vel_y[ib] += impulse_y * inv_mass_b;
+    }
+}
+
+
+// Test bodies ia and ib and resolve a hit right away (the paths that go one
+// pair at a time); the centers follow the bodies, so later tests see the move.
+// Returns whether they touched
+static int bodies_collide(PhysicsBodies *b, int ia, int ib) {
+    Manifold m = bodies_check(b, ia, ib);
+    if (!m.hit) return 0;
+
+    colliding_mark(b->entity[ia]);
+    colliding_mark(b->entity[ib]);
+    bodies_resolve(b, ia, ib, &m);
+    body_recenter(b, ia);
+    body_recenter(b, ib);
+    return 1;
+}
 
 
 // Set of colission checks for different shapes
@@ -150,6 +921,7 @@ Manifold check_circle_rect(const Entity *a, const Entity *b) {
 
 
 // Check collision dispatch
+// Only reads the entities (the narrow phase calls it from worker threads)
 Manifold check_collision_dispatch(const Entity *a, const Entity *b) {
     Manifold m = {0};
     int type_a = a->collider.type;
@@ -227,23 +999,63 @@ void resolve_collision(Entity *a, Entity *b, Manifold *m) {
 // --- PHYSICS LIFECYCLE ---
 
 void physics_init(float world_width, float world_height, float cell_size) {
-    if (g_spatial) {
-        spatial_destroy(g_spatial);
-    }
-    
     SpatialConfig config = {
         .type = SPATIAL_TYPE_GRID,
         .world_width = world_width,
         .world_height = world_height,
         .cell_size = cell_size
     };
+    // No cell size given: let each collider pick a grid level that fits it
+    if (cell_size <= 0.0f) config.type = SPATIAL_TYPE_HGRID;
+    physics_init_spatial(config);
+}
+
+void physics_init_spatial(SpatialConfig config) {
+    if (g_spatial) {
+        spatial_destroy(g_spatial);
+    }
+    
+    int threads = jobs_init(g_thread_request);
     
     g_spatial = spatial_create(config);
     
+    // The new index is empty: the sleepers and statics go in again now (the awake
+    // bodies on the next step)
+    for (int i = 0; i < g_statics_capacity; i++) g_statics[i].id = ENTITY_HANDLE_NONE;
+    for (int i = g_bodies.awake_count; i < g_bodies.count; i++) statics_refresh(&g_bodies, i);
+    
     if (g_spatial) {
         SpatialStats stats = spatial_get_stats(g_spatial);
-        printf("Physics: Spatial grid initialized (%d cells, %.0fx%.0f world, %.0f cell size)\n",
-               stats.total_cells, world_width, world_height, cell_size);
+        if (config.type == SPATIAL_TYPE_HASH) {
+            printf("Physics: Spatial hash initialized (%d slots, unbounded world, %.0f cell size)\n",
+                   stats.total_cells, config.cell_size);
+        } else if (config.type == SPATIAL_TYPE_SAP) {
+            printf("Physics: Sweep and prune initialized (unbounded world)\n");
+        } else if (config.type == SPATIAL_TYPE_BVH) {
+            printf("Physics: AABB tree initialized (unbounded world, %.0f margin)\n",
+                   config.bvh_margin > 0.0f ? config.bvh_margin : 8.0f);
+        } else if (config.type == SPATIAL_TYPE_HGRID) {
+            printf("Physics: Hierarchical grid initialized (unbounded world, cells sized per collider)\n");
+        } else if (config.type == SPATIAL_TYPE_QUADTREE) {
+            printf("Physics: Loose quadtree initialized (%.0fx%.0f world, depth %d)\n",
+                   config.world_width, config.world_height,
+                   config.quadtree_depth > 0 ? config.quadtree_depth : 8);
+        } else {
+            printf("Physics: Spatial grid initialized (%d cells, %.0fx%.0f world, %.0f cell size)\n",
+                   stats.total_cells, config.world_width, config.world_height, config.cell_size);
+        }
+        if (config.tuning.enabled &&
+            (config.type == SPATIAL_TYPE_GRID || config.type == SPATIAL_TYPE_HASH)) {
+            printf("Physics: Adaptive cell size on (%.1f per cell target, %d frame window)\n",
+                   config.tuning.target_per_cell > 0.0f ? config.tuning.target_per_cell : 4.0f,
+                   config.tuning.window > 0 ? config.tuning.window : 120);
+        }
+        if (config.use_static_type && config.static_type == SPATIAL_TYPE_BVH &&
+            config.type != SPATIAL_TYPE_BVH) {
+            printf("Physics: Static colliders use an AABB tree\n");
+        }
+        printf("Physics: Using %s integration kernel\n", simd_level_name(simd_get_level()));
+        printf("Physics: Narrow phase on %d thread(s)\n", threads);
     } else {
         printf("Physics: WARNING - Failed to create spatial index, using O(n^2) fallback\n");
     }
@@ -254,94 +1066,1135 @@ void physics_shutdown(void) {
         spatial_destroy(g_spatial);
         g_spatial = NULL;
     }
+    bodies_free(&g_bodies);
+    free(g_pending);
+    g_pending = NULL;
+    g_pending_count = 0;
+    g_pending_capacity = 0;
+    free(g_colliding);
+    g_colliding = NULL;
+    g_colliding_count = 0;
+    g_colliding_capacity = 0;
+    free(g_statics);
+    g_statics = NULL;
+    g_statics_capacity = 0;
+    spatial_pair_list_free(&g_pairs);
+    free(g_contacts);
+    g_contacts = NULL;
+    g_contact_capacity = 0;
+    free(g_batched);
+    free(g_batch_of);
+    free(g_body_batches);
+    g_batched = NULL;
+    g_batch_of = NULL;
+    g_body_batches = NULL;
+    g_batched_capacity = 0;
+    g_body_batches_capacity = 0;
+    free(g_solver_contacts);
+    g_solver_contacts = NULL;
+    g_solver_contact_capacity = 0;
+    for (int i = 0; i < 2; i++) {
+        free(g_impulse_cache[i]);
+        g_impulse_cache[i] = NULL;
+        g_impulse_cache_capacity[i] = 0;
+    }
+    free(g_sleep);
+    free(g_island_parent);
+    free(g_island_still);
+    g_sleep = NULL;
+    g_island_parent = NULL;
+    g_island_still = NULL;
+    g_sleep_capacity = 0;
+    g_island_capacity = 0;
+    free(g_ccd);
+    free(g_query_hits);
+    g_ccd = NULL;
+    g_query_hits = NULL;
+    g_ccd_count = 0;
+    g_ccd_capacity = 0;
+    g_query_hits_capacity = 0;
+    free(g_substep);
+    g_substep = NULL;
+    g_substep_count = 0;
+    g_substep_capacity = 0;
+    jobs_shutdown();
 }
 
-// --- PHYSICS UPDATE ---
+void physics_set_threads(int count) {
+    g_thread_request = count;
+    printf("Physics: Narrow phase on %d thread(s)\n", jobs_init(count));
+}
 
-void physics_update(GameState *state, float dt) {
-    // Apply velocity and drag to all dynamic entities
-    for (int i = 0; i < state->count; i++) {
-        Entity *e = &state->entities[i];
-        if (!e->active || e->mass == 0.0f) continue;
-
-        // Apply position update
-        e->x += e->vel_x * dt;
-        e->y += e->vel_y * dt;
-        
-        // Apply friction (linear slowdown toward zero)
-        // This slows down objects that were pushed/bumped
-        e->vel_x = move_towardf(e->vel_x, 0.0f, e->friction * dt);
-        e->vel_y = move_towardf(e->vel_y, 0.0f, e->friction * dt);
+void physics_set_solver(PhysicsSolver solver) {
+    g_solver = solver;
+    if (solver == PHYSICS_SOLVER_ITERATIVE) {
+        printf("Physics: Iterative contact solver (%d iterations, warm started)\n", g_iterations);
+    } else {
+        printf("Physics: %s contact solver\n",
+               solver == PHYSICS_SOLVER_BATCHED ? "Batched (parallel)" : "Serial");
     }
+}
 
-    // Reset collision flags
-    for (int i = 0; i < state->count; i++) {
-        state->entities[i].collider.is_colliding = 0;
+void physics_set_iterations(int iterations) {
+    g_iterations = (iterations < 1) ? 1 : iterations;
+}
+
+void physics_set_substeps(int max_substeps) {
+    g_max_substeps = (max_substeps < 1) ? 1 : max_substeps;
+    if (g_max_substeps > 1) {
+        printf("Physics: Fast bodies take up to %d sub-steps\n", g_max_substeps);
+    } else {
+        printf("Physics: Sub-stepping off\n");
     }
+}
+
+void physics_set_sleep(float speed, float time) {
+    g_sleep_speed = (speed > 0.0f) ? speed : 0.0f;
+    g_sleep_time = (time > 0.0f) ? time : 0.0f;
+
+    if (g_sleep_speed > 0.0f) {
+        printf("Physics: Sleeping on (under %.1f px/s for %.2f s)\n", g_sleep_speed, g_sleep_time);
+    } else {
+        // Everyone wakes up
+        PhysicsBodies *b = &g_bodies;
+        for (int i = b->awake_count; i < b->dynamic_count; i++) statics_untrack(b, i);
+        b->awake_count = b->dynamic_count;
+        for (int i = 0; i < g_sleep_capacity; i++) {
+            g_sleep[i].island = -1;
+            g_sleep[i].still_time = 0.0f;
+            g_sleep[i].next = -1;
+            g_sleep[i].island_first = -1;
+        }
+        printf("Physics: Sleeping off\n");
+    }
+}
+
+void physics_wake(Entity *e) {
+    if (!e || ENTITY_HANDLE_INDEX(e->id) >= (uint32_t)g_sleep_capacity) return;
+
+    SleepState *s = &g_sleep[ENTITY_HANDLE_INDEX(e->id)];
+    if (s->id != e->id) return;
+    sleep_wake_body(&g_bodies, body_of(&g_bodies, e));
+    s->still_time = 0.0f;
+}
+
+void physics_refresh(Entity *e) {
+    if (!e || !e->active) return;
+
+    PhysicsBodies *b = &g_bodies;
+    int slot = (int)ENTITY_HANDLE_INDEX(e->id);
+    if (!bodies_reserve_slots(b, slot + 1)) {
+        printf("Physics: CRITICAL - Out of memory for entity slot %d\n", slot);
+        return;
+    }
+    if (b->queued[slot]) return;
+
+    if (g_pending_count == g_pending_capacity) {
+        int new_capacity = g_pending_capacity ? g_pending_capacity * 2 : 256;
+        int *p = realloc(g_pending, (size_t)new_capacity * sizeof(int));
+        if (!p) {
+            printf("Physics: CRITICAL - Out of memory for entity slot %d\n", slot);
+            return;
+        }
+        g_pending = p;
+        g_pending_capacity = new_capacity;
+    }
+    b->queued[slot] = 1;
+    g_pending[g_pending_count++] = slot;
+}
+
+void physics_set_position(Entity *e, float x, float y) {
+    if (!e) return;
+    e->x = x;
+    e->y = y;
+
+    PhysicsBodies *b = &g_bodies;
+    int i = body_of(b, e);
+    if (i < 0) return;  // Not synced yet: read from the entity then
+    if (b->x[i] != x || b->y[i] != y) {
+        sleep_wake_body(b, i);
+        i = body_of(b, e);
+    }
+    b->x[i] = x;
+    b->y[i] = y;
+    body_recenter(b, i);
+    if (i >= b->dynamic_count) statics_refresh(b, i);
+}
+
+void physics_set_velocity(Entity *e, float vel_x, float vel_y) {
+    if (!e) return;
+    e->vel_x = vel_x;
+    e->vel_y = vel_y;
+
+    PhysicsBodies *b = &g_bodies;
+    int i = body_of(b, e);
+    if (i < 0) return;
+    if (vel_x != 0.0f || vel_y != 0.0f) {
+        sleep_wake_body(b, i);
+        i = body_of(b, e);
+    }
+    b->vel_x[i] = vel_x;
+    b->vel_y[i] = vel_y;
+}
+
+void physics_remove(Entity *e) {
+    if (!e) return;
+
+    int i = body_of(&g_bodies, e);
+    if (i >= 0) {
+        sleep_wake_body(&g_bodies, i);  // The rest of its island can't stay propped up
+        bodies_remove(&g_bodies, body_of(&g_bodies, e));
+    }
+
+    uint32_t slot = ENTITY_HANDLE_INDEX(e->id);
+    if (slot < (uint32_t)g_statics_capacity && g_statics[slot].id == e->id) {
+        g_statics[slot].id = ENTITY_HANDLE_NONE;
+    }
+    if (g_spatial) spatial_remove(g_spatial, e);
+}
+
+int physics_is_sleeping(const Entity *e) {
+    if (!e || ENTITY_HANDLE_INDEX(e->id) >= (uint32_t)g_sleep_capacity) return 0;
+
+    const SleepState *s = &g_sleep[ENTITY_HANDLE_INDEX(e->id)];
+    return s->id == e->id && s->island >= 0;
+}
+
+// --- GAME QUERIES ---
+// Forwarded to the broad phase's index (see physics.h for what they see)
+
+int physics_query_box(float min_x, float min_y, float max_x, float max_y,
+                      uint32_t mask, Entity **out, int max_out) {
+    return spatial_query_box(g_spatial, min_x, min_y, max_x, max_y, mask, out, max_out);
+}
+
+int physics_query_point(float x, float y, uint32_t mask, Entity **out, int max_out) {
+    return spatial_query_point(g_spatial, x, y, mask, out, max_out);
+}
+
+int physics_query_segment(float x0, float y0, float x1, float y1,
+                          uint32_t mask, Entity **out, int max_out) {
+    return spatial_query_segment(g_spatial, x0, y0, x1, y1, mask, out, max_out);
+}
+
+// No index (physics_init not called yet): every cast misses
+static void cast_miss(float x1, float y1, SpatialHit *out) {
+    out->entity = NULL;
+    out->x = x1;
+    out->y = y1;
+    out->normal_x = 0.0f;
+    out->normal_y = 0.0f;
+    out->fraction = 1.0f;
+}
+
+int physics_raycast(float x0, float y0, float x1, float y1, uint32_t mask, SpatialHit *out) {
+    if (!out) return 0;
+    if (!g_spatial) {
+        cast_miss(x1, y1, out);
+        return 0;
+    }
+    return spatial_raycast(g_spatial, x0, y0, x1, y1, mask, out);
+}
+
+int physics_shapecast(float x0, float y0, float x1, float y1, float radius,
+                      uint32_t mask, SpatialHit *out) {
+    if (!out) return 0;
+    if (!g_spatial) {
+        cast_miss(x1, y1, out);
+        return 0;
+    }
+    return spatial_shapecast(g_spatial, x0, y0, x1, y1, radius, mask, out);
+}
+
+int physics_raycast_batch(const SpatialRay *rays, int count, uint32_t mask, SpatialHit *out) {
+    if (!rays || !out) return 0;
+    if (!g_spatial) {
+        for (int i = 0; i < count; i++) cast_miss(rays[i].x1, rays[i].y1, &out[i]);
+        return 0;
+    }
+    return spatial_raycast_batch(g_spatial, rays, count, mask, out);
+}
+
+// --- REGION QUERIES ---
+
+// Bodies from both layers whose AABB touches the box, into g_query_hits. The
+// AABBs come from the body arrays: mid-step the entities still hold the positions
+// of the last step
+static int query_region(float min_x, float min_y, float max_x, float max_y) {
+    const PhysicsBodies *b = &g_bodies;
+    for (;;) {
+        int n = spatial_query_box_candidates(g_spatial, min_x, min_y, max_x, max_y,
+                                             g_query_hits, g_query_hits_capacity);
+        if (n < g_query_hits_capacity) {
+            int found = 0;
+            for (int k = 0; k < n; k++) {
+                int i = b->body_of_slot[ENTITY_HANDLE_INDEX(g_query_hits[k]->id)];
+                if (b->center_x[i] + b->half_w[i] < min_x || b->center_x[i] - b->half_w[i] > max_x) continue;
+                if (b->center_y[i] + b->half_h[i] < min_y || b->center_y[i] - b->half_h[i] > max_y) continue;
+                g_query_hits[found++] = g_query_hits[k];
+            }
+            return found;
+        }
+
+        // Full: grow and ask again
+        int new_capacity = g_query_hits_capacity ? g_query_hits_capacity * 2 : 64;
+        Entity **p = realloc(g_query_hits, (size_t)new_capacity * sizeof(Entity*));
+        if (!p) return n;
+        g_query_hits = p;
+        g_query_hits_capacity = new_capacity;
+    }
+}
+
+// --- CONTINUOUS COLLISION ---
+
+// Clip [t_enter, t_exit] to the times o + t*d is within e of 0 on one axis
+static int sweep_slab(float o, float d, float e, float *t_enter, float *t_exit) {
+    if (d == 0.0f) return fabsf(o) < e; // Parallel: always inside the slab or never
+
+    float t0 = (-e - o) / d;
+    float t1 = (e - o) / d;
+    if (t0 > t1) { float t = t0; t0 = t1; t1 = t; }
+    if (t0 > *t_enter) *t_enter = t0;
+    if (t1 < *t_exit) *t_exit = t1;
+    return *t_enter <= *t_exit;
+}
+
+// First t in [0, 1] at which the point (ox, oy) + t * (dx, dy) touches the box
+// at (cx, cy) with half extents hw/hh grown by 'radius' (round corners). That's
+// where a moving shape first touches a still one: the box is the still shape
+// grown by the moving one. Returns 2 for no hit. A point already inside hits at
+// 0 if it's heading deeper (it could come out the far side; staying put leaves
+// the overlap to the narrow phase) and misses if it's on its way out
+static float sweep_rounded_box(float ox, float oy, float dx, float dy,
+                               float cx, float cy, float hw, float hh, float radius) {
+    const float miss = 2.0f;
+    float px = ox - cx;
+    float py = oy - cy;
+
+    // Box grown by the radius, square corners
+    float t_enter = -FLT_MAX, t_exit = FLT_MAX;
+    if (!sweep_slab(px, dx, hw + radius, &t_enter, &t_exit)) return miss;
+    if (!sweep_slab(py, dy, hh + radius, &t_enter, &t_exit)) return miss;
+    if (t_exit < 0.0f || t_enter > 1.0f) return miss;
+
+    if (t_enter < 0.0f) {
+        // Starts in the grown box: overlapping, unless it's outside a round corner
+        float qx = fabsf(px) - hw;
+        float qy = fabsf(py) - hh;
+        if (qx > 0.0f && qy > 0.0f) {
+            if (qx*qx + qy*qy < radius*radius) {
+                // In a round corner: out is away from the corner
+                return (dx * copysignf(qx, px) + dy * copysignf(qy, py) < 0.0f) ? 0.0f : miss;
+            }
+            t_enter = 0.0f;
+        } else if (qx > qy) {
+            return (dx * px < 0.0f) ? 0.0f : miss;  // Shallowest out along x
+        } else {
+            return (dy * py < 0.0f) ? 0.0f : miss;
+        }
+    }
+
+    float hx = px + dx * t_enter;
+    float hy = py + dy * t_enter;
+    if (radius <= 0.0f || fabsf(hx) <= hw || fabsf(hy) <= hh) return t_enter; // Hit a side
+
+    // Entered a corner square: the hit (if any) is on the corner's circle
+    float fx = px - ((hx < 0.0f) ? -hw : hw);
+    float fy = py - ((hy < 0.0f) ? -hh : hh);
+    float a = dx*dx + dy*dy;
+    float b = fx*dx + fy*dy;
+    float c = fx*fx + fy*fy - radius*radius;
+    float disc = b*b - a*c;
+    if (b >= 0.0f || disc < 0.0f) return miss;  // Moving away, or passing the corner
+
+    float t = (-b - sqrtf(disc)) / a;
+    return (t <= 1.0f) ? t : miss;
+}
+
+// Record where the flagged bodies start the step
+static void ccd_begin(const PhysicsBodies *b) {
+    for (int k = 0; k < g_ccd_count; k++) {
+        g_ccd[k].start_x = b->x[g_ccd[k].body];
+        g_ccd[k].start_y = b->y[g_ccd[k].body];
+    }
+}
+
+// Whether a flagged body moved far enough this step to be swept
+static int ccd_fast(const PhysicsBodies *b, const CcdBody *c) {
+    int i = c->body;
+    if (i >= b->awake_count || !b->has_collider[i]) return 0;
+
+    float dx = b->x[i] - c->start_x;
+    float dy = b->y[i] - c->start_y;
+    float size = fminf(b->half_w[i], b->half_h[i]);
+    return dx*dx + dy*dy > size*size;
+}
+
+// Grow the broad-phase entries of the fast bodies to cover their whole motion,
+// so this step's pairs include whatever the sweep stops them against.
+// Call after the bodies are inserted, before anything queries the index
+static void ccd_insert_swept(const PhysicsBodies *b) {
+    for (int k = 0; k < g_ccd_count; k++) {
+        if (!ccd_fast(b, &g_ccd[k])) continue;
+
+        int i = g_ccd[k].body;
+        float x0 = g_ccd[k].start_x + b->offset_x[i];
+        float y0 = g_ccd[k].start_y + b->offset_y[i];
+        float x1 = b->center_x[i];
+        float y1 = b->center_y[i];
+        spatial_insert_bounds(g_spatial, b->entity[i],
+                              fminf(x0, x1) - b->half_w[i], fminf(y0, y1) - b->half_h[i],
+                              fmaxf(x0, x1) + b->half_w[i], fmaxf(y0, y1) + b->half_h[i]);
+    }
+}
+
+// Sweep the fast bodies (in body order) and move each back to its first hit
+static void ccd_sweep(PhysicsBodies *b) {
+    for (int k = 0; k < g_ccd_count; k++) {
+        if (!ccd_fast(b, &g_ccd[k])) continue;
+
+        int i = g_ccd[k].body;
+        Entity *e = b->entity[i];
+        float x0 = g_ccd[k].start_x + b->offset_x[i];
+        float y0 = g_ccd[k].start_y + b->offset_y[i];
+        float dx = b->center_x[i] - x0;
+        float dy = b->center_y[i] - y0;
+
+        // Swept shrunk by the skin, so the real shape ends up CCD_SKIN into the hit
+        float skin = fminf(CCD_SKIN, 0.5f * fminf(b->half_w[i], b->half_h[i]));
+        float self_w = b->half_w[i] - skin;
+        float self_h = b->half_h[i] - skin;
+        int self_circle = (b->shape[i] == SHAPE_CIRCLE);
+
+        int found = query_region(fminf(x0, b->center_x[i]) - b->half_w[i],
+                                 fminf(y0, b->center_y[i]) - b->half_h[i],
+                                 fmaxf(x0, b->center_x[i]) + b->half_w[i],
+                                 fmaxf(y0, b->center_y[i]) + b->half_h[i]);
+
+        float t_hit = 1.0f;
+        for (int h = 0; h < found; h++) {
+            Entity *o = g_query_hits[h];
+            if (o == e) continue;
+            if (!((e->collider.mask & o->collider.layer) || (o->collider.mask & e->collider.layer))) continue;
+
+            // Target grown by this body: a box with round corners
+            int j = b->body_of_slot[ENTITY_HANDLE_INDEX(o->id)];
+            float hw = 0.0f, hh = 0.0f, radius = 0.0f;
+            if (b->shape[j] == SHAPE_CIRCLE) {
+                radius += b->half_w[j];
+            } else {
+                hw += b->half_w[j];
+                hh += b->half_h[j];
+            }
+            if (self_circle) {
+                radius += self_w;
+            } else {
+                hw += self_w;
+                hh += self_h;
+            }
+
+            float t = sweep_rounded_box(x0, y0, dx, dy, b->center_x[j], b->center_y[j], hw, hh, radius);
+            if (t < t_hit) t_hit = t;
+        }
+        if (t_hit >= 1.0f) continue;
+
+        b->x[i] = g_ccd[k].start_x + dx * t_hit;
+        b->y[i] = g_ccd[k].start_y + dy * t_hit;
+        body_recenter(b, i);
+    }
+}
+
+// --- SUB-STEPPING ---
+
+static int substep_reserve(int count) {
+    if (count <= g_substep_capacity) return 1;
+
+    int new_capacity = g_substep_capacity ? g_substep_capacity : 64;
+    while (new_capacity < count) new_capacity *= 2;
+
+    SubstepBody *p = realloc(g_substep, (size_t)new_capacity * sizeof(SubstepBody));
+    if (!p) return 0;
+    g_substep = p;
+    g_substep_capacity = new_capacity;
+    return 1;
+}
+
+// Pick the awake bodies too fast for one step (before integration)
+static void substep_select(const PhysicsBodies *b, float dt) {
+    g_substep_count = 0;
+    if (g_max_substeps <= 1 || !g_spatial) return;
+
+    for (int i = 0; i < b->awake_count; i++) {
+        if (!b->has_collider[i]) continue;
+
+        float limit = SUBSTEP_TRAVEL * fminf(b->half_w[i], b->half_h[i]);
+        float travel_sq = (b->vel_x[i] * b->vel_x[i] + b->vel_y[i] * b->vel_y[i]) * dt * dt;
+        if (travel_sq <= limit * limit || b->ccd[i]) continue;
+
+        int steps = g_max_substeps;
+        if (limit > 0.0f) {
+            float needed = ceilf(sqrtf(travel_sq) / limit);
+            if (needed < (float)steps) steps = (int)needed;
+        }
+        if (!substep_reserve(g_substep_count + 1)) return;  // The rest take one step
+
+        SubstepBody *s = &g_substep[g_substep_count++];
+        s->body = i;
+        s->steps = steps;
+        s->start_x = b->x[i];
+        s->start_y = b->y[i];
+        s->start_vel_x = b->vel_x[i];
+        s->start_vel_y = b->vel_y[i];
+    }
+}
+
+// Redo the fast bodies' integration as their first sub-step (after bodies_integrate)
+static void substep_first(PhysicsBodies *b, float dt) {
+    for (int k = 0; k < g_substep_count; k++) {
+        const SubstepBody *s = &g_substep[k];
+        int i = s->body;
+        float h = dt / (float)s->steps;
+        b->x[i] = s->start_x + s->start_vel_x * h;
+        b->y[i] = s->start_y + s->start_vel_y * h;
+        b->vel_x[i] = move_towardf(s->start_vel_x, 0.0f, b->friction[i] * h);
+        b->vel_y[i] = move_towardf(s->start_vel_y, 0.0f, b->friction[i] * h);
+    }
+}
+
+// Entries of the awake bodies the solver moved since the broad phase binned them
+// (center_x/y still hold the collider centers they were binned at)
+static void substep_refresh(PhysicsBodies *b) {
+    for (int i = 0; i < b->awake_count; i++) {
+        if (!b->has_collider[i]) continue;
+        float cx = b->x[i] + b->offset_x[i];
+        float cy = b->y[i] + b->offset_y[i];
+        if (cx == b->center_x[i] && cy == b->center_y[i]) continue;
+
+        b->center_x[i] = cx;
+        b->center_y[i] = cy;
+        spatial_insert_bounds(g_spatial, b->entity[i], cx - b->half_w[i], cy - b->half_h[i],
+                              cx + b->half_w[i], cy + b->half_h[i]);
+    }
+}
+
+// The fast bodies' other sub-steps (after the step). Sub-step n of every body
+// that has one runs before sub-step n + 1 of any
+
+static void substep_rest(PhysicsBodies *b, float dt) {
+    substep_refresh(b);
+    for (int n = 1; n < g_max_substeps; n++) {
+        int active = 0;
+        for (int k = 0; k < g_substep_count; k++) {
+            const SubstepBody *s = &g_substep[k];
+            if (n >= s->steps) continue;
+            active = 1;
+
+            int i = s->body;
+            Entity *e = b->entity[i];
+            float h = dt / (float)s->steps;
+            b->x[i] += b->vel_x[i] * h;
+            b->y[i] += b->vel_y[i] * h;
+            b->vel_x[i] = move_towardf(b->vel_x[i], 0.0f, b->friction[i] * h);
+            b->vel_y[i] = move_towardf(b->vel_y[i], 0.0f, b->friction[i] * h);
+            body_recenter(b, i);
+
+            float cx = b->center_x[i];
+            float cy = b->center_y[i];
+            float hw = b->half_w[i];
+            float hh = b->half_h[i];
+            int found = query_region(cx - hw, cy - hh, cx + hw, cy + hh);
+
+            for (int j = 0; j < found; j++) {
+                Entity *o = g_query_hits[j];
+                if (o == e) continue;
+                if (!((e->collider.mask & o->collider.layer) || (o->collider.mask & e->collider.layer))) continue;
+
+                int j = b->body_of_slot[ENTITY_HANDLE_INDEX(o->id)];
+                if (bodies_collide(b, i, j)) sleep_wake_body(b, j);
+            }
+        }
+        if (!active) break;
+    }
+}
+
+// --- NARROW PHASE ---
+
+static int contacts_reserve(int count) {
+    if (count <= g_contact_capacity) return 1;
+
+    int new_capacity = g_contact_capacity ? g_contact_capacity : 1024;
+    while (new_capacity < count) new_capacity *= 2;
+
+    Contact *p = realloc(g_contacts, (size_t)new_capacity * sizeof(Contact));
+    if (!p) return 0;
+    g_contacts = p;
+    g_contact_capacity = new_capacity;
+    return 1;
+}
+
+// Test pairs [start, end); hits go to g_contacts[start ...] (runs on a worker).
+// Pairs are taken NARROW_BLOCK at a time: circle/circle and circle/rect pairs go
+// through the SIMD kernels on the body arrays (see physics_simd.c), rect/rect
+// through check_rect_rect, and the hits come out in pair order
+static void narrow_phase_job(void *data, int start, int end, int chunk) {
+    const SpatialPair *pairs = data;
+    const PhysicsBodies *b = &g_bodies;
+    Contact *out = g_contacts + start;
+    int hits = 0;
+
+    for (int base = start; base < end; base += NARROW_BLOCK) {
+        int n = (end - base < NARROW_BLOCK) ? end - base : NARROW_BLOCK;
+
+        int body_a[NARROW_BLOCK], body_b[NARROW_BLOCK];
+        Manifold result[NARROW_BLOCK];
+        int circle_a[NARROW_BLOCK], circle_b[NARROW_BLOCK], circle_pair[NARROW_BLOCK];
+        int mixed_circle[NARROW_BLOCK], mixed_rect[NARROW_BLOCK], mixed_pair[NARROW_BLOCK];
+        int flipped[NARROW_BLOCK];  // Mixed pairs where the rect is A
+        int circles = 0, mixed = 0, flips = 0;
+
+        // Sort the block by shape combination
+        for (int k = 0; k < n; k++) {
+            const Entity *a = pairs[base + k].a;
+            const Entity *e = pairs[base + k].b;
+            int ia = b->body_of_slot[ENTITY_HANDLE_INDEX(a->id)];
+            int ib = b->body_of_slot[ENTITY_HANDLE_INDEX(e->id)];
+            body_a[k] = ia;
+            body_b[k] = ib;
+            result[k].hit = 0;
+
+            int circle_ia = b->shape[ia] == SHAPE_CIRCLE;
+            int circle_ib = b->shape[ib] == SHAPE_CIRCLE;
+            if (circle_ia && circle_ib) {
+                circle_a[circles] = ia;
+                circle_b[circles] = ib;
+                circle_pair[circles++] = k;
+            } else if (circle_ia && b->shape[ib] == SHAPE_RECT) {
+                mixed_circle[mixed] = ia;
+                mixed_rect[mixed] = ib;
+                mixed_pair[mixed++] = k;
+            } else if (circle_ib && b->shape[ia] == SHAPE_RECT) {
+                mixed_circle[mixed] = ib;
+                mixed_rect[mixed] = ia;
+                mixed_pair[mixed++] = k;
+                flipped[flips++] = k;
+            } else if (b->shape[ia] == SHAPE_RECT && b->shape[ib] == SHAPE_RECT) {
+                result[k] = bodies_rect_rect(b, ia, ib);
+            }
+        }
+
+        simd_circle_circle(b->center_x, b->center_y, b->half_w,
+                           circle_a, circle_b, circles, circle_pair, result);
+        simd_circle_rect(b->center_x, b->center_y, b->half_w, b->half_h,
+                         mixed_circle, mixed_rect, mixed, mixed_pair, result);
+
+        // Kernel normal is circle -> rect; make it A -> B
+        for (int f = 0; f < flips; f++) {
+            Manifold *m = &result[flipped[f]];
+            if (!m->hit) continue;
+            m->normal_x *= -1;
+            m->normal_y *= -1;
+        }
+
+        // Hits in pair order. Listing them without a branch first saves a
+        // mispredict per pair when hits and misses are mixed
+        int hit_pair[NARROW_BLOCK];
+        int hit_count = 0;
+        for (int k = 0; k < n; k++) {
+            hit_pair[hit_count] = k;
+            hit_count += result[k].hit;
+        }
+
+        for (int h = 0; h < hit_count; h++) {
+            int k = hit_pair[h];
+            out[hits].pair = base + k;
+            out[hits].body_a = body_a[k];
+            out[hits].body_b = body_b[k];
+            out[hits].m = result[k];
+            hits++;
+        }
+    }
+
+    g_chunk_start[chunk] = start;
+    g_chunk_hits[chunk] = hits;
+}
+
+// --- BATCHED SOLVER ---
+
+static int batched_reserve(int contacts, int bodies) {
+    if (contacts > g_batched_capacity) {
+        int new_capacity = g_batched_capacity ? g_batched_capacity : 1024;
+        while (new_capacity < contacts) new_capacity *= 2;
+
+        Contact *c = realloc(g_batched, (size_t)new_capacity * sizeof(Contact));
+        if (!c) return 0;
+        g_batched = c;
+        unsigned char *b = realloc(g_batch_of, (size_t)new_capacity);
+        if (!b) return 0;
+        g_batch_of = b;
+        g_batched_capacity = new_capacity;
+    }
+
+    if (bodies > g_body_batches_capacity) {
+        int new_capacity = g_body_batches_capacity ? g_body_batches_capacity : 1024;
+        while (new_capacity < bodies) new_capacity *= 2;
+
+        uint64_t *m = realloc(g_body_batches, (size_t)new_capacity * sizeof(uint64_t));
+        if (!m) return 0;
+        memset(m + g_body_batches_capacity, 0,
+               (size_t)(new_capacity - g_body_batches_capacity) * sizeof(uint64_t));
+        g_body_batches = m;
+        g_body_batches_capacity = new_capacity;
+    }
+    return 1;
+}
+
+// Resolve contacts [start, end) of one batch (runs on a worker; no shared moving bodies)
+static void solver_batch_job(void *data, int start, int end, int chunk) {
+    const Contact *contacts = data;
+    (void)chunk;
+
+    for (int i = start; i < end; i++) {
+        bodies_resolve(&g_bodies, contacts[i].body_a, contacts[i].body_b, &contacts[i].m);
+    }
+}
+
+// Color the contacts (the runs, in order) into batches and resolve them batch by
+// batch. Returns 0 if out of memory (nothing resolved)
+static int solve_batched(const Contact **runs, const int *run_counts, int run_total) {
+    PhysicsBodies *bodies = &g_bodies;
+    int total = 0;
+    for (int r = 0; r < run_total; r++) total += run_counts[r];
+    if (!batched_reserve(total, bodies->count)) return 0;
+
+    // Greedy coloring; contacts with no free batch left go to the overflow batch,
+    // which is resolved serially at the end
+    int batch_count[SOLVER_MAX_BATCHES + 1] = {0};
+    int k = 0;
+    for (int r = 0; r < run_total; r++) {
+        for (int n = 0; n < run_counts[r]; n++, k++) {
+            const Contact *c = &runs[r][n];
+            int dynamic_a = bodies->inv_mass[c->body_a] > 0.0f;
+            int dynamic_b = bodies->inv_mass[c->body_b] > 0.0f;
+
+            uint64_t used = 0;
+            if (dynamic_a) used |= g_body_batches[c->body_a];
+            if (dynamic_b) used |= g_body_batches[c->body_b];
+
+            int batch = 0;
+            while (batch < SOLVER_MAX_BATCHES && (used & 1)) {
+                used >>= 1;
+                batch++;
+            }
+
+            // Static masks are never read, so any bit marks them as colliding
+            uint64_t bit = (batch < SOLVER_MAX_BATCHES) ? (uint64_t)1 << batch : 1;
+            g_body_batches[c->body_a] |= bit;
+            g_body_batches[c->body_b] |= bit;
+
+            g_batch_of[k] = (unsigned char)batch;
+            batch_count[batch]++;
+        }
+    }
+
+    // Flag the bodies in a contact, and clear their masks for the next step
+    for (int r = 0; r < run_total; r++) {
+        for (int n = 0; n < run_counts[r]; n++) {
+            const Contact *c = &runs[r][n];
+            colliding_mark(bodies->entity[c->body_a]);
+            colliding_mark(bodies->entity[c->body_b]);
+            g_body_batches[c->body_a] = 0;
+            g_body_batches[c->body_b] = 0;
+        }
+    }
+
+    // Counting sort into batches (stable, so each batch keeps pair order)
+    int batch_start[SOLVER_MAX_BATCHES + 2];
+    batch_start[0] = 0;
+    for (int b = 0; b <= SOLVER_MAX_BATCHES; b++) batch_start[b + 1] = batch_start[b] + batch_count[b];
+
+    int fill[SOLVER_MAX_BATCHES + 1];
+    memcpy(fill, batch_start, sizeof(fill));
+    k = 0;
+    for (int r = 0; r < run_total; r++) {
+        for (int n = 0; n < run_counts[r]; n++, k++) {
+            g_batched[fill[g_batch_of[k]]++] = runs[r][n];
+        }
+    }
+
+    for (int b = 0; b < SOLVER_MAX_BATCHES; b++) {
+        int count = batch_count[b];
+        if (count == 0) break;  // Batches fill lowest first, so the rest are empty too
+        jobs_parallel_for(count, SOLVER_MIN_CONTACTS, solver_batch_job, g_batched + batch_start[b]);
+    }
+
+    // Overflow batch: serial
+    solver_batch_job(g_batched + batch_start[SOLVER_MAX_BATCHES], 0, batch_count[SOLVER_MAX_BATCHES], 0);
+    return 1;
+}
+
+// --- ITERATIVE SOLVER ---
+
+// Order-independent key of an entity pair (never 0: the two handles differ)
+static uint64_t contact_key(EntityHandle a, EntityHandle b) {
+    return (a < b) ? ((uint64_t)a << 32 | b) : ((uint64_t)b << 32 | a);
+}
+
+static unsigned int impulse_slot(uint64_t key, int capacity) {
+    return (unsigned int)((key * 0x9E3779B97F4A7C15ull) >> 32) & (unsigned int)(capacity - 1);
+}
+
+static float impulse_cache_find(const CachedImpulse *table, int capacity, uint64_t key) {
+    if (capacity == 0) return 0.0f;
+    for (unsigned int i = impulse_slot(key, capacity); ; i = (i + 1) & (unsigned int)(capacity - 1)) {
+        if (table[i].key == key) return table[i].impulse;
+        if (table[i].key == 0) return 0.0f;
+    }
+}
+
+// Keys are unique per step (one contact per pair), so inserts never look for duplicates
+static void impulse_cache_store(CachedImpulse *table, int capacity, uint64_t key, float impulse) {
+    unsigned int i = impulse_slot(key, capacity);
+    while (table[i].key != 0) i = (i + 1) & (unsigned int)(capacity - 1);
+    table[i].key = key;
+    table[i].impulse = impulse;
+}
+
+static int iterative_reserve(int contacts) {
+    if (contacts > g_solver_contact_capacity) {
+        int new_capacity = g_solver_contact_capacity ? g_solver_contact_capacity : 1024;
+        while (new_capacity < contacts) new_capacity *= 2;
+
+        SolverContact *c = realloc(g_solver_contacts, (size_t)new_capacity * sizeof(SolverContact));
+        if (!c) return 0;
+        g_solver_contacts = c;
+        g_solver_contact_capacity = new_capacity;
+    }
+
+    // This step's cache table stays under 50% load
+    int next = g_impulse_cache_current ^ 1;
+    int capacity = g_impulse_cache_capacity[next] ? g_impulse_cache_capacity[next] : 1024;
+    while (capacity < contacts * 2) capacity *= 2;
+    if (capacity != g_impulse_cache_capacity[next]) {
+        CachedImpulse *t = realloc(g_impulse_cache[next], (size_t)capacity * sizeof(CachedImpulse));
+        if (!t) return 0;
+        g_impulse_cache[next] = t;
+        g_impulse_cache_capacity[next] = capacity;
+    }
+    memset(g_impulse_cache[next], 0, (size_t)capacity * sizeof(CachedImpulse));
+    return 1;
+}
+
+// Apply impulse 'impulse' along the contact normal (A gets the negative share)
+static void apply_normal_impulse(PhysicsBodies *b, const SolverContact *c, float impulse) {
+    float px = c->normal_x * impulse;
+    float py = c->normal_y * impulse;
+    b->vel_x[c->body_a] -= px * b->inv_mass[c->body_a];
+    b->vel_y[c->body_a] -= py * b->inv_mass[c->body_a];
+    b->vel_x[c->body_b] += px * b->inv_mass[c->body_b];
+    b->vel_y[c->body_b] += py * b->inv_mass[c->body_b];
+}
+
+// Sequential impulses over the contacts (the runs, in order), warm started from
+// the cache. Returns 0 if out of memory
+static int solve_iterative(SpatialPairList *pairs, const Contact **runs, const int *run_counts,
+                           int run_total) {
+    PhysicsBodies *bodies = &g_bodies;
+    int total = 0;
+    for (int r = 0; r < run_total; r++) total += run_counts[r];
+    if (!iterative_reserve(total)) return 0;
+
+    const CachedImpulse *previous = g_impulse_cache[g_impulse_cache_current];
+    int previous_capacity = g_impulse_cache_capacity[g_impulse_cache_current];
+    g_impulse_cache_current ^= 1;
+
+    // Prepare: bounce targets from the approach speed, and last step's impulses
+    int count = 0;
+    for (int r = 0; r < run_total; r++) {
+        for (int n = 0; n < run_counts[r]; n++) {
+            const Contact *src = &runs[r][n];
+            Entity *a = pairs->pairs[src->pair].a;
+            Entity *b = pairs->pairs[src->pair].b;
+            colliding_mark(a);
+            colliding_mark(b);
+
+            float inv_mass_sum = bodies->inv_mass[src->body_a] + bodies->inv_mass[src->body_b];
+            if (inv_mass_sum == 0.0f) continue;  // Both static
+
+            SolverContact *c = &g_solver_contacts[count++];
+            c->body_a = src->body_a;
+            c->body_b = src->body_b;
+            c->normal_x = src->m.normal_x;
+            c->normal_y = src->m.normal_y;
+            c->depth = src->m.depth;
+            c->inv_k = 1.0f / inv_mass_sum;
+            c->key = contact_key(a->id, b->id);
+
+            float vn = (bodies->vel_x[c->body_b] - bodies->vel_x[c->body_a]) * c->normal_x +
+                       (bodies->vel_y[c->body_b] - bodies->vel_y[c->body_a]) * c->normal_y;
+            float e = fminf(bodies->restitution[c->body_a], bodies->restitution[c->body_b]);
+            c->target = (vn < -SOLVER_BOUNCE_THRESHOLD) ? -e * vn : 0.0f;
+
+            c->impulse = impulse_cache_find(previous, previous_capacity, c->key);
+        }
+    }
+
+    // Warm start (after every target is known, so they see the pre-solve velocities)
+    for (int i = 0; i < count; i++) {
+        if (g_solver_contacts[i].impulse != 0.0f) {
+            apply_normal_impulse(bodies, &g_solver_contacts[i], g_solver_contacts[i].impulse);
+        }
+    }
+
+    // Velocity iterations
+    for (int it = 0; it < g_iterations; it++) {
+        for (int i = 0; i < count; i++) {
+            SolverContact *c = &g_solver_contacts[i];
+            float vn = (bodies->vel_x[c->body_b] - bodies->vel_x[c->body_a]) * c->normal_x +
+                       (bodies->vel_y[c->body_b] - bodies->vel_y[c->body_a]) * c->normal_y;
+
+            float impulse = c->impulse + (c->target - vn) * c->inv_k;
+            if (impulse < 0.0f) impulse = 0.0f;  // Contacts push, never pull
+            float delta = impulse - c->impulse;
+            c->impulse = impulse;
+            if (delta != 0.0f) apply_normal_impulse(bodies, c, delta);
+        }
+    }
+
+    // Position pass, and remember the impulses for the next step
+    CachedImpulse *cache = g_impulse_cache[g_impulse_cache_current];
+    int cache_capacity = g_impulse_cache_capacity[g_impulse_cache_current];
+    for (int i = 0; i < count; i++) {
+        SolverContact *c = &g_solver_contacts[i];
+        float correction = (c->depth - SOLVER_SLOP) * SOLVER_CORRECTION * c->inv_k;
+        if (correction > 0.0f) {
+            bodies->x[c->body_a] -= c->normal_x * correction * bodies->inv_mass[c->body_a];
+            bodies->y[c->body_a] -= c->normal_y * correction * bodies->inv_mass[c->body_a];
+            bodies->x[c->body_b] += c->normal_x * correction * bodies->inv_mass[c->body_b];
+            bodies->y[c->body_b] += c->normal_y * correction * bodies->inv_mass[c->body_b];
+        }
+        impulse_cache_store(cache, cache_capacity, c->key, c->impulse);
+    }
+    return 1;
+}
+
+// --- SLEEPING ---
+
+// Wake the islands of sleepers that an awake body touches, before the contacts are
+// solved so they respond this step. Waking moves the sleepers to the awake run, so
+// the contacts that had a sleeper's index look their bodies up again
+static void sleep_wake_touched(PhysicsBodies *b, const SpatialPairList *pairs, int chunks) {
+    int first = b->awake_count;  // Indices from here to dynamic_count may change
+
+    for (int k = 0; k < chunks; k++) {
+        Contact *c = g_contacts + g_chunk_start[k];
+        for (int n = 0; n < g_chunk_hits[k]; n++, c++) {
+            int a_moves = c->body_a >= first && c->body_a < b->dynamic_count;
+            int b_moves = c->body_b >= first && c->body_b < b->dynamic_count;
+            if (!a_moves && !b_moves) continue;
+
+            // Sleepers only pair with awake bodies, so at most one side sleeps
+            const SpatialPair *p = &pairs->pairs[c->pair];
+            int sleeper = b->body_of_slot[ENTITY_HANDLE_INDEX((a_moves ? p->a : p->b)->id)];
+            sleep_wake_body(b, sleeper);
+
+            c->body_a = b->body_of_slot[ENTITY_HANDLE_INDEX(p->a->id)];
+            c->body_b = b->body_of_slot[ENTITY_HANDLE_INDEX(p->b->id)];
+        }
+    }
+}
+
+static int island_find(int i) {
+    while (g_island_parent[i] != i) {
+        g_island_parent[i] = g_island_parent[g_island_parent[i]];  // Path halving
+        i = g_island_parent[i];
+    }
+    return i;
+}
+
+// After the solver: advance the awake bodies' still timers, join touching ones into
+// islands (statics don't link them) and put to sleep the islands whose bodies have
+// all been still long enough (they leave the awake run in sleep_settle)
+static void sleep_update(PhysicsBodies *b, int chunks, float dt) {
+    int n = b->awake_count;
+    if (n > g_island_capacity) {
+        int *parent = realloc(g_island_parent, (size_t)n * sizeof(int));
+        if (!parent) return;
+        g_island_parent = parent;
+        float *still = realloc(g_island_still, (size_t)n * sizeof(float));
+        if (!still) return;
+        g_island_still = still;
+        g_island_capacity = n;
+    }
+
+    for (int i = 0; i < n; i++) {
+        g_island_parent[i] = i;
+        g_island_still[i] = FLT_MAX;
+    }
+
+    for (int k = 0; k < chunks; k++) {
+        const Contact *c = g_contacts + g_chunk_start[k];
+        for (int h = 0; h < g_chunk_hits[k]; h++, c++) {
+            if (c->body_a >= n || c->body_b >= n) continue;
+            int ra = island_find(c->body_a);
+            int rb = island_find(c->body_b);
+            if (ra != rb) g_island_parent[ra] = rb;
+        }
+    }
+
+    float speed_sq = g_sleep_speed * g_sleep_speed;
+    for (int i = 0; i < n; i++) {
+        SleepState *s = body_sleep(b, i);
+        s->id = b->entity[i]->id;
+
+        if (b->vel_x[i] * b->vel_x[i] + b->vel_y[i] * b->vel_y[i] < speed_sq) {
+            s->still_time += dt;
+        } else {
+            s->still_time = 0.0f;
+        }
+
+        int root = island_find(i);
+        if (s->still_time < g_island_still[root]) g_island_still[root] = s->still_time;
+    }
+
+    // Islands that go to sleep take their root's slot as label, and list their bodies
+    for (int i = 0; i < n; i++) {
+        if (g_island_parent[i] != i || g_island_still[i] < g_sleep_time) continue;
+        body_sleep(b, i)->island_first = -1;
+    }
+
+    for (int i = 0; i < n; i++) {
+        int root = island_find(i);
+        if (g_island_still[root] < g_sleep_time) continue;
+
+        SleepState *s = body_sleep(b, i);
+        int label = b->slot[root];
+        b->vel_x[i] = 0.0f;
+        b->vel_y[i] = 0.0f;
+        s->island = label;
+        s->next = g_sleep[label].island_first;
+        g_sleep[label].island_first = b->slot[i];
+        g_sleep_settling++;
+    }
+}
+
+// Detect every candidate pair in parallel, then resolve the hits with the selected solver.
+// Returns the number of contact chunks left in g_contacts for this step
+// (-1 if there wasn't room for them and the pairs were resolved one by one)
+static int narrow_phase(SpatialPairList *pairs) {
+    PhysicsBodies *bodies = &g_bodies;
+    if (pairs->count == 0) return 0;
+
+    if (!contacts_reserve(pairs->count)) {
+        // No room for the contact list: detect and resolve pair by pair
+        for (int i = 0; i < pairs->count; i++) {
+            int ia = bodies->body_of_slot[ENTITY_HANDLE_INDEX(pairs->pairs[i].a->id)];
+            int ib = bodies->body_of_slot[ENTITY_HANDLE_INDEX(pairs->pairs[i].b->id)];
+            if (!bodies_collide(bodies, ia, ib)) continue;
+            sleep_wake_body(bodies, ia);
+            sleep_wake_body(bodies, bodies->body_of_slot[ENTITY_HANDLE_INDEX(pairs->pairs[i].b->id)]);
+        }
+        return -1;
+    }
+
+    int chunks = jobs_chunk_count(pairs->count, NARROW_MIN_PAIRS);
+    jobs_parallel_for(pairs->count, NARROW_MIN_PAIRS, narrow_phase_job, pairs->pairs);
+
+    if (g_bodies.awake_count < g_bodies.dynamic_count) sleep_wake_touched(&g_bodies, pairs, chunks);
+
+    if (g_solver != PHYSICS_SOLVER_SERIAL) {
+        const Contact *runs[JOBS_MAX_THREADS];
+        for (int k = 0; k < chunks; k++) runs[k] = g_contacts + g_chunk_start[k];
+        if (g_solver == PHYSICS_SOLVER_BATCHED && solve_batched(runs, g_chunk_hits, chunks)) return chunks;
+        if (g_solver == PHYSICS_SOLVER_ITERATIVE && solve_iterative(pairs, runs, g_chunk_hits, chunks)) return chunks;
+        // Out of memory: resolve serially instead
+    }
+
+    for (int k = 0; k < chunks; k++) {
+        Contact *c = g_contacts + g_chunk_start[k];
+        for (int n = 0; n < g_chunk_hits[k]; n++, c++) {
+            colliding_mark(bodies->entity[c->body_a]);
+            colliding_mark(bodies->entity[c->body_b]);
+            bodies_resolve(bodies, c->body_a, c->body_b, &c->m);
+        }
+    }
+    return chunks;
+}
+
+// --- PHYSICS UPDATE ---
+
+void physics_update(GameState *state, float dt) {
+    PhysicsBodies *bodies = &g_bodies;
+    if (!bodies_sync(bodies, state)) return;
+    colliding_clear();
+
+    // Without room for the sleep state, everything stays awake this step
+    g_sleep_ready = (g_sleep_speed > 0.0f) && sleep_reserve(state);
+
+    // Apply velocity and drag to the awake dynamic bodies (fast ones: their first sub-step)
+    ccd_collect(bodies);
+    ccd_begin(bodies);
+    substep_select(bodies, dt);
+    bodies_integrate(bodies, 0, bodies->awake_count, dt);
+    substep_first(bodies, dt);
 
     // --- BROAD PHASE: Spatial Partitioning ---
     if (g_spatial) {
-        // Clear and rebuild spatial index
+        // Refresh the spatial index (AABBs come straight from the body arrays).
+        // Entries persist, so only bodies that changed cells cost a rebuild.
+        // Static and sleeping bodies live in the static layer, which is never
+        // cleared: they are not visited here at all (see statics_refresh)
         spatial_clear(g_spatial);
-        for (int i = 0; i < state->count; i++) {
-            Entity *e = &state->entities[i];
-            if (e->active && e->collider.active) {
-                spatial_insert(g_spatial, e);
-            }
+        for (int i = 0; i < bodies->awake_count; i++) {
+            if (!bodies->has_collider[i]) continue;
+
+            body_recenter(bodies, i);
+            float cx = bodies->center_x[i];
+            float cy = bodies->center_y[i];
+            float hw = bodies->half_w[i];
+            float hh = bodies->half_h[i];
+            spatial_insert_bounds(g_spatial, bodies->entity[i], cx - hw, cy - hh, cx + hw, cy + hh);
         }
         
-        // Check collisions using spatial queries
-        for (int i = 0; i < state->count; i++) {
-            Entity *a = &state->entities[i];
-            if (!a->active || !a->collider.active) continue;
-            
-            // Query for nearby entities
-            int num_candidates = spatial_query(g_spatial, a, query_buffer, MAX_QUERY_RESULTS);
-            
-            for (int j = 0; j < num_candidates; j++) {
-                Entity *b = query_buffer[j];
-                
-                // Skip if we've already checked this pair (a->id < b->id ensures each pair checked once)
-                if (a->id >= b->id) continue;
-                
-                // Layer Check
-                if (!((a->collider.mask & b->collider.layer) || (b->collider.mask & a->collider.layer))) continue;
-                
-                // Narrow Phase: Actual collision check
-                Manifold m = check_collision_dispatch(a, b);
-                
-                if (m.hit) {
-                    a->collider.is_colliding = 1;
-                    b->collider.is_colliding = 1;
-                    resolve_collision(a, b, &m);
-                }
-            }
+        // Continuous collision: fast flagged bodies stop at their first hit
+        if (g_ccd_count > 0) {
+            ccd_insert_swept(bodies);
+            ccd_sweep(bodies);
         }
+
+        // Unique, layer-filtered candidate pairs (each grid cell walked once; no static/static pairs)
+        spatial_find_pairs(g_spatial, &g_pairs);
+        
+        // Narrow Phase: contacts from the start-of-step positions, then the contact solver
+        int chunks = narrow_phase(&g_pairs);
+
+        // Islands from this step's contacts
+        if (g_sleep_ready && chunks >= 0) sleep_update(bodies, chunks, dt);
+
+        // Rest of the fast bodies' sub-steps
+        if (g_substep_count > 0) substep_rest(bodies, dt);
     } 
     else {
         // Fallback: O(n^2) brute force (if spatial index failed to initialize)
-        for (int i = 0; i < state->count; i++) {
-            Entity *a = &state->entities[i];
-            if (!a->active) continue; 
+        for (int i = 0; i < bodies->awake_count; i++) body_recenter(bodies, i);
+
+        for (int i = 0; i < bodies->count; i++) {
+            if (!bodies->has_collider[i]) continue;
+            Entity *a = bodies->entity[i];
 
-            for (int j = i + 1; j < state->count; j++) {
-                Entity *b = &state->entities[j];
-                if (!b->active) continue;
+            for (int j = i + 1; j < bodies->count; j++) {
+                if (!bodies->has_collider[j]) continue;
+                Entity *b = bodies->entity[j];
 
                 // Layer Check
-                if (!a->collider.active || !b->collider.active) continue;
                 if (!((a->collider.mask & b->collider.layer) || (b->collider.mask & a->collider.layer))) continue;
 
-                // Dispatch
-                Manifold m = check_collision_dispatch(a, b);
-
-                // Resolve
-                if (m.hit) {
-                    a->collider.is_colliding = 1;
-                    b->collider.is_colliding = 1;
-                    resolve_collision(a, b, &m);
-                }
+                // Dispatch and resolve
+                bodies_collide(bodies, i, j);
             }
         }
     }
-}
\ No newline at end of file
+
+    // The entities' copy of the moving bodies
+    bodies_publish(bodies);
+    sleep_settle(bodies);
+}
@@ -2,6 +2,7 @@
 #define PHYSICS_H
 
 #include "engine.h" // We need the Entity struct definition
+#include "spatial.h"
 
 // Putting all the collision data ("Manifold")in a struct
 typedef struct {
@@ -23,12 +24,98 @@ Manifold check_collision_dispatch(const Entity *a, const Entity *b);
 // Physics Responses
 void resolve_collision(Entity *a, Entity *b, Manifold *m);
 
+// How contacts are resolved
+typedef enum {
+    PHYSICS_SOLVER_SERIAL,  // One by one in pair order (default)
+    PHYSICS_SOLVER_BATCHED, // Grouped into batches that share no moving body; each batch in parallel
+    PHYSICS_SOLVER_ITERATIVE, // Sequential impulses, warm started from the last step (steadier piles)
+} PhysicsSolver;
+
 // Physics System Lifecycle
 // Call physics_init AFTER setting up your world bounds
+// cell_size should be >= the largest entity; pass 0 to size cells per collider
+// instead (hierarchical grid, for worlds that mix small and large colliders)
 void physics_init(float world_width, float world_height, float cell_size);
+// Same, with full control over the broad phase (e.g. SPATIAL_TYPE_HASH for open worlds,
+// or config.tuning to let a grid adjust its cell size as the density changes)
+void physics_init_spatial(SpatialConfig config);
 void physics_shutdown(void);
 
+// Threads for the narrow phase and the batched solver, including the caller
+// (0 = one per hardware thread; 1 = single-threaded, the default). Results don't
+// depend on the count
+void physics_set_threads(int count);
+
+// Contact solver (see PhysicsSolver). BATCHED resolves contacts in a different
+// order than SERIAL, but the same one on every run and for any thread count
+void physics_set_solver(PhysicsSolver solver);
+
+// Velocity iterations of PHYSICS_SOLVER_ITERATIVE (default 4). Contact impulses
+// carry over between steps, so resting piles need fewer iterations than a cold start
+void physics_set_iterations(int iterations);
+
+// Sub-stepping: a body that would travel more than its radius (half its shorter side)
+// in one step moves in up to max_substeps shorter steps, each checked for contacts, so
+// fast bodies stay stable without shrinking the step for the whole world. 1 = off (the default)
+void physics_set_substeps(int max_substeps);
+
+// Sleeping: dynamic bodies slower than 'speed' (px/s) for 'time' seconds stop being
+// integrated and paired until something touches them or game code moves, pushes
+// (the setters), refreshes or destroys one of them. Bodies in contact sleep and
+// wake together, so a pile settles as one. speed 0 = off (the default; turning it
+// off wakes everything)
+void physics_set_sleep(float speed, float time);
+
+// Wake e and its island, or restart its still timer
+void physics_wake(Entity *e);
+int physics_is_sleeping(const Entity *e);
+
+// --- BODIES ---
+// Physics keeps its own copy of each entity's position, velocity, mass, friction,
+// restitution and collider, and after every physics_update writes the moving
+// bodies' x, y, vel_x and vel_y back to their entities. Writing those fields from
+// game code does nothing on its own (the next step overwrites them): use the
+// setters, or change the fields and call physics_refresh. Spawned entities are
+// picked up by the next physics_update (entity_alloc calls physics_refresh), so
+// spawners can set any field before then
+
+// Re-read e's fields at the start of the next physics_update
+void physics_refresh(Entity *e);
+
+// Set e's position / velocity (the entity's fields and its body). Static bodies
+// are only re-binned when moved through here or physics_refresh
+void physics_set_position(Entity *e, float x, float y);
+void physics_set_velocity(Entity *e, float vel_x, float vel_y);
+
+// Drop e's body and take it out of the broad phase right away (entity_destroy
+// calls this). Statics stay in the spatial index between steps, so a destroyed
+// one must not linger
+void physics_remove(Entity *e);
+
 // Physics Update
 void physics_update(GameState *state, float dt);
 
+// --- QUERIES ---
+// Region queries and casts on the physics broad phase, for game code (AI line of
+// sight, weapons, picking). Same results as the spatial_query_* / spatial_*cast
+// functions of the same name (see spatial.h), over both layers.
+// They see the index as the last physics_update left it: moving bodies at the
+// AABB they were binned with (after integration, before contacts were resolved),
+// statics and sleepers as they are. Anything spawned or moved by the game since
+// then is found by its old AABB, or not at all, until the next physics_update;
+// casts do test each candidate's shape at its current position. Destroyed
+// entities are never returned. Before physics_init nothing is found (casts still
+// fill 'out' with a miss)
+
+int physics_query_box(float min_x, float min_y, float max_x, float max_y,
+                      uint32_t mask, Entity **out, int max_out);
+int physics_query_point(float x, float y, uint32_t mask, Entity **out, int max_out);
+int physics_query_segment(float x0, float y0, float x1, float y1,
+                          uint32_t mask, Entity **out, int max_out);
+
+int physics_raycast(float x0, float y0, float x1, float y1, uint32_t mask, SpatialHit *out);
+int physics_shapecast(float x0, float y0, float x1, float y1, float radius,
+                      uint32_t mask, SpatialHit *out);
+int physics_raycast_batch(const SpatialRay *rays, int count, uint32_t mask, SpatialHit *out);
+
 #endif
\ No newline at end of file
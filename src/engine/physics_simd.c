@@ -0,0 +1,502 @@
+// physics_simd.c — Vectorised physics kernels with runtime dispatch
+//
+// Each kernel has a scalar reference version plus SSE2/AVX2 variants.
+// The vector paths process 4/8 bodies per iteration and finish the tail
+// with the scalar loop, so any count is valid.
+//
+
+#include "physics_simd.h"
+#include "math_common.h"
+#include <math.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+    #define SIMD_X86 1
+    #include <immintrin.h>
+    #if defined(_MSC_VER)
+        #include <intrin.h>
+        // MSVC lets any intrinsic be used in any function
+        #define SIMD_TARGET_SSE2
+        #define SIMD_TARGET_AVX2
+    #else
+        #include <cpuid.h>
+        // GCC/Clang need the ISA enabled per function (the file is built without -mavx2)
+        #define SIMD_TARGET_SSE2 __attribute__((target("sse2")))
+        #define SIMD_TARGET_AVX2 __attribute__((target("avx2")))
+    #endif
+#else
+    #define SIMD_X86 0
+#endif
+
+// --- CPU DETECTION ---
+
+#if SIMD_X86
+static void cpuid_query(int leaf, int subleaf, unsigned int regs[4]) {
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuidex(info, leaf, subleaf);
+    for (int i = 0; i < 4; i++) regs[i] = (unsigned int)info[i];
+#else
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+// Which register state the OS saves on context switch (XCR0)
+static unsigned long long xgetbv0(void) {
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    unsigned int eax, edx;
+    __asm__ volatile ("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return ((unsigned long long)edx << 32) | eax;
+#endif
+}
+#endif
+
+SimdLevel simd_detect(void) {
+#if SIMD_X86
+    unsigned int regs[4];  // eax, ebx, ecx, edx
+
+    cpuid_query(0, 0, regs);
+    unsigned int max_leaf = regs[0];
+
+    cpuid_query(1, 0, regs);
+    int has_sse2    = (regs[3] >> 26) & 1;
+    int has_osxsave = (regs[2] >> 27) & 1;
+    int has_avx     = (regs[2] >> 28) & 1;
+    if (!has_sse2) return SIMD_LEVEL_SCALAR;
+
+    // AVX registers are only usable if the OS saves XMM+YMM state
+    if (has_osxsave && has_avx && (xgetbv0() & 0x6) == 0x6 && max_leaf >= 7) {
+        cpuid_query(7, 0, regs);
+        if ((regs[1] >> 5) & 1) return SIMD_LEVEL_AVX2;
+    }
+    return SIMD_LEVEL_SSE2;
+#else
+    return SIMD_LEVEL_SCALAR;
+#endif
+}
+
+static int g_level_initialized = 0;
+static SimdLevel g_level = SIMD_LEVEL_SCALAR;
+
+SimdLevel simd_get_level(void) {
+    if (!g_level_initialized) {
+        g_level = simd_detect();
+        g_level_initialized = 1;
+    }
+    return g_level;
+}
+
+void simd_set_level(SimdLevel level) {
+    SimdLevel best = simd_detect();
+    g_level = (level > best) ? best : level;
+    g_level_initialized = 1;
+}
+
+const char* simd_level_name(SimdLevel level) {
+    switch (level) {
+        case SIMD_LEVEL_SSE2: return "SSE2";
+        case SIMD_LEVEL_AVX2: return "AVX2";
+        default:              return "scalar";
+    }
+}
+
+// --- INTEGRATION + FRICTION ---
+// Friction as a branchless expression: move_towardf(v, 0, f) for f >= 0 is
+// copysign(max(|v| - f, 0), v), which maps directly onto and/andnot/max/or.
+// A body slower than f with v < 0 would come out as -0 that way, where
+// move_towardf gives +0, so the result gets + 0.0f (which only changes -0).
+
+static void integrate_scalar(float *x, float *y, float *vel_x, float *vel_y,
+                             const float *friction, int start, int count, float dt) {
+    for (int i = start; i < count; i++) {
+        x[i] += vel_x[i] * dt;
+        y[i] += vel_y[i] * dt;
+
+        float f = friction[i] * dt;
+        vel_x[i] = move_towardf(vel_x[i], 0.0f, f);
+        vel_y[i] = move_towardf(vel_y[i], 0.0f, f);
+    }
+}
+
+#if SIMD_X86
+SIMD_TARGET_SSE2
+static int integrate_sse2(float *x, float *y, float *vel_x, float *vel_y,
+                          const float *friction, int count, float dt) {
+    const __m128 vdt = _mm_set1_ps(dt);
+    const __m128 sign_mask = _mm_set1_ps(-0.0f);
+    const __m128 zero = _mm_setzero_ps();
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 vx = _mm_loadu_ps(vel_x + i);
+        __m128 vy = _mm_loadu_ps(vel_y + i);
+
+        _mm_storeu_ps(x + i, _mm_add_ps(_mm_loadu_ps(x + i), _mm_mul_ps(vx, vdt)));
+        _mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i), _mm_mul_ps(vy, vdt)));
+
+        __m128 f = _mm_mul_ps(_mm_loadu_ps(friction + i), vdt);
+
+        __m128 ax = _mm_max_ps(_mm_sub_ps(_mm_andnot_ps(sign_mask, vx), f), zero);
+        __m128 ay = _mm_max_ps(_mm_sub_ps(_mm_andnot_ps(sign_mask, vy), f), zero);
+        _mm_storeu_ps(vel_x + i, _mm_add_ps(_mm_or_ps(ax, _mm_and_ps(sign_mask, vx)), zero));
+        _mm_storeu_ps(vel_y + i, _mm_add_ps(_mm_or_ps(ay, _mm_and_ps(sign_mask, vy)), zero));
+    }
+    return i;
+}
+
+SIMD_TARGET_AVX2
+static int integrate_avx2(float *x, float *y, float *vel_x, float *vel_y,
+                          const float *friction, int count, float dt) {
+    const __m256 vdt = _mm256_set1_ps(dt);
+    const __m256 sign_mask = _mm256_set1_ps(-0.0f);
+    const __m256 zero = _mm256_setzero_ps();
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 vx = _mm256_loadu_ps(vel_x + i);
+        __m256 vy = _mm256_loadu_ps(vel_y + i);
+
+        // Separate mul + add (no FMA) keeps results bit-identical to the scalar path
+        _mm256_storeu_ps(x + i, _mm256_add_ps(_mm256_loadu_ps(x + i), _mm256_mul_ps(vx, vdt)));
+        _mm256_storeu_ps(y + i, _mm256_add_ps(_mm256_loadu_ps(y + i), _mm256_mul_ps(vy, vdt)));
+
+        __m256 f = _mm256_mul_ps(_mm256_loadu_ps(friction + i), vdt);
+
+        __m256 ax = _mm256_max_ps(_mm256_sub_ps(_mm256_andnot_ps(sign_mask, vx), f), zero);
+        __m256 ay = _mm256_max_ps(_mm256_sub_ps(_mm256_andnot_ps(sign_mask, vy), f), zero);
+        _mm256_storeu_ps(vel_x + i, _mm256_add_ps(_mm256_or_ps(ax, _mm256_and_ps(sign_mask, vx)), zero));
+        _mm256_storeu_ps(vel_y + i, _mm256_add_ps(_mm256_or_ps(ay, _mm256_and_ps(sign_mask, vy)), zero));
+    }
+    return i;
+}
+#endif
+
+void simd_integrate(float *x, float *y, float *vel_x, float *vel_y,
+                    const float *friction, int count, float dt) {
+    int done = 0;
+
+#if SIMD_X86
+    switch (simd_get_level()) {
+        case SIMD_LEVEL_AVX2:
+            done = integrate_avx2(x, y, vel_x, vel_y, friction, count, dt);
+            break;
+        case SIMD_LEVEL_SSE2:
+            done = integrate_sse2(x, y, vel_x, vel_y, friction, count, dt);
+            break;
+        default:
+            break;
+    }
+#endif
+
+    // Scalar path (and the 0-7 leftover bodies of the vector paths)
+    integrate_scalar(x, y, vel_x, vel_y, friction, done, count, dt);
+}
+
+// --- NARROW PHASE ---
+// The vector paths gather 4/8 pairs' centers and sizes, test and normalise them
+// all at once, then write out the lanes that hit. sqrt and div are the exact
+// IEEE operations (not rsqrt), so every lane matches check_circle_circle /
+// check_circle_rect bit for bit and the result doesn't depend on which lane, or
+// which thread's chunk, a pair landed in. (With the division done in the vector,
+// rsqrt plus a Newton step measured no faster.)
+
+// Write one hit. 'radius' is the overlap distance (radius sum for two circles);
+// nx/ny/depth are only read when the distance isn't 0
+static int emit_hit(int k, float distance, float nx, float ny, float depth, float radius,
+                    const int *slot, Manifold *out, int hits) {
+    Manifold m;
+    m.hit = 1;
+    if (distance == 0.0f) {
+        // Centers coincide: push along Y (as the Entity versions do)
+        m.depth = radius;
+        m.normal_x = 0;
+        m.normal_y = -1;
+    } else {
+        m.depth = depth;
+        m.normal_x = nx;
+        m.normal_y = ny;
+    }
+    out[slot[k]] = m;
+    return hits + 1;
+}
+
+static int circle_circle_scalar(const float *cx, const float *cy, const float *hw,
+                                const int *ia, const int *ib, int start, int count,
+                                const int *slot, Manifold *out, int hits) {
+    for (int k = start; k < count; k++) {
+        int a = ia[k], b = ib[k];
+        float dx = cx[b] - cx[a];
+        float dy = cy[b] - cy[a];
+        float dist_sq = dx*dx + dy*dy;
+        float radius_sum = hw[a] + hw[b];
+        if (dist_sq >= radius_sum * radius_sum) continue;
+
+        float distance = sqrtf(dist_sq);
+        hits = emit_hit(k, distance, dx / distance, dy / distance, radius_sum - distance, radius_sum,
+                        slot, out, hits);
+    }
+    return hits;
+}
+
+static int circle_rect_scalar(const float *cx, const float *cy, const float *hw, const float *hh,
+                              const int *ic, const int *ir, int start, int count,
+                              const int *slot, Manifold *out, int hits) {
+    for (int k = start; k < count; k++) {
+        int c = ic[k], r = ir[k];
+        float closest_x = fmaxf(cx[r] - hw[r], fminf(cx[c], cx[r] + hw[r]));
+        float closest_y = fmaxf(cy[r] - hh[r], fminf(cy[c], cy[r] + hh[r]));
+        float dx = closest_x - cx[c];
+        float dy = closest_y - cy[c];
+        float dist_sq = dx*dx + dy*dy;
+        float radius = hw[c];
+        if (dist_sq >= radius * radius) continue;
+
+        float distance = sqrtf(dist_sq);
+        hits = emit_hit(k, distance, dx / distance, dy / distance, radius - distance, radius,
+                        slot, out, hits);
+    }
+    return hits;
+}
+
+#if SIMD_X86
+// Index of the lowest set bit (m != 0)
+#if defined(_MSC_VER)
+static int lowest_bit(unsigned int m) {
+    unsigned long i;
+    _BitScanForward(&i, m);
+    return (int)i;
+}
+#else
+    #define lowest_bit(m) __builtin_ctz(m)
+#endif
+
+// Lanes of one vector, as stored by the kernels below
+typedef struct {
+    float distance[8];
+    float nx[8], ny[8];
+    float depth[8];
+    float radius[8];
+} SimdLanes;
+
+// Write the hit lanes of one vector (bit i of 'mask' = lane i hit) as manifolds.
+// A macro so it compiles inside each kernel with that kernel's instruction set:
+// as a function it stays a call into SSE code, which costs more than the test
+#define EMIT_LANES(lanes, mask, base, slot, out, hits) do { \
+    for (unsigned int bits_ = (unsigned int)(mask); bits_; bits_ &= bits_ - 1) { \
+        int lane_ = lowest_bit(bits_); \
+        Manifold *m_ = &(out)[(slot)[(base) + lane_]]; \
+        m_->hit = 1; \
+        if ((lanes).distance[lane_] == 0.0f) { \
+            m_->depth = (lanes).radius[lane_]; \
+            m_->normal_x = 0; \
+            m_->normal_y = -1; \
+        } else { \
+            m_->depth = (lanes).depth[lane_]; \
+            m_->normal_x = (lanes).nx[lane_]; \
+            m_->normal_y = (lanes).ny[lane_]; \
+        } \
+        (hits)++; \
+    } \
+} while (0)
+
+SIMD_TARGET_SSE2
+static int circle_circle_sse2(const float *cx, const float *cy, const float *hw,
+                              const int *ia, const int *ib, int count,
+                              const int *slot, Manifold *out, int *hits) {
+    SimdLanes lanes;
+    int found = *hits;  // Local copy: stores through out could alias *hits
+
+    int k = 0;
+    for (; k + 4 <= count; k += 4) {
+        const int *a = ia + k, *b = ib + k;
+        __m128 ax = _mm_setr_ps(cx[a[0]], cx[a[1]], cx[a[2]], cx[a[3]]);
+        __m128 ay = _mm_setr_ps(cy[a[0]], cy[a[1]], cy[a[2]], cy[a[3]]);
+        __m128 ar = _mm_setr_ps(hw[a[0]], hw[a[1]], hw[a[2]], hw[a[3]]);
+        __m128 bx = _mm_setr_ps(cx[b[0]], cx[b[1]], cx[b[2]], cx[b[3]]);
+        __m128 by = _mm_setr_ps(cy[b[0]], cy[b[1]], cy[b[2]], cy[b[3]]);
+        __m128 br = _mm_setr_ps(hw[b[0]], hw[b[1]], hw[b[2]], hw[b[3]]);
+
+        __m128 vdx = _mm_sub_ps(bx, ax);
+        __m128 vdy = _mm_sub_ps(by, ay);
+        __m128 vd2 = _mm_add_ps(_mm_mul_ps(vdx, vdx), _mm_mul_ps(vdy, vdy));
+        __m128 vrs = _mm_add_ps(ar, br);
+
+        int mask = _mm_movemask_ps(_mm_cmplt_ps(vd2, _mm_mul_ps(vrs, vrs)));
+        if (!mask) continue;
+
+        // Lanes with a zero distance divide by zero here; EMIT_LANES ignores their results
+        __m128 dist = _mm_sqrt_ps(vd2);
+        _mm_storeu_ps(lanes.distance, dist);
+        _mm_storeu_ps(lanes.nx, _mm_div_ps(vdx, dist));
+        _mm_storeu_ps(lanes.ny, _mm_div_ps(vdy, dist));
+        _mm_storeu_ps(lanes.depth, _mm_sub_ps(vrs, dist));
+        _mm_storeu_ps(lanes.radius, vrs);
+        EMIT_LANES(lanes, mask, k, slot, out, found);
+    }
+    *hits = found;
+    return k;
+}
+
+SIMD_TARGET_SSE2
+static int circle_rect_sse2(const float *cx, const float *cy, const float *hw, const float *hh,
+                            const int *ic, const int *ir, int count,
+                            const int *slot, Manifold *out, int *hits) {
+    SimdLanes lanes;
+    int found = *hits;  // Local copy: stores through out could alias *hits
+
+    int k = 0;
+    for (; k + 4 <= count; k += 4) {
+        const int *c = ic + k, *r = ir + k;
+        __m128 px = _mm_setr_ps(cx[c[0]], cx[c[1]], cx[c[2]], cx[c[3]]);
+        __m128 py = _mm_setr_ps(cy[c[0]], cy[c[1]], cy[c[2]], cy[c[3]]);
+        __m128 pr = _mm_setr_ps(hw[c[0]], hw[c[1]], hw[c[2]], hw[c[3]]);
+        __m128 rx = _mm_setr_ps(cx[r[0]], cx[r[1]], cx[r[2]], cx[r[3]]);
+        __m128 ry = _mm_setr_ps(cy[r[0]], cy[r[1]], cy[r[2]], cy[r[3]]);
+        __m128 rw = _mm_setr_ps(hw[r[0]], hw[r[1]], hw[r[2]], hw[r[3]]);
+        __m128 rh = _mm_setr_ps(hh[r[0]], hh[r[1]], hh[r[2]], hh[r[3]]);
+
+        // Closest point of the box to the circle center
+        __m128 qx = _mm_max_ps(_mm_sub_ps(rx, rw), _mm_min_ps(px, _mm_add_ps(rx, rw)));
+        __m128 qy = _mm_max_ps(_mm_sub_ps(ry, rh), _mm_min_ps(py, _mm_add_ps(ry, rh)));
+
+        __m128 vdx = _mm_sub_ps(qx, px);
+        __m128 vdy = _mm_sub_ps(qy, py);
+        __m128 vd2 = _mm_add_ps(_mm_mul_ps(vdx, vdx), _mm_mul_ps(vdy, vdy));
+
+        int mask = _mm_movemask_ps(_mm_cmplt_ps(vd2, _mm_mul_ps(pr, pr)));
+        if (!mask) continue;
+
+        __m128 dist = _mm_sqrt_ps(vd2);
+        _mm_storeu_ps(lanes.distance, dist);
+        _mm_storeu_ps(lanes.nx, _mm_div_ps(vdx, dist));
+        _mm_storeu_ps(lanes.ny, _mm_div_ps(vdy, dist));
+        _mm_storeu_ps(lanes.depth, _mm_sub_ps(pr, dist));
+        _mm_storeu_ps(lanes.radius, pr);
+        EMIT_LANES(lanes, mask, k, slot, out, found);
+    }
+    *hits = found;
+    return k;
+}
+
+SIMD_TARGET_AVX2
+static int circle_circle_avx2(const float *cx, const float *cy, const float *hw,
+                              const int *ia, const int *ib, int count,
+                              const int *slot, Manifold *out, int *hits) {
+    SimdLanes lanes;
+    int found = *hits;  // Local copy: stores through out could alias *hits
+
+    int k = 0;
+    for (; k + 8 <= count; k += 8) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(ia + k));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(ib + k));
+
+        __m256 vdx = _mm256_sub_ps(_mm256_i32gather_ps(cx, b, 4), _mm256_i32gather_ps(cx, a, 4));
+        __m256 vdy = _mm256_sub_ps(_mm256_i32gather_ps(cy, b, 4), _mm256_i32gather_ps(cy, a, 4));
+        __m256 vrs = _mm256_add_ps(_mm256_i32gather_ps(hw, a, 4), _mm256_i32gather_ps(hw, b, 4));
+        // Separate mul + add (no FMA), as in the scalar code
+        __m256 vd2 = _mm256_add_ps(_mm256_mul_ps(vdx, vdx), _mm256_mul_ps(vdy, vdy));
+
+        int mask = _mm256_movemask_ps(_mm256_cmp_ps(vd2, _mm256_mul_ps(vrs, vrs), _CMP_LT_OQ));
+        if (!mask) continue;
+
+        // Lanes with a zero distance divide by zero here; EMIT_LANES ignores their results
+        __m256 dist = _mm256_sqrt_ps(vd2);
+        _mm256_storeu_ps(lanes.distance, dist);
+        _mm256_storeu_ps(lanes.nx, _mm256_div_ps(vdx, dist));
+        _mm256_storeu_ps(lanes.ny, _mm256_div_ps(vdy, dist));
+        _mm256_storeu_ps(lanes.depth, _mm256_sub_ps(vrs, dist));
+        _mm256_storeu_ps(lanes.radius, vrs);
+        EMIT_LANES(lanes, mask, k, slot, out, found);
+    }
+    *hits = found;
+    return k;
+}
+
+SIMD_TARGET_AVX2
+static int circle_rect_avx2(const float *cx, const float *cy, const float *hw, const float *hh,
+                            const int *ic, const int *ir, int count,
+                            const int *slot, Manifold *out, int *hits) {
+    SimdLanes lanes;
+    int found = *hits;  // Local copy: stores through out could alias *hits
+
+    int k = 0;
+    for (; k + 8 <= count; k += 8) {
+        __m256i c = _mm256_loadu_si256((const __m256i*)(ic + k));
+        __m256i r = _mm256_loadu_si256((const __m256i*)(ir + k));
+
+        __m256 px = _mm256_i32gather_ps(cx, c, 4);
+        __m256 py = _mm256_i32gather_ps(cy, c, 4);
+        __m256 pr = _mm256_i32gather_ps(hw, c, 4);
+        __m256 rx = _mm256_i32gather_ps(cx, r, 4);
+        __m256 ry = _mm256_i32gather_ps(cy, r, 4);
+        __m256 rw = _mm256_i32gather_ps(hw, r, 4);
+        __m256 rh = _mm256_i32gather_ps(hh, r, 4);
+
+        // Closest point of the box to the circle center
+        __m256 qx = _mm256_max_ps(_mm256_sub_ps(rx, rw), _mm256_min_ps(px, _mm256_add_ps(rx, rw)));
+        __m256 qy = _mm256_max_ps(_mm256_sub_ps(ry, rh), _mm256_min_ps(py, _mm256_add_ps(ry, rh)));
+
+        __m256 vdx = _mm256_sub_ps(qx, px);
+        __m256 vdy = _mm256_sub_ps(qy, py);
+        __m256 vd2 = _mm256_add_ps(_mm256_mul_ps(vdx, vdx), _mm256_mul_ps(vdy, vdy));
+
+        int mask = _mm256_movemask_ps(_mm256_cmp_ps(vd2, _mm256_mul_ps(pr, pr), _CMP_LT_OQ));
+        if (!mask) continue;
+
+        __m256 dist = _mm256_sqrt_ps(vd2);
+        _mm256_storeu_ps(lanes.distance, dist);
+        _mm256_storeu_ps(lanes.nx, _mm256_div_ps(vdx, dist));
+        _mm256_storeu_ps(lanes.ny, _mm256_div_ps(vdy, dist));
+        _mm256_storeu_ps(lanes.depth, _mm256_sub_ps(pr, dist));
+        _mm256_storeu_ps(lanes.radius, pr);
+        EMIT_LANES(lanes, mask, k, slot, out, found);
+    }
+    *hits = found;
+    return k;
+}
+#endif
+
+int simd_circle_circle(const float *cx, const float *cy, const float *hw,
+                       const int *ia, const int *ib, int count,
+                       const int *slot, Manifold *out) {
+    int done = 0;
+    int hits = 0;
+
+#if SIMD_X86
+    switch (simd_get_level()) {
+        case SIMD_LEVEL_AVX2:
+            done = circle_circle_avx2(cx, cy, hw, ia, ib, count, slot, out, &hits);
+            break;
+        case SIMD_LEVEL_SSE2:
+            done = circle_circle_sse2(cx, cy, hw, ia, ib, count, slot, out, &hits);
+            break;
+        default:
+            break;
+    }
+#endif
+
+    return circle_circle_scalar(cx, cy, hw, ia, ib, done, count, slot, out, hits);
+}
+
+int simd_circle_rect(const float *cx, const float *cy, const float *hw, const float *hh,
+                     const int *ic, const int *ir, int count,
+                     const int *slot, Manifold *out) {
+    int done = 0;
+    int hits = 0;
+
+#if SIMD_X86
+    switch (simd_get_level()) {
+        case SIMD_LEVEL_AVX2:
+            done = circle_rect_avx2(cx, cy, hw, hh, ic, ir, count, slot, out, &hits);
+            break;
+        case SIMD_LEVEL_SSE2:
+            done = circle_rect_sse2(cx, cy, hw, hh, ic, ir, count, slot, out, &hits);
+            break;
+        default:
+            break;
+    }
+#endif
+
+    return circle_rect_scalar(cx, cy, hw, hh, ic, ir, done, count, slot, out, hits);
+}
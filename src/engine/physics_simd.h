@@ -0,0 +1,51 @@
+// physics_simd.h — Vectorised physics kernels
+//
+// Kernels operate on the packed body arrays used by physics_update.
+// The instruction set is picked at runtime (AVX2 -> SSE2 -> scalar), so the
+// same binary runs on any x86 CPU and non-x86 builds just use the scalar path.
+//
+#ifndef PHYSICS_SIMD_H
+#define PHYSICS_SIMD_H
+
+#include "physics.h"  // Manifold
+
+typedef enum {
+    SIMD_LEVEL_SCALAR,  // Plain C (always available)
+    SIMD_LEVEL_SSE2,    // 4 floats per instruction (baseline on x64)
+    SIMD_LEVEL_AVX2,    // 8 floats per instruction
+} SimdLevel;
+
+// Best level supported by this CPU/OS
+SimdLevel simd_detect(void);
+
+// Level used by the kernels (defaults to simd_detect())
+// simd_set_level is clamped to what the CPU supports (useful for A/B benchmarks)
+SimdLevel simd_get_level(void);
+void simd_set_level(SimdLevel level);
+const char* simd_level_name(SimdLevel level);
+
+// --- KERNELS ---
+
+// Integrate 'count' bodies: x += vel * dt, then move each velocity component
+// toward zero by friction * dt (same result as move_towardf, per component)
+void simd_integrate(float *x, float *y, float *vel_x, float *vel_y,
+                    const float *friction, int count, float dt);
+
+// Contacts for 'count' pairs of bodies given as indices into the packed arrays
+// (cx/cy: collider centers, hw/hh: half extents, radius in hw for circles).
+// Same arithmetic as check_circle_circle / check_circle_rect, so the same
+// manifolds. Only hits are written: pair k's goes to out[slot[k]] (misses
+// leave their entry alone). Returns the number of hits
+
+// Pair k is circles ia[k] and ib[k]; the normal points from A to B
+int simd_circle_circle(const float *cx, const float *cy, const float *hw,
+                       const int *ia, const int *ib, int count,
+                       const int *slot, Manifold *out);
+
+// Pair k is circle ic[k] and rect ir[k]; the normal points from the circle to the
+// rect (negate it when the rect is body A)
+int simd_circle_rect(const float *cx, const float *cy, const float *hw, const float *hh,
+                     const int *ic, const int *ir, int count,
+                     const int *slot, Manifold *out);
+
+#endif
@@ -3,6 +3,7 @@
 #include "sandbox.h"
 #include "lighting.h"
 #include "math_common.h"
+#include "physics.h"
 #include <math.h>
 #include <stdio.h>
 
@@ -137,8 +138,8 @@ void movement_8dir(Entity *e, float dt) {
     
     // Accelerate toward target (or let physics friction slow us down if no input)
     if (fabsf(dx) > 0.01f || fabsf(dy) > 0.01f) {
-        e->vel_x = move_towardf(e->vel_x, target_vx, e->acceleration * dt);
-        e->vel_y = move_towardf(e->vel_y, target_vy, e->acceleration * dt);
+        physics_set_velocity(e, move_towardf(e->vel_x, target_vx, e->acceleration * dt),
+                                move_towardf(e->vel_y, target_vy, e->acceleration * dt));
         // Face movement direction
         e->rotation = atan2f(dy, dx) * (180.0f / 3.14159f);
     }
@@ -164,8 +165,8 @@ void movement_4dir(Entity *e, float dt) {
     
     // Accelerate toward target
     if (fabsf(dx) > 0.01f || fabsf(dy) > 0.01f) {
-        e->vel_x = move_towardf(e->vel_x, target_vx, e->acceleration * dt);
-        e->vel_y = move_towardf(e->vel_y, target_vy, e->acceleration * dt);
+        physics_set_velocity(e, move_towardf(e->vel_x, target_vx, e->acceleration * dt),
+                                move_towardf(e->vel_y, target_vy, e->acceleration * dt));
         // Face movement direction
         e->rotation = atan2f(dy, dx) * (180.0f / 3.14159f);
     }
@@ -193,8 +194,8 @@ void movement_tank(Entity *e, float dt) {
     if (fabsf(forward_input) > 0.01f) {
         float target_vx = forward_x * forward_input * e->max_speed;
         float target_vy = forward_y * forward_input * e->max_speed;
-        e->vel_x = move_towardf(e->vel_x, target_vx, e->acceleration * dt);
-        e->vel_y = move_towardf(e->vel_y, target_vy, e->acceleration * dt);
+        physics_set_velocity(e, move_towardf(e->vel_x, target_vx, e->acceleration * dt),
+                                move_towardf(e->vel_y, target_vy, e->acceleration * dt));
     }
 }
 
@@ -208,8 +209,8 @@ void movement_strafe(Entity *e, GameState *state, float dt) {
     
     // Accelerate toward target
     if (fabsf(dx) > 0.01f || fabsf(dy) > 0.01f) {
-        e->vel_x = move_towardf(e->vel_x, target_vx, e->acceleration * dt);
-        e->vel_y = move_towardf(e->vel_y, target_vy, e->acceleration * dt);
+        physics_set_velocity(e, move_towardf(e->vel_x, target_vx, e->acceleration * dt),
+                                move_towardf(e->vel_y, target_vy, e->acceleration * dt));
     }
 
     // Face mouse position using SCREEN-SPACE coordinates
@@ -289,8 +290,8 @@ void movement_click(Entity *e, GameState *state, float dt, int look_at_mouse) {
             float target_vy = dir_y * e->max_speed;
             
             // Accelerate toward target
-            e->vel_x = move_towardf(e->vel_x, target_vx, e->acceleration * dt);
-            e->vel_y = move_towardf(e->vel_y, target_vy, e->acceleration * dt);
+            physics_set_velocity(e, move_towardf(e->vel_x, target_vx, e->acceleration * dt),
+                                    move_towardf(e->vel_y, target_vy, e->acceleration * dt));
             
             // Face movement direction (if not looking at mouse)
             if (!look_at_mouse) {
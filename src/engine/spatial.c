@@ -1,44 +1,125 @@
 // spatial.c — Spatial partitioning implementation
 // 
-// Currently implements: Uniform Grid
-// Designed for easy addition of other backends (hash, quadtree, etc.)
+// Currently implements: Uniform Grid, Spatial Hash, Loose Quadtree (spatial_quadtree.c),
+// Sweep and Prune (spatial_sap.c), Dynamic AABB Tree (spatial_bvh.c),
+// Hierarchical Grid (spatial_hgrid.c)
+// Designed for easy addition of other backends
 //
 
-#include "spatial.h"
+#include "spatial_internal.h"
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
 
 // --- UNIFORM GRID IMPLEMENTATION ---
+// Cells are stored in compressed (CSR) form: inserts are only recorded, and a
+// rebuild counts entities per cell, prefix-sums the counts into cell offsets and
+// scatters entry indices into one flat array. No per-cell capacity, so dense
+// clusters never drop entities, and empty cells cost 4 bytes.
+//
+// Entries are keyed by entity slot and persist: re-inserting an entity whose
+// covered cell range didn't change only refreshes its AABB, so the cells are
+// rebuilt only when something crossed a cell border, appeared or disappeared.
+//
+// SPATIAL_TYPE_HASH uses the same structure with unbounded cell coordinates:
+// only occupied cells exist, as slots of an open-addressed (linear probing) hash
+// table, and the CSR offsets are indexed by slot instead of by cy * cols + cx.
+
+typedef struct {
+    Entity* entity;
+    EntityHandle id;        // Detects a recycled entity slot
+    unsigned int seen;      // Frame this entry was last inserted
+    float min_x, min_y;     // Collider AABB
+    float max_x, max_y;
+    uint32_t layer, mask;   // Copied from the collider for pair filtering
+    int min_cx, min_cy;     // Covered cell range (inclusive)
+    int max_cx, max_cy;
+} GridEntry;
 
+// One occupied cell of the spatial hash
 typedef struct {
-    Entity* entities[SPATIAL_MAX_PER_CELL];
-    int count;
-} GridCell;
+    int cx, cy;
+    unsigned int build;     // Slot is in use iff build == UniformGrid.hash_build
+} HashSlot;
 
 typedef struct {
-    GridCell* cells;        // Flat array of cells
-    int cols;               // Number of columns (X)
-    int rows;               // Number of rows (Y)
+    int hashed;             // 0 = bounded grid (SPATIAL_TYPE_GRID), 1 = spatial hash
+    int cols;               // Number of columns (X) - bounded grid only
+    int rows;               // Number of rows (Y) - bounded grid only
     float cell_size;
     float world_width;
     float world_height;
-    int total_entities;     // Stats tracking
+
+    GridEntry* entries;     // Live entries (swap-remove)
+    int entry_count;
+    int entry_capacity;
+    int* entry_of_slot;     // Entity slot index -> entry index (-1 = none)
+    int entry_slot_capacity;
+    unsigned int frame;     // Bumped by clear; entries not re-inserted are swept
+    int sweep_pending;
+    int moved;              // Entries whose cell range changed since the last clear
+
+    int* cell_start;        // bucket_count + 1 offsets: bucket c owns cell_items[cell_start[c] .. cell_start[c+1])
+    int* cell_items;        // Entry indices grouped by cell
+    int item_count;         // Total cell memberships (entities spanning cells count once per cell)
+    int item_capacity;
+    int occupied;           // Non-empty cells in the last build
+    int max_per_cell;       // Fullest cell in the last build
+    int dirty;              // Entries changed since the last build
+
+    // Spatial hash only: occupied cells (power-of-two capacity, kept under 50% load)
+    HashSlot* slots;
+    int slot_capacity;
+    int slot_count;         // Occupied cells in the last build
+    unsigned int hash_build;
+
+    unsigned int* entry_stamp;  // Per entry: last query that reported it (O(1) de-duplication)
+    int stamp_capacity;
+    unsigned int query_stamp;
 } UniformGrid;
 
 // The actual SpatialIndex structure (opaque to user)
 struct SpatialIndex {
     SpatialType type;
+    SpatialConfig config;       // Kept to create the static layer on demand
+    SpatialIndex* static_layer; // Entities added with spatial_insert_static (NULL until then)
+
+    Entity** scratch;           // Static-layer candidates while pairing (grows as needed)
+    int scratch_capacity;
+
+    int truncated_queries;      // Queries that hit max_candidates since the last clear
+    int dropped_candidates;     // Candidates those queries could not return
+
+    // Adaptive cell size (config.tuning): the current window's samples
+    int tune_frames;
+    double tune_occupancy;      // Sum of entities per occupied cell
+    double tune_span;           // Sum of cells per entity
+    int tune_max_per_cell;
+    int tune_truncated;
+    int resizes;                // Cell size changes so far
+
     union {
-        UniformGrid grid;
-        // Future: SpatialHash hash;
-        // Future: Quadtree tree;
+        UniformGrid grid;   // SPATIAL_TYPE_GRID and SPATIAL_TYPE_HASH
+        LooseQuadtree tree; // SPATIAL_TYPE_QUADTREE
+        SweepAndPrune sap;  // SPATIAL_TYPE_SAP
+        AabbTree bvh;       // SPATIAL_TYPE_BVH
+        HierarchicalGrid hgrid; // SPATIAL_TYPE_HGRID
     } data;
 };
 
 // --- GRID HELPERS ---
 
+// Hashed cells keep coordinates well inside int range (2^29 cells each way)
+#define HASH_CELL_LIMIT 536870912.0f
+
 static inline int grid_get_cell_x(UniformGrid* grid, float x) {
+    if (grid->hashed) {
+        float c = floorf(x / grid->cell_size);
+        if (!(c > -HASH_CELL_LIMIT)) c = -HASH_CELL_LIMIT;  // Also catches NaN
+        if (c > HASH_CELL_LIMIT) c = HASH_CELL_LIMIT;
+        return (int)c;
+    }
     int cx = (int)(x / grid->cell_size);
     if (cx < 0) cx = 0;
     if (cx >= grid->cols) cx = grid->cols - 1;
@@ -46,6 +127,12 @@ static inline int grid_get_cell_x(UniformGrid* grid, float x) {
 }
 
 static inline int grid_get_cell_y(UniformGrid* grid, float y) {
+    if (grid->hashed) {
+        float c = floorf(y / grid->cell_size);
+        if (!(c > -HASH_CELL_LIMIT)) c = -HASH_CELL_LIMIT;
+        if (c > HASH_CELL_LIMIT) c = HASH_CELL_LIMIT;
+        return (int)c;
+    }
     int cy = (int)(y / grid->cell_size);
     if (cy < 0) cy = 0;
     if (cy >= grid->rows) cy = grid->rows - 1;
@@ -56,21 +143,203 @@ static inline int grid_cell_index(UniformGrid* grid, int cx, int cy) {
     return cy * grid->cols + cx;
 }
 
-static void grid_insert_into_cell(UniformGrid* grid, int cx, int cy, Entity* entity) {
-    if (cx < 0 || cx >= grid->cols || cy < 0 || cy >= grid->rows) return;
-    
-    int idx = grid_cell_index(grid, cx, cy);
-    GridCell* cell = &grid->cells[idx];
-    
-    if (cell->count < SPATIAL_MAX_PER_CELL) {
-        cell->entities[cell->count++] = entity;
+// Buffers are reused across frames, so steady-state inserts don't allocate
+int spatial_grow_buffer(void** buffer, int* capacity, int needed, size_t elem_size) {
+    if (needed <= *capacity) return 1;
+
+    int new_capacity = *capacity ? *capacity : 256;
+    while (new_capacity < needed) new_capacity *= 2;
+
+    void* p = realloc(*buffer, (size_t)new_capacity * elem_size);
+    if (!p) return 0;
+    *buffer = p;
+    *capacity = new_capacity;
+    return 1;
+}
+
+// --- HASH HELPERS ---
+
+static inline unsigned int hash_cell(int cx, int cy) {
+    unsigned int h = (unsigned int)cx * 0x8DA6B343u ^ (unsigned int)cy * 0xD8163841u;
+    h ^= h >> 15;
+    h *= 0x2C1B3C6Du;
+    h ^= h >> 12;
+    return h;
+}
+
+// Slot holding cell (cx, cy) in the current build, or -1
+static inline int hash_find(UniformGrid* grid, int cx, int cy) {
+    unsigned int mask = (unsigned int)grid->slot_capacity - 1;
+    unsigned int i = hash_cell(cx, cy) & mask;
+    while (grid->slots[i].build == grid->hash_build) {
+        if (grid->slots[i].cx == cx && grid->slots[i].cy == cy) return (int)i;
+        i = (i + 1) & mask;
+    }
+    return -1;
+}
+
+// Slot for cell (cx, cy), claiming a free one if needed
+// Returns -1 when the table would pass 50% load (caller grows and rebuilds)
+static inline int hash_find_or_add(UniformGrid* grid, int cx, int cy) {
+    unsigned int mask = (unsigned int)grid->slot_capacity - 1;
+    unsigned int i = hash_cell(cx, cy) & mask;
+    while (grid->slots[i].build == grid->hash_build) {
+        if (grid->slots[i].cx == cx && grid->slots[i].cy == cy) return (int)i;
+        i = (i + 1) & mask;
+    }
+    if ((grid->slot_count + 1) * 2 > grid->slot_capacity) return -1;
+
+    grid->slots[i].cx = cx;
+    grid->slots[i].cy = cy;
+    grid->slots[i].build = grid->hash_build;
+    grid->slot_count++;
+    return (int)i;
+}
+
+// Allocate table + offsets for 'capacity' slots (power of two); all slots start free
+static int hash_alloc(UniformGrid* grid, int capacity) {
+    HashSlot* slots = calloc((size_t)capacity, sizeof(HashSlot));
+    int* start = calloc((size_t)capacity + 1, sizeof(int));
+    if (!slots || !start) {
+        free(slots);
+        free(start);
+        return 0;
+    }
+    free(grid->slots);
+    free(grid->cell_start);
+    grid->slots = slots;
+    grid->cell_start = start;
+    grid->slot_capacity = capacity;
+    grid->hash_build = 0;  // calloc'd slots carry build 0; the next build uses 1
+    return 1;
+}
+
+// Bucket (CSR row) of cell (cx, cy), or -1 if the cell is empty/absent
+static inline int grid_bucket(UniformGrid* grid, int cx, int cy) {
+    return grid->hashed ? hash_find(grid, cx, cy) : grid_cell_index(grid, cx, cy);
+}
+
+static inline int grid_bucket_count(UniformGrid* grid) {
+    return grid->hashed ? grid->slot_capacity : grid->cols * grid->rows;
+}
+
+// Start a query: returns a stamp no entry carries yet
+static unsigned int grid_next_stamp(UniformGrid* grid) {
+    if (++grid->query_stamp == 0) {
+        // Wrapped: reset so stale stamps can't match
+        memset(grid->entry_stamp, 0, (size_t)grid->stamp_capacity * sizeof(unsigned int));
+        grid->query_stamp = 1;
+    }
+    return grid->query_stamp;
+}
+
+// Count memberships per bucket into start[] (claiming hash slots as we go)
+// Returns total memberships, or -1 if the hash table needs to grow
+static int grid_count_cells(UniformGrid* grid) {
+    int* start = grid->cell_start;
+    int items = 0;
+
+    for (int i = 0; i < grid->entry_count; i++) {
+        GridEntry* e = &grid->entries[i];
+        for (int cy = e->min_cy; cy <= e->max_cy; cy++) {
+            for (int cx = e->min_cx; cx <= e->max_cx; cx++) {
+                int b;
+                if (grid->hashed) {
+                    b = hash_find_or_add(grid, cx, cy);
+                    if (b < 0) return -1;
+                } else {
+                    b = grid_cell_index(grid, cx, cy);
+                }
+                start[b]++;
+            }
+        }
+        items += (e->max_cx - e->min_cx + 1) * (e->max_cy - e->min_cy + 1);
+    }
+    return items;
+}
+
+// Counting sort of entries into cells
+static void grid_build(UniformGrid* grid) {
+    int items;
+
+    for (;;) {
+        if (grid->hashed) {
+            // Fresh build number frees every slot without touching the table
+            if (++grid->hash_build == 0) {
+                memset(grid->slots, 0, (size_t)grid->slot_capacity * sizeof(HashSlot));
+                grid->hash_build = 1;
+            }
+            grid->slot_count = 0;
+        }
+        memset(grid->cell_start, 0, (size_t)(grid_bucket_count(grid) + 1) * sizeof(int));
+
+        items = grid_count_cells(grid);
+        if (items >= 0) break;
+
+        // Too many occupied cells for the table: double it and count again
+        // (only happens while the world is still spreading out, not per frame)
+        if (!hash_alloc(grid, grid->slot_capacity * 2)) {
+            items = -1;
+            break;
+        }
+    }
+
+    int total_buckets = grid_bucket_count(grid);
+    int* start = grid->cell_start;
+
+    // Stamps are per entry; new slots start at 0 (older than any live stamp)
+    int old_stamps = grid->stamp_capacity;
+    if (items < 0 ||
+        !spatial_grow_buffer((void**)&grid->cell_items, &grid->item_capacity, items, sizeof(int)) ||
+        !spatial_grow_buffer((void**)&grid->entry_stamp, &grid->stamp_capacity, grid->entry_count, sizeof(unsigned int))) {
+        // Out of memory: leave the grid empty rather than write past the buffer
+        memset(start, 0, (size_t)(total_buckets + 1) * sizeof(int));
+        if (grid->hashed) grid->hash_build++;  // Forget any claimed slots
+        grid->slot_count = 0;
+        grid->item_count = 0;
+        grid->occupied = 0;
+        grid->max_per_cell = 0;
+        grid->dirty = 0;
+        return;
+    }
+
+    if (grid->stamp_capacity > old_stamps) {
+        memset(grid->entry_stamp + old_stamps, 0,
+               (size_t)(grid->stamp_capacity - old_stamps) * sizeof(unsigned int));
+    }
+
+    // Inclusive prefix sum: start[c] = end of bucket c (counting occupancy on the way)
+    int sum = 0, occupied = 0, max_per_cell = 0;
+    for (int c = 0; c < total_buckets; c++) {
+        int n = start[c];
+        if (n > 0) {
+            occupied++;
+            if (n > max_per_cell) max_per_cell = n;
+        }
+        sum += n;
+        start[c] = sum;
     }
-    // If cell is full, entity won't be added (increase SPATIAL_MAX_PER_CELL if this happens)
+    start[total_buckets] = sum;
+
+    // Scatter back to front; decrementing leaves start[c] at the beginning of bucket c
+    // (and keeps entries in insertion order within each cell)
+    for (int i = grid->entry_count - 1; i >= 0; i--) {
+        GridEntry* e = &grid->entries[i];
+        for (int cy = e->max_cy; cy >= e->min_cy; cy--) {
+            for (int cx = e->max_cx; cx >= e->min_cx; cx--) {
+                grid->cell_items[--start[grid_bucket(grid, cx, cy)]] = i;
+            }
+        }
+    }
+
+    grid->item_count = items;
+    grid->occupied = occupied;
+    grid->max_per_cell = max_per_cell;
+    grid->dirty = 0;
 }
 
-// Get the AABB of an entity's collider
-static void get_entity_bounds(Entity* e, float* out_min_x, float* out_min_y, 
-                               float* out_max_x, float* out_max_y) {
+void spatial_entity_bounds(Entity* e, float* out_min_x, float* out_min_y,
+                           float* out_max_x, float* out_max_y) {
     float cx = e->x + e->collider.offset_x;
     float cy = e->y + e->collider.offset_y;
     
@@ -90,13 +359,434 @@ static void get_entity_bounds(Entity* e, float* out_min_x, float* out_min_y,
     }
 }
 
+// Report the not-yet-seen entries of one bucket
+static void grid_query_bucket(UniformGrid* grid, int bucket, unsigned int stamp, Entity* self,
+                              Entity** out, int max_out, int* count, int* dropped) {
+    int end = grid->cell_start[bucket + 1];
+    
+    for (int i = grid->cell_start[bucket]; i < end; i++) {
+        int k = grid->cell_items[i];
+        
+        // Skip entities already seen in another cell (multi-cell entities)
+        if (grid->entry_stamp[k] == stamp) continue;
+        grid->entry_stamp[k] = stamp;
+        
+        Entity* candidate = grid->entries[k].entity;
+        
+        // Skip self
+        if (candidate == self) continue;
+        
+        if (*count < max_out) {
+            out[(*count)++] = candidate;
+        } else {
+            (*dropped)++;  // Keep scanning so the stats report the real shortfall
+        }
+    }
+}
+
+// --- GRID ENTRIES ---
+
+// Swap-remove entry k (the cells are rebuilt on the next query)
+static void grid_remove_entry(UniformGrid* grid, int k) {
+    grid->entry_of_slot[ENTITY_HANDLE_INDEX(grid->entries[k].id)] = -1;
+
+    int last = --grid->entry_count;
+    if (k != last) {
+        grid->entries[k] = grid->entries[last];
+        grid->entry_of_slot[ENTITY_HANDLE_INDEX(grid->entries[k].id)] = k;
+    }
+    grid->dirty = 1;
+}
+
+// Drop entries that weren't re-inserted since the last clear
+static void grid_sweep(UniformGrid* grid) {
+    for (int k = grid->entry_count - 1; k >= 0; k--) {
+        if (grid->entries[k].seen != grid->frame) grid_remove_entry(grid, k);
+    }
+    grid->sweep_pending = 0;
+}
+
+// Bring the cells up to date before reading them
+static void grid_prepare(UniformGrid* grid) {
+    if (grid->sweep_pending) grid_sweep(grid);
+    if (grid->dirty) grid_build(grid);
+}
+
+// Insert or update an entity's entry; only a changed cell range dirties the cells
+static void grid_upsert(UniformGrid* grid, Entity* entity,
+                        float min_x, float min_y, float max_x, float max_y) {
+    int slot = (int)ENTITY_HANDLE_INDEX(entity->id);
+    if (slot >= grid->entry_slot_capacity) {
+        int old = grid->entry_slot_capacity;
+        if (!spatial_grow_buffer((void**)&grid->entry_of_slot, &grid->entry_slot_capacity,
+                                 slot + 1, sizeof(int))) {
+            return;
+        }
+        for (int i = old; i < grid->entry_slot_capacity; i++) grid->entry_of_slot[i] = -1;
+    }
+
+    // Find which cells this entity overlaps
+    int start_cx = grid_get_cell_x(grid, min_x);
+    int start_cy = grid_get_cell_y(grid, min_y);
+    int end_cx = grid_get_cell_x(grid, max_x);
+    int end_cy = grid_get_cell_y(grid, max_y);
+
+    int k = grid->entry_of_slot[slot];
+    if (k >= 0 && grid->entries[k].id != entity->id) {
+        // Slot was recycled by a different entity
+        grid_remove_entry(grid, k);
+        k = -1;
+    }
+
+    GridEntry* e;
+    if (k < 0) {
+        // New entry; it's binned into cells by the next build
+        if (!spatial_grow_buffer((void**)&grid->entries, &grid->entry_capacity,
+                                 grid->entry_count + 1, sizeof(GridEntry))) {
+            return;
+        }
+        k = grid->entry_count++;
+        grid->entry_of_slot[slot] = k;
+        e = &grid->entries[k];
+        e->id = entity->id;
+        grid->dirty = 1;
+    } else {
+        e = &grid->entries[k];
+        if (e->min_cx != start_cx || e->min_cy != start_cy || e->max_cx != end_cx || e->max_cy != end_cy) {
+            grid->dirty = 1;
+            grid->moved++;
+        }
+    }
+
+    e->entity = entity;
+    e->seen = grid->frame;
+    e->min_x = min_x;
+    e->min_y = min_y;
+    e->max_x = max_x;
+    e->max_y = max_y;
+    e->layer = entity->collider.layer;
+    e->mask = entity->collider.mask;
+    e->min_cx = start_cx;
+    e->min_cy = start_cy;
+    e->max_cx = end_cx;
+    e->max_cy = end_cy;
+}
+
+static void grid_remove(UniformGrid* grid, Entity* entity) {
+    int slot = (int)ENTITY_HANDLE_INDEX(entity->id);
+    if (slot >= grid->entry_slot_capacity) return;
+
+    int k = grid->entry_of_slot[slot];
+    if (k >= 0 && grid->entries[k].id == entity->id) grid_remove_entry(grid, k);
+}
+
+// Entities whose cells overlap the box (each at most once, never 'self')
+static int grid_query_box(UniformGrid* grid, Entity* self,
+                          float min_x, float min_y, float max_x, float max_y,
+                          Entity** out, int max_out, int* dropped) {
+    grid_prepare(grid);
+
+    // Find which cells to check
+    int start_cx = grid_get_cell_x(grid, min_x);
+    int start_cy = grid_get_cell_y(grid, min_y);
+    int end_cx = grid_get_cell_x(grid, max_x);
+    int end_cy = grid_get_cell_y(grid, max_y);
+
+    // New query stamp: an entry is a duplicate iff it already carries it
+    unsigned int stamp = grid_next_stamp(grid);
+    int count = 0;
+
+    double range_cells = (double)(end_cx - start_cx + 1) * (double)(end_cy - start_cy + 1);
+    if (grid->hashed && range_cells > (double)grid->slot_capacity) {
+        // Huge query vs. a sparse hash: cheaper to walk the occupied cells
+        for (int b = 0; b < grid->slot_capacity; b++) {
+            HashSlot* slot = &grid->slots[b];
+            if (slot->build != grid->hash_build) continue;
+            if (slot->cx < start_cx || slot->cx > end_cx || slot->cy < start_cy || slot->cy > end_cy) continue;
+            grid_query_bucket(grid, b, stamp, self, out, max_out, &count, dropped);
+        }
+    } else {
+        // Collect all entities from overlapped cells
+        for (int cy = start_cy; cy <= end_cy; cy++) {
+            for (int cx = start_cx; cx <= end_cx; cx++) {
+                int b = grid_bucket(grid, cx, cy);
+                if (b < 0) continue;  // Empty hashed cell
+                grid_query_bucket(grid, b, stamp, self, out, max_out, &count, dropped);
+            }
+        }
+    }
+    return count;
+}
+
+// --- BACKEND DISPATCH ---
+// Shared by both layers of an index
+
+static void index_insert(SpatialIndex* index, Entity* entity,
+                         float min_x, float min_y, float max_x, float max_y) {
+    switch (index->type) {
+        case SPATIAL_TYPE_GRID:
+        case SPATIAL_TYPE_HASH:
+            grid_upsert(&index->data.grid, entity, min_x, min_y, max_x, max_y);
+            break;
+        case SPATIAL_TYPE_QUADTREE:
+            quadtree_insert(&index->data.tree, entity, min_x, min_y, max_x, max_y);
+            break;
+        case SPATIAL_TYPE_SAP:
+            sap_insert(&index->data.sap, entity, min_x, min_y, max_x, max_y);
+            break;
+        case SPATIAL_TYPE_BVH:
+            bvh_insert(&index->data.bvh, entity, min_x, min_y, max_x, max_y);
+            break;
+        case SPATIAL_TYPE_HGRID:
+            hgrid_insert(&index->data.hgrid, entity, min_x, min_y, max_x, max_y);
+            break;
+    }
+}
+
+// Whether the entity (this handle, not just its slot) has an entry in this layer
+static int index_contains(SpatialIndex* index, Entity* entity) {
+    int slot = (int)ENTITY_HANDLE_INDEX(entity->id);
+    switch (index->type) {
+        case SPATIAL_TYPE_GRID:
+        case SPATIAL_TYPE_HASH: {
+            UniformGrid* grid = &index->data.grid;
+            if (slot >= grid->entry_slot_capacity || grid->entry_of_slot[slot] < 0) return 0;
+            return grid->entries[grid->entry_of_slot[slot]].id == entity->id;
+        }
+        case SPATIAL_TYPE_QUADTREE: {
+            LooseQuadtree* tree = &index->data.tree;
+            if (slot >= tree->slot_capacity || tree->object_of_slot[slot] < 0) return 0;
+            return tree->objects[tree->object_of_slot[slot]].id == entity->id;
+        }
+        case SPATIAL_TYPE_SAP: {
+            SweepAndPrune* sap = &index->data.sap;
+            if (slot >= sap->slot_capacity || sap->proxy_of_slot[slot] < 0) return 0;
+            SapProxy* p = &sap->proxies[sap->proxy_of_slot[slot]];
+            return p->id == entity->id && !p->dead;
+        }
+        case SPATIAL_TYPE_BVH: {
+            AabbTree* tree = &index->data.bvh;
+            if (slot >= tree->slot_capacity || tree->leaf_of_slot[slot] < 0) return 0;
+            return tree->leaves[tree->leaf_of_slot[slot]].id == entity->id;
+        }
+        case SPATIAL_TYPE_HGRID: {
+            HierarchicalGrid* grid = &index->data.hgrid;
+            if (slot >= grid->entry_slot_capacity || grid->entry_of_slot[slot] < 0) return 0;
+            return grid->entries[grid->entry_of_slot[slot]].id == entity->id;
+        }
+    }
+    return 0;
+}
+
+static void index_remove(SpatialIndex* index, Entity* entity) {
+    switch (index->type) {
+        case SPATIAL_TYPE_GRID:
+        case SPATIAL_TYPE_HASH:
+            grid_remove(&index->data.grid, entity);
+            break;
+        case SPATIAL_TYPE_QUADTREE:
+            quadtree_remove(&index->data.tree, entity);
+            break;
+        case SPATIAL_TYPE_SAP:
+            sap_remove(&index->data.sap, entity);
+            break;
+        case SPATIAL_TYPE_BVH:
+            bvh_remove(&index->data.bvh, entity);
+            break;
+        case SPATIAL_TYPE_HGRID:
+            hgrid_remove(&index->data.hgrid, entity);
+            break;
+    }
+}
+
+static int index_query_box(SpatialIndex* index, Entity* self,
+                           float min_x, float min_y, float max_x, float max_y,
+                           Entity** out, int max_out, int* dropped) {
+    switch (index->type) {
+        case SPATIAL_TYPE_GRID:
+        case SPATIAL_TYPE_HASH:
+            return grid_query_box(&index->data.grid, self, min_x, min_y, max_x, max_y, out, max_out, dropped);
+        case SPATIAL_TYPE_QUADTREE:
+            return quadtree_query(&index->data.tree, self, min_x, min_y, max_x, max_y, out, max_out, dropped);
+        case SPATIAL_TYPE_SAP:
+            return sap_query(&index->data.sap, self, min_x, min_y, max_x, max_y, out, max_out, dropped);
+        case SPATIAL_TYPE_BVH:
+            return bvh_query(&index->data.bvh, self, min_x, min_y, max_x, max_y, out, max_out, dropped);
+        case SPATIAL_TYPE_HGRID:
+            return hgrid_query(&index->data.hgrid, self, min_x, min_y, max_x, max_y, out, max_out, dropped);
+    }
+    return 0;
+}
+
+// Entries of an up-to-date index, by position (used to pair one layer against the other)
+static int index_entry_count(SpatialIndex* index) {
+    switch (index->type) {
+        case SPATIAL_TYPE_GRID:
+        case SPATIAL_TYPE_HASH:     return index->data.grid.entry_count;
+        case SPATIAL_TYPE_QUADTREE: return index->data.tree.object_count;
+        case SPATIAL_TYPE_SAP:      return index->data.sap.proxy_count;
+        case SPATIAL_TYPE_BVH:      return index->data.bvh.leaf_count;
+        case SPATIAL_TYPE_HGRID:    return index->data.hgrid.entry_count;
+    }
+    return 0;
+}
+
+static Entity* index_entry(SpatialIndex* index, int i, float* min_x, float* min_y,
+                           float* max_x, float* max_y, uint32_t* layer, uint32_t* mask) {
+    switch (index->type) {
+        case SPATIAL_TYPE_GRID:
+        case SPATIAL_TYPE_HASH: {
+            GridEntry* e = &index->data.grid.entries[i];
+            *min_x = e->min_x; *min_y = e->min_y; *max_x = e->max_x; *max_y = e->max_y;
+            *layer = e->layer; *mask = e->mask;
+            return e->entity;
+        }
+        case SPATIAL_TYPE_QUADTREE: {
+            QuadObject* o = &index->data.tree.objects[i];
+            *min_x = o->min_x; *min_y = o->min_y; *max_x = o->max_x; *max_y = o->max_y;
+            *layer = o->layer; *mask = o->mask;
+            return o->entity;
+        }
+        case SPATIAL_TYPE_SAP: {
+            SapProxy* p = &index->data.sap.proxies[i];
+            *min_x = p->min_x; *min_y = p->min_y; *max_x = p->max_x; *max_y = p->max_y;
+            *layer = p->layer; *mask = p->mask;
+            return p->entity;
+        }
+        case SPATIAL_TYPE_HGRID: {
+            HGridEntry* e = &index->data.hgrid.entries[i];
+            *min_x = e->min_x; *min_y = e->min_y; *max_x = e->max_x; *max_y = e->max_y;
+            *layer = e->layer; *mask = e->mask;
+            return e->entity;
+        }
+        case SPATIAL_TYPE_BVH:
+        default: {
+            BvhLeaf* l = &index->data.bvh.leaves[i];
+            *min_x = l->min_x; *min_y = l->min_y; *max_x = l->max_x; *max_y = l->max_y;
+            *layer = l->layer; *mask = l->mask;
+            return l->entity;
+        }
+    }
+}
+
+// --- ADAPTIVE CELL SIZE ---
+// With config.tuning.enabled, spatial_clear records how full the cells were in the
+// frame that just ended. Once a window is complete it picks a new size from the
+// averages: occupancy grows with cell area, so the side scales with
+// sqrt(target / occupancy); and an entity of size s spans about (1 + s/cell)^2
+// cells, so the cells-per-entity average gives the typical collider size, which
+// the cells never shrink below (that would make every entity span many cells).
+
+#define TUNE_DEFAULT_WINDOW 120
+#define TUNE_DEFAULT_TARGET 4.0f
+#define TUNE_DEFAULT_TOLERANCE 0.25f
+#define TUNE_MAX_STEP 2.0f          // Largest change per decision (either way)
+#define TUNE_GRID_MAX_CELLS 4194304 // Bounded grid: cell count cap when shrinking
+
+// Move to a new cell size: recompute every entry's cell range, rebuild on the next query
+static int grid_resize(UniformGrid* grid, float cell_size) {
+    if (!grid->hashed) {
+        int cols = (int)ceilf(grid->world_width / cell_size);
+        int rows = (int)ceilf(grid->world_height / cell_size);
+        if (cols < 1) cols = 1;
+        if (rows < 1) rows = 1;
+
+        int* start = calloc((size_t)cols * rows + 1, sizeof(int));
+        if (!start) return 0;  // Keep the old cells
+        free(grid->cell_start);
+        grid->cell_start = start;
+        grid->cols = cols;
+        grid->rows = rows;
+    }
+    grid->cell_size = cell_size;
+
+    for (int i = 0; i < grid->entry_count; i++) {
+        GridEntry* e = &grid->entries[i];
+        e->min_cx = grid_get_cell_x(grid, e->min_x);
+        e->min_cy = grid_get_cell_y(grid, e->min_y);
+        e->max_cx = grid_get_cell_x(grid, e->max_x);
+        e->max_cy = grid_get_cell_y(grid, e->max_y);
+    }
+    grid->dirty = 1;
+    return 1;
+}
+
+// Record the frame that just ended (skipped if nothing queried the cells)
+static void tune_sample(SpatialIndex* index) {
+    UniformGrid* grid = &index->data.grid;
+    if (grid->dirty || grid->sweep_pending || grid->occupied == 0) return;
+
+    index->tune_frames++;
+    index->tune_occupancy += (double)grid->item_count / grid->occupied;
+    index->tune_span += (double)grid->item_count / grid->entry_count;
+    if (grid->max_per_cell > index->tune_max_per_cell) index->tune_max_per_cell = grid->max_per_cell;
+    index->tune_truncated += index->truncated_queries;
+}
+
+// At the end of a window, resize the cells if the averages call for it
+static void tune_decide(SpatialIndex* index) {
+    SpatialTuning* t = &index->config.tuning;
+    UniformGrid* grid = &index->data.grid;
+
+    int window = (t->window > 0) ? t->window : TUNE_DEFAULT_WINDOW;
+    if (index->tune_frames < window) return;
+
+    float target = (t->target_per_cell > 0.0f) ? t->target_per_cell : TUNE_DEFAULT_TARGET;
+    float tolerance = (t->tolerance > 0.0f) ? t->tolerance : TUNE_DEFAULT_TOLERANCE;
+    float occupancy = (float)(index->tune_occupancy / index->tune_frames);
+    float span = (float)(index->tune_span / index->tune_frames);
+    float cell = grid->cell_size;
+
+    float size = cell * sqrtf(target / occupancy);
+
+    // Queries overflowed their buffers: too crowded, whatever the average says
+    if (index->tune_truncated > 0 && size > cell * 0.7071f) size = cell * 0.7071f;
+
+    // Not below the typical collider
+    float collider = cell * (sqrtf(span) - 1.0f);
+    if (size < collider) size = collider;
+
+    if (size > cell * TUNE_MAX_STEP) size = cell * TUNE_MAX_STEP;
+    if (size < cell / TUNE_MAX_STEP) size = cell / TUNE_MAX_STEP;
+    if (t->max_cell_size > 0.0f && size > t->max_cell_size) size = t->max_cell_size;
+    if (t->min_cell_size > 0.0f && size < t->min_cell_size) size = t->min_cell_size;
+    if (!grid->hashed) {
+        float smallest = sqrtf(grid->world_width * grid->world_height / TUNE_GRID_MAX_CELLS);
+        if (size < smallest) size = smallest;
+    }
+
+    int frames = index->tune_frames;
+    int max_per_cell = index->tune_max_per_cell;
+    int truncated = index->tune_truncated;
+    index->tune_frames = 0;
+    index->tune_occupancy = 0.0;
+    index->tune_span = 0.0;
+    index->tune_max_per_cell = 0;
+    index->tune_truncated = 0;
+
+    // Small drifts aren't worth a rebuild (and would make the size jitter)
+    if (fabsf(size - cell) <= cell * tolerance) return;
+    if (!grid_resize(grid, size)) return;
+    index->resizes++;
+
+    if (!t->quiet) {
+        printf("Spatial: Cell size %.0f -> %.0f (over %d frames: %.1f per cell, max %d, "
+               "%.1f cells per entity, %d truncated queries)\n",
+               cell, size, frames, occupancy, max_per_cell, span, truncated);
+    }
+}
+
 // --- PUBLIC API IMPLEMENTATION ---
 
 SpatialIndex* spatial_create(SpatialConfig config) {
+    if ((config.type == SPATIAL_TYPE_GRID || config.type == SPATIAL_TYPE_HASH) &&
+        config.cell_size <= 0.0f) return NULL;
+
     SpatialIndex* index = calloc(1, sizeof(SpatialIndex));
     if (!index) return NULL;
     
     index->type = config.type;
+    index->config = config;
     
     switch (config.type) {
         case SPATIAL_TYPE_GRID: {
@@ -105,21 +795,71 @@ SpatialIndex* spatial_create(SpatialConfig config) {
             grid->cell_size = config.cell_size;
             grid->world_width = config.world_width;
             grid->world_height = config.world_height;
+            grid->frame = 1;
             
             // Calculate grid dimensions
             grid->cols = (int)ceilf(config.world_width / config.cell_size);
             grid->rows = (int)ceilf(config.world_height / config.cell_size);
+            if (grid->cols < 1) grid->cols = 1;
+            if (grid->rows < 1) grid->rows = 1;
             
-            // Allocate cells
+            // Allocate cell offsets (entries/items grow on first insert)
             int total_cells = grid->cols * grid->rows;
-            grid->cells = calloc(total_cells, sizeof(GridCell));
-            if (!grid->cells) {
+            grid->cell_start = calloc((size_t)total_cells + 1, sizeof(int));
+            if (!grid->cell_start) {
+                free(index);
+                return NULL;
+            }
+            break;
+        }
+        
+        case SPATIAL_TYPE_HASH: {
+            UniformGrid* grid = &index->data.grid;
+            
+            grid->hashed = 1;
+            grid->cell_size = config.cell_size;
+            grid->frame = 1;
+            
+            // Table holds 2x the expected occupied cells (power of two for masking)
+            int expected = (config.hash_capacity > 0) ? config.hash_capacity : 1024;
+            int capacity = 64;
+            while (capacity < expected * 2 && capacity < (1 << 30)) capacity *= 2;
+            
+            if (!hash_alloc(grid, capacity)) {
                 free(index);
                 return NULL;
             }
             break;
         }
         
+        case SPATIAL_TYPE_QUADTREE:
+            if (!quadtree_init(&index->data.tree, config)) {
+                free(index);
+                return NULL;
+            }
+            break;
+        
+        case SPATIAL_TYPE_SAP:
+            if (!sap_init(&index->data.sap)) {
+                free(index);
+                return NULL;
+            }
+            break;
+        
+        case SPATIAL_TYPE_BVH:
+            if (!bvh_init(&index->data.bvh, config)) {
+                free(index);
+                return NULL;
+            }
+            break;
+        
+        case SPATIAL_TYPE_HGRID:
+            if (!hgrid_init(&index->data.hgrid, config)) {
+                free(index);
+                return NULL;
+            }
+            break;
+        
         // Future backends would be initialized here
         default:
             free(index);
@@ -134,115 +874,699 @@ void spatial_destroy(SpatialIndex* index) {
     
     switch (index->type) {
         case SPATIAL_TYPE_GRID:
-            free(index->data.grid.cells);
+        case SPATIAL_TYPE_HASH:
+            free(index->data.grid.cell_start);
+            free(index->data.grid.cell_items);
+            free(index->data.grid.entries);
+            free(index->data.grid.entry_stamp);
+            free(index->data.grid.entry_of_slot);
+            free(index->data.grid.slots);
+            break;
+        case SPATIAL_TYPE_QUADTREE:
+            quadtree_free(&index->data.tree);
+            break;
+        case SPATIAL_TYPE_SAP:
+            sap_free(&index->data.sap);
+            break;
+        case SPATIAL_TYPE_BVH:
+            bvh_free(&index->data.bvh);
+            break;
+        case SPATIAL_TYPE_HGRID:
+            hgrid_free(&index->data.hgrid);
             break;
         // Future cleanup here
     }
     
+    spatial_destroy(index->static_layer);
+    free(index->scratch);
     free(index);
 }
 
 void spatial_clear(SpatialIndex* index) {
     if (!index) return;
     
+    // Entries persist; the ones not re-inserted are swept on the next query
     switch (index->type) {
-        case SPATIAL_TYPE_GRID: {
+        case SPATIAL_TYPE_GRID:
+        case SPATIAL_TYPE_HASH: {
             UniformGrid* grid = &index->data.grid;
-            int total_cells = grid->cols * grid->rows;
             
-            // Reset all cell counts (fast - just zero the counts)
-            for (int i = 0; i < total_cells; i++) {
-                grid->cells[i].count = 0;
+            if (index->config.tuning.enabled) {
+                tune_sample(index);
+                tune_decide(index);
+            }
+            
+            grid->frame++;
+            if (grid->frame == 0) {
+                // Wrapped: reset the marks so no stale entry looks current
+                for (int i = 0; i < grid->entry_count; i++) grid->entries[i].seen = 0;
+                grid->frame = 1;
             }
-            grid->total_entities = 0;
+            grid->sweep_pending = 1;
+            grid->moved = 0;
             break;
         }
+        
+        case SPATIAL_TYPE_QUADTREE:
+            quadtree_clear(&index->data.tree);
+            break;
+        
+        case SPATIAL_TYPE_SAP:
+            sap_clear(&index->data.sap);
+            break;
+        
+        case SPATIAL_TYPE_BVH:
+            bvh_clear(&index->data.bvh);
+            break;
+        
+        case SPATIAL_TYPE_HGRID:
+            hgrid_clear(&index->data.hgrid);
+            break;
     }
+    
+    index->truncated_queries = 0;
+    index->dropped_candidates = 0;
+}
+
+void spatial_clear_static(SpatialIndex* index) {
+    if (!index) return;
+    spatial_clear(index->static_layer);
 }
 
 void spatial_insert(SpatialIndex* index, Entity* entity) {
     if (!index || !entity) return;
     if (!entity->active || !entity->collider.active) return;
     
-    switch (index->type) {
-        case SPATIAL_TYPE_GRID: {
-            UniformGrid* grid = &index->data.grid;
-            
-            // Get entity bounds
-            float min_x, min_y, max_x, max_y;
-            get_entity_bounds(entity, &min_x, &min_y, &max_x, &max_y);
-            
-            // Find which cells this entity overlaps
-            int start_cx = grid_get_cell_x(grid, min_x);
-            int start_cy = grid_get_cell_y(grid, min_y);
-            int end_cx = grid_get_cell_x(grid, max_x);
-            int end_cy = grid_get_cell_y(grid, max_y);
-            
-            // Insert into all overlapped cells
-            for (int cy = start_cy; cy <= end_cy; cy++) {
-                for (int cx = start_cx; cx <= end_cx; cx++) {
-                    grid_insert_into_cell(grid, cx, cy, entity);
-                }
-            }
-            
-            grid->total_entities++;
-            break;
-        }
+    // Get entity bounds
+    float min_x, min_y, max_x, max_y;
+    spatial_entity_bounds(entity, &min_x, &min_y, &max_x, &max_y);
+    index_insert(index, entity, min_x, min_y, max_x, max_y);
+}
+
+void spatial_insert_bounds(SpatialIndex* index, Entity* entity,
+                           float min_x, float min_y, float max_x, float max_y) {
+    if (!index || !entity) return;
+    index_insert(index, entity, min_x, min_y, max_x, max_y);
+}
+
+void spatial_update(SpatialIndex* index, Entity* entity) {
+    if (!index || !entity) return;
+    
+    SpatialIndex* layer = index;
+    if (!index_contains(layer, entity)) {
+        layer = index->static_layer;
+        if (!layer || !index_contains(layer, entity)) return;
+    }
+    if (!entity->active || !entity->collider.active) {
+        index_remove(layer, entity);
+        return;
+    }
+    spatial_insert(layer, entity);
+}
+
+void spatial_insert_static(SpatialIndex* index, Entity* entity) {
+    if (!index || !entity) return;
+    if (!entity->active || !entity->collider.active) return;
+    
+    // The static layer is a second index, created on first use
+    if (!index->static_layer) {
+        SpatialConfig config = index->config;
+        if (config.use_static_type) config.type = config.static_type;
+        config.tuning.enabled = 0;  // Statics don't drift
+        index->static_layer = spatial_create(config);
+        if (!index->static_layer) return;
     }
+    spatial_insert(index->static_layer, entity);
+}
+
+void spatial_remove(SpatialIndex* index, Entity* entity) {
+    if (!index || !entity) return;
+    index_remove(index, entity);
+    if (index->static_layer) index_remove(index->static_layer, entity);
 }
 
 int spatial_query(SpatialIndex* index, Entity* entity,
                   Entity** out_candidates, int max_candidates) {
     if (!index || !entity || !out_candidates) return 0;
     
-    int count = 0;
+    // Get entity bounds
+    float min_x, min_y, max_x, max_y;
+    spatial_entity_bounds(entity, &min_x, &min_y, &max_x, &max_y);
     
-    switch (index->type) {
-        case SPATIAL_TYPE_GRID: {
-            UniformGrid* grid = &index->data.grid;
-            
-            // Get entity bounds
+    // Moving entities first, then the static layer
+    int dropped = 0;
+    int count = index_query_box(index, entity, min_x, min_y, max_x, max_y,
+                                out_candidates, max_candidates, &dropped);
+    if (index->static_layer) {
+        count += index_query_box(index->static_layer, entity, min_x, min_y, max_x, max_y,
+                                 out_candidates + count, max_candidates - count, &dropped);
+    }
+    
+    if (dropped > 0) {
+        index->truncated_queries++;
+        index->dropped_candidates += dropped;
+    }
+    
+    return count;
+}
+
+// --- REGION QUERIES ---
+
+// Candidates from one layer into index->scratch (grown until nothing is dropped)
+// A segment query passes its endpoints as (x0, y0, x1, y1) with 'segment' set
+static int index_collect(SpatialIndex* index, SpatialIndex* layer, int segment,
+                         float x0, float y0, float x1, float y1) {
+    float min_x = x0, min_y = y0, max_x = x1, max_y = y1;
+    if (segment) {
+        if (min_x > max_x) { min_x = x1; max_x = x0; }
+        if (min_y > max_y) { min_y = y1; max_y = y0; }
+    }
+
+    for (;;) {
+        int dropped = 0;
+        int count;
+        if (segment && layer->type == SPATIAL_TYPE_BVH) {
+            count = bvh_query_segment(&layer->data.bvh, x0, y0, x1, y1,
+                                      index->scratch, index->scratch_capacity, &dropped);
+        } else {
+            count = index_query_box(layer, NULL, min_x, min_y, max_x, max_y,
+                                    index->scratch, index->scratch_capacity, &dropped);
+        }
+        if (dropped == 0) return count;
+        if (!spatial_grow_buffer((void**)&index->scratch, &index->scratch_capacity,
+                                 count + dropped, sizeof(Entity*))) {
+            return count;  // Out of memory: report what fit
+        }
+    }
+}
+
+// Shared by the box/point/segment queries: backend candidates, then an exact
+// AABB (or segment) test and the layer filter
+static int region_query(SpatialIndex* index, int segment, float x0, float y0, float x1, float y1,
+                        uint32_t mask, Entity** out, int max_out) {
+    SpatialIndex* layers[2] = { index, index->static_layer };
+    int count = 0;
+    int dropped = 0;
+
+    for (int l = 0; l < 2; l++) {
+        if (!layers[l]) continue;
+
+        int n = index_collect(index, layers[l], segment, x0, y0, x1, y1);
+        for (int k = 0; k < n; k++) {
+            Entity* e = index->scratch[k];
+            if (mask != ~0u && !(e->collider.layer & mask)) continue;
+
             float min_x, min_y, max_x, max_y;
-            get_entity_bounds(entity, &min_x, &min_y, &max_x, &max_y);
+            spatial_entity_bounds(e, &min_x, &min_y, &max_x, &max_y);
+            if (segment) {
+                if (!segment_hits_aabb(x0, y0, x1 - x0, y1 - y0, min_x, min_y, max_x, max_y)) continue;
+            } else {
+                if (!aabb_overlap(x0, y0, x1, y1, min_x, min_y, max_x, max_y)) continue;
+            }
+
+            if (count < max_out) {
+                out[count++] = e;
+            } else {
+                dropped++;
+            }
+        }
+    }
+
+    if (dropped > 0) {
+        index->truncated_queries++;
+        index->dropped_candidates += dropped;
+    }
+    return count;
+}
+
+int spatial_query_box(SpatialIndex* index, float min_x, float min_y, float max_x, float max_y,
+                      uint32_t mask, Entity** out, int max_out) {
+    if (!index || !out) return 0;
+    return region_query(index, 0, min_x, min_y, max_x, max_y, mask, out, max_out);
+}
+
+int spatial_query_box_candidates(SpatialIndex* index, float min_x, float min_y, float max_x, float max_y,
+                                 Entity** out, int max_out) {
+    if (!index || !out) return 0;
+
+    SpatialIndex* layers[2] = { index, index->static_layer };
+    int count = 0;
+    int dropped = 0;
+
+    for (int l = 0; l < 2; l++) {
+        if (!layers[l]) continue;
+
+        int n = index_collect(index, layers[l], 0, min_x, min_y, max_x, max_y);
+        for (int k = 0; k < n; k++) {
+            if (count < max_out) {
+                out[count++] = index->scratch[k];
+            } else {
+                dropped++;
+            }
+        }
+    }
+
+    if (dropped > 0) {
+        index->truncated_queries++;
+        index->dropped_candidates += dropped;
+    }
+    return count;
+}
+
+int spatial_query_point(SpatialIndex* index, float x, float y,
+                        uint32_t mask, Entity** out, int max_out) {
+    if (!index || !out) return 0;
+    return region_query(index, 0, x, y, x, y, mask, out, max_out);
+}
+
+int spatial_query_segment(SpatialIndex* index, float x0, float y0, float x1, float y1,
+                          uint32_t mask, Entity** out, int max_out) {
+    if (!index || !out) return 0;
+    return region_query(index, 1, x0, y0, x1, y1, mask, out, max_out);
+}
+
+// --- RAY AND SHAPE CASTS ---
+// A circle cast against a circle is a ray against the circle grown by the radius;
+// against a rect it is a ray against the rect grown into a rounded box. A ray is
+// the radius 0 case of both
+
+typedef struct {
+    float x0, y0;       // Start
+    float dx, dy;       // End - start
+    float radius;       // 0 = ray
+    uint32_t mask;
+    SpatialHit best;    // Closest hit so far (fraction > 1 until something is hit)
+} SpatialCast;
+
+// First t in [0, 1] at which (mx, my) + t * (dx, dy) reaches distance r of the origin
+// (m is the start relative to the circle's center). Starting inside is no hit
+static int cast_circle(float mx, float my, float dx, float dy, float r, float* out_t) {
+    float c = mx * mx + my * my - r * r;
+    float b = mx * dx + my * dy;
+    if (c < 0.0f || b >= 0.0f) return 0;  // Starts inside, or not heading closer
+
+    float a = dx * dx + dy * dy;
+    float disc = b * b - a * c;
+    if (disc < 0.0f) return 0;
+
+    float t = (-b - sqrtf(disc)) / a;
+    if (t > 1.0f) return 0;
+    *out_t = t;
+    return 1;
+}
+
+// Exact test of one entity's collider; keeps the hit if it is the closest so far
+static void cast_entity(SpatialCast* cast, Entity* e) {
+    float cx = e->x + e->collider.offset_x;
+    float cy = e->y + e->collider.offset_y;
+    float dx = cast->dx, dy = cast->dy;
+    float radius = cast->radius;
+    float t, nx, ny, px, py;
+
+    if (e->collider.type == SHAPE_CIRCLE) {
+        float r = e->collider.circle.radius + radius;
+        float mx = cast->x0 - cx, my = cast->y0 - cy;
+        if (r <= 0.0f || !cast_circle(mx, my, dx, dy, r, &t)) return;
+        if (t >= cast->best.fraction) return;
+
+        nx = (mx + t * dx) / r;
+        ny = (my + t * dy) / r;
+        px = cx + nx * e->collider.circle.radius;
+        py = cy + ny * e->collider.circle.radius;
+    } else {
+        float hw = e->collider.rect.width / 2.0f;
+        float hh = e->collider.rect.height / 2.0f;
+
+        // Start inside the (rounded) box: skipped
+        float qx = fabsf(cast->x0 - cx) - hw;
+        float qy = fabsf(cast->y0 - cy) - hh;
+        if (qx < 0.0f) qx = 0.0f;
+        if (qy < 0.0f) qy = 0.0f;
+        if (qx == 0.0f && qy == 0.0f) return;
+        if (qx * qx + qy * qy < radius * radius) return;
+
+        // Slab test against the box grown by the radius
+        float ex = hw + radius, ey = hh + radius;
+        float tx = -INFINITY, ty = -INFINITY;
+        float t_exit = 1.0f;
+        if (dx != 0.0f) {
+            float inv = 1.0f / dx;
+            float t1 = (cx - ex - cast->x0) * inv, t2 = (cx + ex - cast->x0) * inv;
+            if (t1 > t2) { float s = t1; t1 = t2; t2 = s; }
+            tx = t1;
+            if (t2 < t_exit) t_exit = t2;
+        } else if (fabsf(cast->x0 - cx) >= ex) {
+            return;
+        }
+        if (dy != 0.0f) {
+            float inv = 1.0f / dy;
+            float t1 = (cy - ey - cast->y0) * inv, t2 = (cy + ey - cast->y0) * inv;
+            if (t1 > t2) { float s = t1; t1 = t2; t2 = s; }
+            ty = t1;
+            if (t2 < t_exit) t_exit = t2;
+        } else if (fabsf(cast->y0 - cy) >= ey) {
+            return;
+        }
+
+        t = tx > ty ? tx : ty;
+        if (t < 0.0f) t = 0.0f;
+        if (t > t_exit || t >= cast->best.fraction) return;
+
+        if (tx > ty) { nx = dx > 0.0f ? -1.0f : 1.0f; ny = 0.0f; }
+        else         { nx = 0.0f; ny = dy > 0.0f ? -1.0f : 1.0f; }
+        float hx = cast->x0 + t * dx, hy = cast->y0 + t * dy;  // Cast center at the hit
+        px = hx - nx * radius;
+        py = hy - ny * radius;
+
+        // Entering the grown box beside a corner: the rounded corner decides
+        if (radius > 0.0f && fabsf(hx - cx) > hw && fabsf(hy - cy) > hh) {
+            float kx = hx > cx ? cx + hw : cx - hw;
+            float ky = hy > cy ? cy + hh : cy - hh;
+            float mx = cast->x0 - kx, my = cast->y0 - ky;
+            if (!cast_circle(mx, my, dx, dy, radius, &t)) return;
+            if (t >= cast->best.fraction) return;
+            nx = (mx + t * dx) / radius;
+            ny = (my + t * dy) / radius;
+            px = kx;
+            py = ky;
+        }
+    }
+
+    cast->best.entity = e;
+    cast->best.x = px;
+    cast->best.y = py;
+    cast->best.normal_x = nx;
+    cast->best.normal_y = ny;
+    cast->best.fraction = t;
+}
+
+// Test the not-yet-seen entries of one bucket
+static void grid_cast_bucket(UniformGrid* grid, int bucket, unsigned int stamp, SpatialCast* cast) {
+    int end = grid->cell_start[bucket + 1];
+
+    for (int i = grid->cell_start[bucket]; i < end; i++) {
+        int k = grid->cell_items[i];
+        if (grid->entry_stamp[k] == stamp) continue;
+        grid->entry_stamp[k] = stamp;
+
+        GridEntry* entry = &grid->entries[k];
+        if (cast->mask != ~0u && !(entry->layer & cast->mask)) continue;
+        cast_entity(cast, entry->entity);
+    }
+}
+
+// Walk the cells along the path (DDA), in order, testing the entries within the cast
+// radius of each; stop once the closest hit lies before the cell being left.
+// Returns 0 (nothing done) when the path crosses more cells than are worth walking
+static int grid_cast(UniformGrid* grid, SpatialCast* cast) {
+    grid_prepare(grid);
+
+    float cs = grid->cell_size;
+    float x1 = cast->x0 + cast->dx, y1 = cast->y0 + cast->dy;
+    float fx0 = floorf(cast->x0 / cs), fy0 = floorf(cast->y0 / cs);
+    float fx1 = floorf(x1 / cs), fy1 = floorf(y1 / cs);
+    if (!(fabsf(fx0) < HASH_CELL_LIMIT && fabsf(fy0) < HASH_CELL_LIMIT &&
+          fabsf(fx1) < HASH_CELL_LIMIT && fabsf(fy1) < HASH_CELL_LIMIT)) {
+        return 0;  // Way out of range (or NaN)
+    }
+
+    // Far outside a bounded grid every cell clamps to the border: walking that is
+    // no better than scanning the box, as is a path longer than the occupied hash
+    double steps = fabs((double)fx1 - fx0) + fabs((double)fy1 - fy0);
+    double limit = grid->hashed ? (double)grid->slot_capacity : (double)(grid->cols + grid->rows);
+    if (steps > limit) return 0;
+
+    int cx = (int)fx0, cy = (int)fy0;
+    int end_cx = (int)fx1, end_cy = (int)fy1;
+    int step_x = cast->dx > 0.0f ? 1 : -1;
+    int step_y = cast->dy > 0.0f ? 1 : -1;
+
+    // t at which the path crosses the next column / row boundary, and per cell after that
+    float next_x = INFINITY, next_y = INFINITY;
+    float delta_x = INFINITY, delta_y = INFINITY;
+    if (cast->dx != 0.0f) {
+        next_x = (((float)cx + (step_x > 0)) * cs - cast->x0) / cast->dx;
+        delta_x = cs / fabsf(cast->dx);
+    }
+    if (cast->dy != 0.0f) {
+        next_y = (((float)cy + (step_y > 0)) * cs - cast->y0) / cast->dy;
+        delta_y = cs / fabsf(cast->dy);
+    }
+
+    // Cells around the path's cell that the swept circle can reach
+    int reach = cast->radius > 0.0f ? (int)ceilf(cast->radius / cs) : 0;
+    unsigned int stamp = grid_next_stamp(grid);
+    int prev_min_x = 1, prev_max_x = 0, prev_min_y = 0, prev_max_y = 0;  // Empty
+
+    for (;;) {
+        int min_x = cx - reach, max_x = cx + reach;
+        int min_y = cy - reach, max_y = cy + reach;
+        if (!grid->hashed) {
+            if (min_x < 0) min_x = 0;
+            if (min_y < 0) min_y = 0;
+            if (max_x >= grid->cols) max_x = grid->cols - 1;
+            if (max_y >= grid->rows) max_y = grid->rows - 1;
+            if (min_x > max_x) min_x = max_x = (cx < 0 ? 0 : grid->cols - 1);
+            if (min_y > max_y) min_y = max_y = (cy < 0 ? 0 : grid->rows - 1);
+        }
+
+        // Only the cells the previous block didn't cover
+        for (int y = min_y; y <= max_y; y++) {
+            for (int x = min_x; x <= max_x; x++) {
+                if (x >= prev_min_x && x <= prev_max_x && y >= prev_min_y && y <= prev_max_y) continue;
+                int b = grid_bucket(grid, x, y);
+                if (b < 0) continue;  // Empty hashed cell
+                grid_cast_bucket(grid, b, stamp, cast);
+            }
+        }
+        prev_min_x = min_x; prev_max_x = max_x;
+        prev_min_y = min_y; prev_max_y = max_y;
+
+        float t_leave = next_x < next_y ? next_x : next_y;
+        if (cx == end_cx && cy == end_cy) break;
+        if (cast->best.fraction <= t_leave) break;  // Nothing further on can be closer
+
+        // Step across the nearer boundary (never past the end cell on either axis)
+        if (cy == end_cy || (cx != end_cx && next_x < next_y)) {
+            cx += step_x;
+            next_x += delta_x;
+        } else {
+            cy += step_y;
+            next_y += delta_y;
+        }
+    }
+    return 1;
+}
+
+// Any backend: exact tests on every candidate near the path
+static void layer_cast(SpatialIndex* index, SpatialIndex* layer, SpatialCast* cast) {
+    if ((layer->type == SPATIAL_TYPE_GRID || layer->type == SPATIAL_TYPE_HASH) &&
+        grid_cast(&layer->data.grid, cast)) {
+        return;
+    }
+
+    float x1 = cast->x0 + cast->dx, y1 = cast->y0 + cast->dy;
+    int n;
+    if (cast->radius == 0.0f) {
+        n = index_collect(index, layer, 1, cast->x0, cast->y0, x1, y1);
+    } else {
+        float r = cast->radius;
+        n = index_collect(index, layer, 0,
+                          fminf(cast->x0, x1) - r, fminf(cast->y0, y1) - r,
+                          fmaxf(cast->x0, x1) + r, fmaxf(cast->y0, y1) + r);
+    }
+
+    for (int k = 0; k < n; k++) {
+        Entity* e = index->scratch[k];
+        if (cast->mask != ~0u && !(e->collider.layer & cast->mask)) continue;
+        cast_entity(cast, e);
+    }
+}
+
+static int index_cast(SpatialIndex* index, float x0, float y0, float x1, float y1, float radius,
+                      uint32_t mask, SpatialHit* out) {
+    SpatialCast cast;
+    cast.x0 = x0;
+    cast.y0 = y0;
+    cast.dx = x1 - x0;
+    cast.dy = y1 - y0;
+    cast.radius = radius > 0.0f ? radius : 0.0f;
+    cast.mask = mask;
+    cast.best.entity = NULL;
+    cast.best.fraction = 2.0f;
+
+    // Zero length: nothing to sweep (and the start can't be inside what it hits)
+    if (cast.dx != 0.0f || cast.dy != 0.0f) {
+        // Static layer first: level geometry tends to block early, which cuts the walk
+        if (index->static_layer) layer_cast(index, index->static_layer, &cast);
+        layer_cast(index, index, &cast);
+    }
+
+    if (!cast.best.entity) {
+        cast.best.x = x1;
+        cast.best.y = y1;
+        cast.best.normal_x = 0.0f;
+        cast.best.normal_y = 0.0f;
+        cast.best.fraction = 1.0f;
+    }
+    *out = cast.best;
+    return cast.best.entity != NULL;
+}
+
+int spatial_raycast(SpatialIndex* index, float x0, float y0, float x1, float y1,
+                    uint32_t mask, SpatialHit* out) {
+    if (!index || !out) return 0;
+    return index_cast(index, x0, y0, x1, y1, 0.0f, mask, out);
+}
+
+int spatial_shapecast(SpatialIndex* index, float x0, float y0, float x1, float y1, float radius,
+                      uint32_t mask, SpatialHit* out) {
+    if (!index || !out) return 0;
+    return index_cast(index, x0, y0, x1, y1, radius, mask, out);
+}
+
+int spatial_raycast_batch(SpatialIndex* index, const SpatialRay* rays, int count,
+                          uint32_t mask, SpatialHit* out) {
+    if (!index || !rays || !out) return 0;
+
+    int hits = 0;
+    for (int i = 0; i < count; i++) {
+        hits += index_cast(index, rays[i].x0, rays[i].y0, rays[i].x1, rays[i].y1, 0.0f, mask, &out[i]);
+    }
+    return hits;
+}
+
+// --- PAIR GENERATION ---
+
+int spatial_pair_push(SpatialPairList* out, Entity* a, Entity* b) {
+    if (out->count >= out->capacity &&
+        !spatial_grow_buffer((void**)&out->pairs, &out->capacity, out->count + 1, sizeof(SpatialPair))) {
+        return 0;
+    }
+    out->pairs[out->count].a = a;
+    out->pairs[out->count].b = b;
+    out->count++;
+    return 1;
+}
+
+// Pair up the entries of one cell. Two entities that share several cells are
+// only reported by the first shared cell (the min corner of the overlap of their
+// cell ranges), so no de-duplication pass is needed.
+// Returns 0 if the pair buffer could not grow
+static int grid_pair_bucket(UniformGrid* grid, int bucket, int cx, int cy, SpatialPairList* out) {
+    int begin = grid->cell_start[bucket];
+    int end = grid->cell_start[bucket + 1];
+
+    for (int i = begin; i < end; i++) {
+        GridEntry* a = &grid->entries[grid->cell_items[i]];
+
+        for (int j = i + 1; j < end; j++) {
+            GridEntry* b = &grid->entries[grid->cell_items[j]];
+
+            // Owner cell check
+            int owner_cx = (a->min_cx > b->min_cx) ? a->min_cx : b->min_cx;
+            int owner_cy = (a->min_cy > b->min_cy) ? a->min_cy : b->min_cy;
+            if (owner_cx != cx || owner_cy != cy) continue;
+
+            if (!layers_interact(a->layer, a->mask, b->layer, b->mask)) continue;
+            if (!aabb_overlap(a->min_x, a->min_y, a->max_x, a->max_y,
+                              b->min_x, b->min_y, b->max_x, b->max_y)) continue;
+
+            if (!spatial_pair_push(out, a->entity, b->entity)) return 0;
+        }
+    }
+    return 1;
+}
+
+// Walk each cell once and pair up its entries
+static void grid_find_pairs(UniformGrid* grid, SpatialPairList* out) {
+    if (grid->hashed) {
+        // Only occupied cells exist; table order is deterministic for the same inserts
+        for (int b = 0; b < grid->slot_capacity; b++) {
+            HashSlot* slot = &grid->slots[b];
+            if (slot->build != grid->hash_build) continue;
+            if (!grid_pair_bucket(grid, b, slot->cx, slot->cy, out)) return;
+        }
+        return;
+    }
+
+    for (int cy = 0; cy < grid->rows; cy++) {
+        for (int cx = 0; cx < grid->cols; cx++) {
+            if (!grid_pair_bucket(grid, grid_cell_index(grid, cx, cy), cx, cy, out)) return;
+        }
+    }
+}
+
+// Pairs of a moving entity with the static layer (static/static pairs are never reported)
+static int static_layer_pairs(SpatialIndex* index, SpatialPairList* out) {
+    SpatialIndex* statics = index->static_layer;
+    
+    int n = index_entry_count(index);
+    for (int i = 0; i < n; i++) {
+        float min_x, min_y, max_x, max_y;
+        uint32_t layer, mask;
+        Entity* a = index_entry(index, i, &min_x, &min_y, &max_x, &max_y, &layer, &mask);
+        
+        // Candidates overlap a cell/node of 'a' (a static entity is never 'a' itself)
+        int count = index_collect(index, statics, 0, min_x, min_y, max_x, max_y);
+        
+        for (int k = 0; k < count; k++) {
+            Entity* b = index->scratch[k];
+            if (b == a) continue;  // Inserted in both layers
+            if (!layers_interact(layer, mask, b->collider.layer, b->collider.mask)) continue;
             
-            // Find which cells to check
-            int start_cx = grid_get_cell_x(grid, min_x);
-            int start_cy = grid_get_cell_y(grid, min_y);
-            int end_cx = grid_get_cell_x(grid, max_x);
-            int end_cy = grid_get_cell_y(grid, max_y);
+            float b_min_x, b_min_y, b_max_x, b_max_y;
+            spatial_entity_bounds(b, &b_min_x, &b_min_y, &b_max_x, &b_max_y);
+            if (!aabb_overlap(min_x, min_y, max_x, max_y, b_min_x, b_min_y, b_max_x, b_max_y)) continue;
             
-            // Collect all entities from overlapped cells
-            for (int cy = start_cy; cy <= end_cy && count < max_candidates; cy++) {
-                for (int cx = start_cx; cx <= end_cx && count < max_candidates; cx++) {
-                    int idx = grid_cell_index(grid, cx, cy);
-                    GridCell* cell = &grid->cells[idx];
-                    
-                    for (int i = 0; i < cell->count && count < max_candidates; i++) {
-                        Entity* candidate = cell->entities[i];
-                        
-                        // Skip self
-                        if (candidate == entity) continue;
-                        
-                        // Check if already in output (avoid duplicates from multi-cell entities)
-                        int duplicate = 0;
-                        for (int j = 0; j < count; j++) {
-                            if (out_candidates[j] == candidate) {
-                                duplicate = 1;
-                                break;
-                            }
-                        }
-                        
-                        if (!duplicate) {
-                            out_candidates[count++] = candidate;
-                        }
-                    }
-                }
-            }
+            if (!spatial_pair_push(out, a, b)) return 0;
+        }
+    }
+    return 1;
+}
+
+int spatial_find_pairs(SpatialIndex* index, SpatialPairList* out) {
+    if (!out) return 0;
+    out->count = 0;
+    if (!index) return 0;
+
+    switch (index->type) {
+        case SPATIAL_TYPE_GRID:
+        case SPATIAL_TYPE_HASH: {
+            UniformGrid* grid = &index->data.grid;
+            grid_prepare(grid);
+            grid_find_pairs(grid, out);
             break;
         }
+        
+        case SPATIAL_TYPE_QUADTREE:
+            quadtree_find_pairs(&index->data.tree, out);
+            break;
+        
+        case SPATIAL_TYPE_SAP:
+            sap_find_pairs(&index->data.sap, out);
+            break;
+        
+        case SPATIAL_TYPE_BVH:
+            bvh_find_pairs(&index->data.bvh, out);
+            break;
+        
+        case SPATIAL_TYPE_HGRID:
+            hgrid_find_pairs(&index->data.hgrid, out);
+            break;
     }
     
-    return count;
+    if (index->static_layer) static_layer_pairs(index, out);
+
+    return out->count;
+}
+
+void spatial_pair_list_free(SpatialPairList* list) {
+    if (!list) return;
+    free(list->pairs);
+    list->pairs = NULL;
+    list->count = 0;
+    list->capacity = 0;
 }
 
 SpatialStats spatial_get_stats(SpatialIndex* index) {
@@ -250,29 +1574,47 @@ SpatialStats spatial_get_stats(SpatialIndex* index) {
     if (!index) return stats;
     
     switch (index->type) {
-        case SPATIAL_TYPE_GRID: {
+        case SPATIAL_TYPE_GRID:
+        case SPATIAL_TYPE_HASH: {
             UniformGrid* grid = &index->data.grid;
+            grid_prepare(grid);
             
-            stats.total_cells = grid->cols * grid->rows;
-            stats.total_entities = grid->total_entities;
-            
-            int total_in_occupied = 0;
-            for (int i = 0; i < stats.total_cells; i++) {
-                int c = grid->cells[i].count;
-                if (c > 0) {
-                    stats.occupied_cells++;
-                    total_in_occupied += c;
-                    if (c > stats.max_per_cell) {
-                        stats.max_per_cell = c;
-                    }
-                }
-            }
+            stats.total_cells = grid_bucket_count(grid);  // Hash: table slots
+            stats.total_entities = grid->entry_count;
+            stats.moved_entities = grid->moved;
+            stats.cell_size = grid->cell_size;
             
-            if (stats.occupied_cells > 0) {
-                stats.avg_per_cell = (float)total_in_occupied / (float)stats.occupied_cells;
+            // Occupancy is counted by the build
+            stats.occupied_cells = grid->occupied;
+            stats.max_per_cell = grid->max_per_cell;
+            if (grid->occupied > 0) {
+                stats.avg_per_cell = (float)grid->item_count / (float)grid->occupied;
             }
             break;
         }
+        
+        case SPATIAL_TYPE_QUADTREE:
+            quadtree_stats(&index->data.tree, &stats);  // Cells = tree nodes
+            break;
+        
+        case SPATIAL_TYPE_SAP:
+            sap_stats(&index->data.sap, &stats);  // No cells
+            break;
+        
+        case SPATIAL_TYPE_BVH:
+            bvh_stats(&index->data.bvh, &stats);  // Cells = tree nodes
+            break;
+        
+        case SPATIAL_TYPE_HGRID:
+            hgrid_stats(&index->data.hgrid, &stats);  // Cells = cells of every level
+            break;
+    }
+    
+    stats.truncated_queries = index->truncated_queries;
+    stats.dropped_candidates = index->dropped_candidates;
+    stats.resizes = index->resizes;
+    if (index->static_layer) {
+        stats.static_entities = spatial_get_stats(index->static_layer).total_entities;
     }
     
     return stats;
@@ -1,18 +1,14 @@
 // spatial.h — Spatial partitioning for broad-phase collision detection
 // 
 // This module provides an abstract interface for spatial acceleration structures.
-// Currently implements: Uniform Grid
-// Future options: Spatial Hash, Quadtree, etc.
+// Currently implements: Uniform Grid, Spatial Hash, Loose Quadtree, Sweep and Prune,
+// Dynamic AABB Tree, Hierarchical Grid
 //
 #ifndef SPATIAL_H
 #define SPATIAL_H
 
 #include "engine.h"
 
-// Maximum entities that can be in a single cell
-// If exceeded, collisions may be missed (increase if needed)
-#define SPATIAL_MAX_PER_CELL 64
-
 // Opaque spatial index handle
 typedef struct SpatialIndex SpatialIndex;
 
@@ -20,19 +16,54 @@ typedef struct SpatialIndex SpatialIndex;
 
 typedef enum {
     SPATIAL_TYPE_GRID,      // Uniform grid (fixed bounds, fast)
-    // SPATIAL_TYPE_HASH,   // Spatial hash (infinite bounds, future)
-    // SPATIAL_TYPE_QUADTREE // Quadtree (varying sizes, future)
+    SPATIAL_TYPE_HASH,      // Spatial hash (infinite bounds, memory ~ occupied cells)
+    SPATIAL_TYPE_QUADTREE,  // Loose quadtree (mixed collider sizes, entries persist across frames)
+    SPATIAL_TYPE_SAP,       // Sweep and prune (sorted endpoints persist; best when most bodies move slowly)
+    SPATIAL_TYPE_BVH,       // Dynamic AABB tree (no bounds or cell size; best for segment/ray queries over static geometry)
+    SPATIAL_TYPE_HGRID,     // Hierarchical grid (unbounded; one cell per entity on the level matching its size)
 } SpatialType;
 
+// Adaptive cell size (GRID/HASH): spatial_clear samples the cell occupancy every frame,
+// and at the end of each window rebuilds the cells at a better size if the density
+// drifted (crowded cells shrink, sparse ones grow, never below the typical collider).
+// Each change is printed. Only the moving layer is tuned
+typedef struct {
+    int enabled;            // 0 = cell_size never changes
+    int window;             // Frames averaged per decision (0 = 120)
+    float target_per_cell;  // Entities per occupied cell to aim for (0 = 4)
+    float tolerance;        // Ignore changes smaller than this fraction of the size (0 = 0.25)
+    float min_cell_size;    // Limits for the chosen size (0 = none)
+    float max_cell_size;
+    int quiet;              // Don't print the decisions
+} SpatialTuning;
+
 typedef struct {
     SpatialType type;
     
     // Grid-specific settings
     float world_width;      // Total world width
     float world_height;     // Total world height
-    float cell_size;        // Size of each cell (should be >= largest entity)
+    float cell_size;        // Size of each cell (should be >= largest entity) - also used by HASH
+    
+    // Hash-specific settings
+    int hash_capacity;      // Expected occupied cells (0 = 1024); the table grows if exceeded
+    
+    // Quadtree-specific settings (root covers world_width x world_height; cell_size unused)
+    int quadtree_depth;     // Deepest level (0 = 8); leaf cells are root / 2^depth
+    
+    // Hierarchical grid: cell_size is the smallest level's cell (0 = 1), doubling per
+    // level; each collider picks its level, so any small value works
     
-    // Future: hash table size, quadtree depth, etc.
+    // AABB tree-specific settings
+    float bvh_margin;       // Fattening around each collider (0 = 8); bigger = fewer tree updates, looser culling
+    
+    // GRID/HASH: adjust cell_size to the actual density (off by default)
+    SpatialTuning tuning;
+    
+    // Backend of the static layer (see spatial_insert_static): static_type if
+    // use_static_type is set, else the same type as 'type'. The rest of the config is shared
+    int use_static_type;
+    SpatialType static_type;
 } SpatialConfig;
 
 // --- CORE API ---
@@ -44,28 +75,156 @@ SpatialIndex* spatial_create(SpatialConfig config);
 // Destroy a spatial index and free memory
 void spatial_destroy(SpatialIndex* index);
 
-// Clear all entities from the index (call at start of each physics frame)
+// Start a new frame (call at start of each physics frame)
+// Every backend keeps its entries: the ones re-inserted before the next query are
+// updated in place (GRID/HASH: cells rebuilt only if an entry changed cell range,
+// QUADTREE: relinked only if it left its node), the rest are dropped then.
+// Only touches moving entities; see spatial_clear_static
 void spatial_clear(SpatialIndex* index);
 
-// Insert an entity into the spatial index
+// Insert an entity into the spatial index, or update it if it is already there
+// (entries are keyed by entity handle, so a recycled slot replaces the old entity)
 // The entity's position and collider size determine which cell(s) it occupies
+// Inserts are batched; the index is (re)built on the next query, and cells
+// have no capacity limit
 void spatial_insert(SpatialIndex* index, Entity* entity);
 
-// Query for entities that might collide with the given entity
-// Returns the number of candidates found
-// Candidates are written to the 'out_candidates' array (up to max_candidates)
-// NOTE: This may include the entity itself - caller should filter it out
+// Same as spatial_insert, but with a precomputed collider AABB
+// (lets the physics step bin bodies straight from its packed arrays)
+void spatial_insert_bounds(SpatialIndex* index, Entity* entity,
+                           float min_x, float min_y, float max_x, float max_y);
+
+// Refresh an entity that is already in the index (either layer) from its current
+// position, collider, layer and mask. Only an entry that left its cells (QUADTREE:
+// its node, BVH: its fat AABB) is relinked. Does nothing for entities the index
+// doesn't hold, and removes ones that are no longer active or have no collider
+void spatial_update(SpatialIndex* index, Entity* entity);
+
+// Remove an entity right away (from either layer), e.g. before destroying it
+void spatial_remove(SpatialIndex* index, Entity* entity);
+
+// --- STATIC LAYER ---
+// Entities that never move (walls, level geometry) go in a second index of type
+// config.static_type. It is only rebuilt when its own contents change, queries include
+// it, and spatial_find_pairs pairs it against moving entities only. Its entries stay
+// until removed (spatial_remove) or the layer is cleared, so static entities don't
+// need re-inserting every frame.
+
+// Insert or update a static entity
+void spatial_insert_static(SpatialIndex* index, Entity* entity);
+
+// Start a new frame for the static layer (same rules as spatial_clear): the statics
+// not re-inserted before the next query are dropped. Only needed by callers that
+// rebuild the layer from scratch instead of removing statics as they go
+void spatial_clear_static(SpatialIndex* index);
+
+// Query for entities that might collide with the given entity (both layers)
+// Returns the number of candidates found (each entity at most once, never the entity itself)
+// Candidates are written to the 'out_candidates' array (up to max_candidates);
+// queries that had more are counted in SpatialStats.truncated_queries
 int spatial_query(SpatialIndex* index, Entity* entity, 
                   Entity** out_candidates, int max_candidates);
 
+// --- REGION QUERIES ---
+// Entities from both layers whose collider AABB overlaps the box / contains the
+// point / is touched by the segment, keeping only colliders whose layer is in
+// 'mask' (~0u = everything, layer 0 included). Each entity is reported at most once; returns the
+// count written to 'out' (extra hits are counted in SpatialStats.truncated_queries)
+// These are broad-phase results: shapes are not tested, only their AABBs
+
+int spatial_query_box(SpatialIndex* index, float min_x, float min_y, float max_x, float max_y,
+                      uint32_t mask, Entity** out, int max_out);
+
+int spatial_query_point(SpatialIndex* index, float x, float y,
+                        uint32_t mask, Entity** out, int max_out);
+
+// BVH walks the tree along the segment; other backends scan its bounding box
+int spatial_query_segment(SpatialIndex* index, float x0, float y0, float x1, float y1,
+                          uint32_t mask, Entity** out, int max_out);
+
+// Everything in the cells/nodes the box overlaps (both layers), without the exact
+// test: for callers that know newer positions than the entities' (physics_update
+// mid-step) and test the candidates themselves
+int spatial_query_box_candidates(SpatialIndex* index, float min_x, float min_y, float max_x, float max_y,
+                                 Entity** out, int max_out);
+
+// --- RAY AND SHAPE CASTS ---
+// First collider (either layer, filtered by 'mask' like the region queries) hit along
+// (x0, y0) -> (x1, y1), tested against the actual circle/rect, not just its AABB.
+// Colliders the cast starts inside of are skipped, so a cast from an entity's own
+// center doesn't hit that entity. GRID/HASH walk the cells along the path and stop
+// at the first cell that can't hold anything closer; other backends test every
+// candidate of the path's bounding box (BVH: the segment, for rays).
+// Candidates come from the AABBs stored at insert time, while the shape test reads
+// the entity's current position: an entity moved since it was inserted can be missed
+
+typedef struct {
+    Entity* entity;             // NULL = nothing hit (the rest is then the end of the cast)
+    float x, y;                 // Contact point, on the surface of the entity hit
+    float normal_x, normal_y;   // Unit surface normal there (facing the cast)
+    float fraction;             // Hit at start + fraction * (end - start), 0..1
+} SpatialHit;
+
+typedef struct {
+    float x0, y0;
+    float x1, y1;
+} SpatialRay;
+
+// Returns 1 on a hit (out is always filled)
+int spatial_raycast(SpatialIndex* index, float x0, float y0, float x1, float y1,
+                    uint32_t mask, SpatialHit* out);
+
+// Sweep a circle of 'radius' along the path: the fraction is where its center is on
+// first touch, and the contact point is where it touches
+int spatial_shapecast(SpatialIndex* index, float x0, float y0, float x1, float y1, float radius,
+                      uint32_t mask, SpatialHit* out);
+
+// spatial_raycast for each ray (e.g. a frame's AI line-of-sight checks), into out[i]
+// for rays[i]. Returns how many rays hit something
+// A convenience only: the rays are cast one after another, with nothing shared
+// between them, so it costs the same as calling spatial_raycast in a loop
+int spatial_raycast_batch(SpatialIndex* index, const SpatialRay* rays, int count,
+                          uint32_t mask, SpatialHit* out);
+
+// --- PAIR GENERATION ---
+
+// Candidate pair whose AABBs overlap and whose layers/masks allow a collision
+typedef struct {
+    Entity* a;
+    Entity* b;
+} SpatialPair;
+
+// Reusable pair buffer: keep one around and pass it every frame
+// (it only allocates when a frame produces more pairs than ever before)
+typedef struct {
+    SpatialPair* pairs;
+    int count;
+    int capacity;
+} SpatialPairList;
+
+// Find every unique candidate pair in the index (replaces one query per entity)
+// Each pair is reported once, in a deterministic order: moving/moving pairs, then
+// moving/static pairs (static entity in 'b'). Static/static pairs are never reported.
+// Returns out->count
+int spatial_find_pairs(SpatialIndex* index, SpatialPairList* out);
+
+// Free a pair buffer's memory
+void spatial_pair_list_free(SpatialPairList* list);
+
 // --- STATS (for debugging/profiling) ---
 
 typedef struct {
     int total_cells;        // Number of cells in the structure
     int occupied_cells;     // Cells with at least one entity
     int total_entities;     // Total entities inserted
+    int moved_entities;     // Since the last clear - GRID/HASH: changed cells, QUADTREE: changed node, SAP: changed bounds
+    int static_entities;    // Entities in the static layer (not counted in total_entities)
     int max_per_cell;       // Most entities in any single cell
     float avg_per_cell;     // Average entities per occupied cell
+    int truncated_queries;  // Queries that hit max_candidates since the last clear
+    int dropped_candidates; // Candidates those queries could not return
+    float cell_size;        // GRID/HASH: current cell size (changes under config.tuning)
+    int resizes;            // GRID/HASH: cell size changes made by config.tuning
 } SpatialStats;
 
 // Get statistics about the current state of the index
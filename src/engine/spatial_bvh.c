@@ -0,0 +1,694 @@
+// spatial_bvh.c — Dynamic AABB tree backend (SPATIAL_TYPE_BVH)
+//
+// A binary tree over fattened AABBs: each leaf stores its collider AABB grown by
+// a margin (and stretched along the last displacement), and each internal node
+// the union of its children. A re-insert whose AABB still fits in the leaf's fat
+// AABB only updates the leaf; the tree changes only once it escapes.
+//
+// New leaves go next to the sibling that grows the total perimeter least (the 2D
+// surface area heuristic). On the way back up, each ancestor swaps a child with a
+// grandchild when that shrinks the perimeter, which keeps the tree tight (and
+// shallow, even for sorted inserts) without AVL-style height balancing. Nothing
+// depends on a cell size or world bounds, so the tree suits level geometry of any
+// size, and segment queries walk it directly. As the static layer
+// (SpatialConfig.static_type) it pays off for ray-heavy levels: with 5000 walls
+// (bench bvh), segments are ~25% faster than on a 64 px grid, but pairing and box
+// or point queries are slower, since the grid does them with a few cell lookups.
+//
+// Leaves persist across frames, keyed by entity slot like the quadtree's objects:
+// spatial_clear starts a new frame and leaves not re-inserted before the next
+// query are swept.
+//
+
+#include "spatial_internal.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define BVH_DEFAULT_MARGIN 8.0f
+
+// Leaves waiting to be linked above which (if also a quarter of the tree) a full
+// rebuild replaces linking them one by one
+#define BVH_REBUILD_NEW 64
+
+// Fat AABBs also stretch this many times the last displacement ahead of a moving leaf
+#define BVH_DISPLACEMENT_SCALE 2.0f
+
+// --- NODES ---
+
+// Make sure 'needed' nodes can be in use at once
+static int node_reserve(AabbTree* tree, int needed) {
+    int old = tree->node_capacity;
+    if (!spatial_grow_buffer((void**)&tree->nodes, &tree->node_capacity, needed, sizeof(BvhNode))) {
+        return 0;
+    }
+    // Thread the new tail onto the free list
+    for (int i = tree->node_capacity - 1; i >= old; i--) {
+        tree->nodes[i].height = -1;
+        tree->nodes[i].parent = tree->free_node;
+        tree->free_node = i;
+    }
+    return 1;
+}
+
+static int node_alloc(AabbTree* tree) {
+    if (tree->free_node < 0 && !node_reserve(tree, tree->node_capacity + 1)) return -1;
+
+    int n = tree->free_node;
+    tree->free_node = tree->nodes[n].parent;
+
+    BvhNode* node = &tree->nodes[n];
+    node->parent = -1;
+    node->child1 = node->child2 = -1;
+    node->height = 0;
+    node->leaf = -1;
+    tree->node_count++;
+    return n;
+}
+
+static void node_release(AabbTree* tree, int n) {
+    tree->nodes[n].height = -1;  // Marks the slot as free for the stats walk
+    tree->nodes[n].parent = tree->free_node;
+    tree->free_node = n;
+    tree->node_count--;
+}
+
+// 2D stand-in for surface area
+static inline float perimeter(float min_x, float min_y, float max_x, float max_y) {
+    return 2.0f * ((max_x - min_x) + (max_y - min_y));
+}
+
+static inline float union_perimeter(BvhNode* a, BvhNode* b) {
+    return perimeter(a->min_x < b->min_x ? a->min_x : b->min_x,
+                     a->min_y < b->min_y ? a->min_y : b->min_y,
+                     a->max_x > b->max_x ? a->max_x : b->max_x,
+                     a->max_y > b->max_y ? a->max_y : b->max_y);
+}
+
+static inline void node_fit(BvhNode* n, BvhNode* a, BvhNode* b) {
+    n->min_x = a->min_x < b->min_x ? a->min_x : b->min_x;
+    n->min_y = a->min_y < b->min_y ? a->min_y : b->min_y;
+    n->max_x = a->max_x > b->max_x ? a->max_x : b->max_x;
+    n->max_y = a->max_y > b->max_y ? a->max_y : b->max_y;
+}
+
+static inline int max_int(int a, int b) {
+    return a > b ? a : b;
+}
+
+// Point the parent of 'old_child' (or the root) at 'new_child'
+static inline void node_replace_child(AabbTree* tree, int parent, int old_child, int new_child) {
+    if (parent < 0) {
+        tree->root = new_child;
+    } else if (tree->nodes[parent].child1 == old_child) {
+        tree->nodes[parent].child1 = new_child;
+    } else {
+        tree->nodes[parent].child2 = new_child;
+    }
+}
+
+static inline float node_perimeter(BvhNode* n) {
+    return perimeter(n->min_x, n->min_y, n->max_x, n->max_y);
+}
+
+// Swap child x of a with grandchild y, which sits under a's other child o
+static void node_swap(AabbTree* tree, int ia, int ix, int io, int iy) {
+    BvhNode* a = &tree->nodes[ia];
+    BvhNode* o = &tree->nodes[io];
+    if (a->child1 == ix) a->child1 = iy; else a->child2 = iy;
+    if (o->child1 == iy) o->child1 = ix; else o->child2 = ix;
+    tree->nodes[ix].parent = io;
+    tree->nodes[iy].parent = ia;
+
+    BvhNode* o1 = &tree->nodes[o->child1];
+    BvhNode* o2 = &tree->nodes[o->child2];
+    node_fit(o, o1, o2);
+    o->height = 1 + max_int(o1->height, o2->height);
+    a->height = 1 + max_int(tree->nodes[a->child1].height, tree->nodes[a->child2].height);
+}
+
+// Cheapest child/grandchild swap under a by perimeter (a's own bounds never change)
+static void node_rotate(AabbTree* tree, int ia) {
+    BvhNode* a = &tree->nodes[ia];
+    if (a->height < 2) return;
+
+    int ib = a->child1, ic = a->child2;
+    BvhNode* b = &tree->nodes[ib];
+    BvhNode* c = &tree->nodes[ic];
+    float best = 0.0f;
+    int bx = -1, bo = -1, by = -1;
+
+    if (c->child1 >= 0) {
+        // b <-> one of c's children: c then holds b and the other one
+        BvhNode* f = &tree->nodes[c->child1];
+        BvhNode* g = &tree->nodes[c->child2];
+        float area_c = node_perimeter(c);
+        float d = union_perimeter(b, g) - area_c;
+        if (d < best) { best = d; bx = ib; bo = ic; by = c->child1; }
+        d = union_perimeter(b, f) - area_c;
+        if (d < best) { best = d; bx = ib; bo = ic; by = c->child2; }
+    }
+    if (b->child1 >= 0) {
+        BvhNode* d_ = &tree->nodes[b->child1];
+        BvhNode* e = &tree->nodes[b->child2];
+        float area_b = node_perimeter(b);
+        float d = union_perimeter(c, e) - area_b;
+        if (d < best) { best = d; bx = ic; bo = ib; by = b->child1; }
+        d = union_perimeter(c, d_) - area_b;
+        if (d < best) { best = d; bx = ic; bo = ib; by = b->child2; }
+    }
+    if (bx >= 0) node_swap(tree, ia, bx, bo, by);
+}
+
+// Refit and rotate every ancestor from n up to the root
+static void node_refit_up(AabbTree* tree, int n) {
+    while (n >= 0) {
+        BvhNode* node = &tree->nodes[n];
+        BvhNode* c1 = &tree->nodes[node->child1];
+        BvhNode* c2 = &tree->nodes[node->child2];
+        node->height = 1 + max_int(c1->height, c2->height);
+        node_fit(node, c1, c2);
+        node_rotate(tree, n);
+
+        n = node->parent;
+    }
+}
+
+// --- LEAVES ---
+
+// Link a leaf node (fat AABB already set) into the tree; returns 0 if out of memory
+static int leaf_link(AabbTree* tree, int leaf) {
+    if (tree->root < 0) {
+        tree->root = leaf;
+        tree->nodes[leaf].parent = -1;
+        return 1;
+    }
+
+    // Walk down to the cheapest sibling: stop when pairing with this node beats
+    // descending (every node below inherits the growth of its ancestors)
+    BvhNode* l = &tree->nodes[leaf];
+    int index = tree->root;
+    while (tree->nodes[index].child1 >= 0) {
+        BvhNode* node = &tree->nodes[index];
+        BvhNode* c1 = &tree->nodes[node->child1];
+        BvhNode* c2 = &tree->nodes[node->child2];
+
+        float area = perimeter(node->min_x, node->min_y, node->max_x, node->max_y);
+        float combined = union_perimeter(node, l);
+        float cost = 2.0f * combined;                    // New parent above this node
+        float inheritance = 2.0f * (combined - area);    // Growth pushed onto every ancestor
+
+        float cost1 = union_perimeter(c1, l) + inheritance;
+        if (c1->child1 >= 0) cost1 -= perimeter(c1->min_x, c1->min_y, c1->max_x, c1->max_y);
+        float cost2 = union_perimeter(c2, l) + inheritance;
+        if (c2->child1 >= 0) cost2 -= perimeter(c2->min_x, c2->min_y, c2->max_x, c2->max_y);
+
+        if (cost < cost1 && cost < cost2) break;
+        index = (cost1 < cost2) ? node->child1 : node->child2;
+    }
+    int sibling = index;
+
+    int parent = node_alloc(tree);  // May grow the pool (re-fetch pointers below)
+    if (parent < 0) return 0;
+
+    BvhNode* p = &tree->nodes[parent];
+    BvhNode* s = &tree->nodes[sibling];
+    p->parent = s->parent;
+    p->child1 = sibling;
+    p->child2 = leaf;
+    p->height = s->height + 1;
+    node_fit(p, s, &tree->nodes[leaf]);
+    node_replace_child(tree, s->parent, sibling, parent);
+    s->parent = parent;
+    tree->nodes[leaf].parent = parent;
+
+    node_refit_up(tree, parent);
+    return 1;
+}
+
+// Unlink a leaf node from the tree (the node itself stays allocated)
+static void leaf_unlink(AabbTree* tree, int leaf) {
+    if (leaf == tree->root) {
+        tree->root = -1;
+        return;
+    }
+
+    int parent = tree->nodes[leaf].parent;
+    int grand = tree->nodes[parent].parent;
+    int sibling = (tree->nodes[parent].child1 == leaf) ? tree->nodes[parent].child2
+                                                        : tree->nodes[parent].child1;
+
+    // The sibling takes the parent's place
+    node_replace_child(tree, grand, parent, sibling);
+    tree->nodes[sibling].parent = grand;
+    node_release(tree, parent);
+
+    node_refit_up(tree, grand);
+}
+
+// Set a leaf node's fat AABB around the collider AABB, stretched by the displacement
+static void leaf_fatten(AabbTree* tree, BvhNode* node, BvhLeaf* o, float dx, float dy) {
+    float m = tree->margin;
+    node->min_x = o->min_x - m;
+    node->min_y = o->min_y - m;
+    node->max_x = o->max_x + m;
+    node->max_y = o->max_y + m;
+
+    dx *= BVH_DISPLACEMENT_SCALE;
+    dy *= BVH_DISPLACEMENT_SCALE;
+    if (dx < 0.0f) node->min_x += dx; else node->max_x += dx;
+    if (dy < 0.0f) node->min_y += dy; else node->max_y += dy;
+}
+
+static void leaf_remove(AabbTree* tree, int k) {
+    BvhLeaf* o = &tree->leaves[k];
+    if (o->linked) {
+        leaf_unlink(tree, o->node);
+    } else {
+        tree->pending--;
+    }
+    node_release(tree, o->node);
+    tree->leaf_of_slot[ENTITY_HANDLE_INDEX(o->id)] = -1;
+
+    int last = --tree->leaf_count;
+    if (k != last) {
+        *o = tree->leaves[last];
+        tree->nodes[o->node].leaf = k;
+        tree->leaf_of_slot[ENTITY_HANDLE_INDEX(o->id)] = k;
+    }
+}
+
+// --- BULK BUILD ---
+// Top-down over the leaves' fat AABBs: split along the wider axis of the centers,
+// at the bin boundary with the lowest perimeter cost (binned SAH)
+
+#define BVH_BINS 16
+
+// Subtrees deeper than this split by count instead (bounds the recursion)
+#define BVH_BUILD_MAX_DEPTH 48
+
+// Builds a subtree over refs[0, n) and returns its root
+// (the pool was reserved up front, so node_alloc can't fail here)
+static int build_range(AabbTree* tree, BvhBuildRef* refs, int n, int depth) {
+    if (n == 1) return refs[0].node;
+
+    float lo_x = INFINITY, lo_y = INFINITY, hi_x = -INFINITY, hi_y = -INFINITY;
+    for (int i = 0; i < n; i++) {
+        if (refs[i].cx < lo_x) lo_x = refs[i].cx;
+        if (refs[i].cx > hi_x) hi_x = refs[i].cx;
+        if (refs[i].cy < lo_y) lo_y = refs[i].cy;
+        if (refs[i].cy > hi_y) hi_y = refs[i].cy;
+    }
+    int axis_y = (hi_y - lo_y) > (hi_x - lo_x);
+    float lo = axis_y ? lo_y : lo_x;
+    float extent = axis_y ? (hi_y - lo_y) : (hi_x - lo_x);
+
+    int split = n / 2;  // Fallback: all centers equal, or too deep
+    if (extent > 0.0f && depth < BVH_BUILD_MAX_DEPTH) {
+        // Small ranges get fewer bins (most ranges are small: their setup dominates)
+        int bin_count = (n < BVH_BINS) ? n : BVH_BINS;
+        struct { int count; float min_x, min_y, max_x, max_y; } bins[BVH_BINS];
+        for (int b = 0; b < bin_count; b++) {
+            bins[b].count = 0;
+            bins[b].min_x = bins[b].min_y = INFINITY;
+            bins[b].max_x = bins[b].max_y = -INFINITY;
+        }
+
+        float scale = (float)bin_count / extent;
+        for (int i = 0; i < n; i++) {
+            BvhBuildRef* r = &refs[i];
+            int b = (int)(((axis_y ? r->cy : r->cx) - lo) * scale);
+            if (b >= bin_count) b = bin_count - 1;
+            r->bin = b;
+            bins[b].count++;
+            if (r->min_x < bins[b].min_x) bins[b].min_x = r->min_x;
+            if (r->min_y < bins[b].min_y) bins[b].min_y = r->min_y;
+            if (r->max_x > bins[b].max_x) bins[b].max_x = r->max_x;
+            if (r->max_y > bins[b].max_y) bins[b].max_y = r->max_y;
+        }
+
+        // Right-to-left sweep: cost of everything in bins [b, bin_count)
+        float right_cost[BVH_BINS];
+        float min_x = INFINITY, min_y = INFINITY, max_x = -INFINITY, max_y = -INFINITY;
+        int count = 0;
+        for (int b = bin_count - 1; b > 0; b--) {
+            count += bins[b].count;
+            if (bins[b].min_x < min_x) min_x = bins[b].min_x;
+            if (bins[b].min_y < min_y) min_y = bins[b].min_y;
+            if (bins[b].max_x > max_x) max_x = bins[b].max_x;
+            if (bins[b].max_y > max_y) max_y = bins[b].max_y;
+            right_cost[b] = count ? perimeter(min_x, min_y, max_x, max_y) * (float)count : 0.0f;
+        }
+
+        // Left-to-right sweep picks the cheapest boundary
+        float best = INFINITY;
+        int best_bin = -1;
+        min_x = min_y = INFINITY;
+        max_x = max_y = -INFINITY;
+        count = 0;
+        for (int b = 1; b < bin_count; b++) {
+            count += bins[b - 1].count;
+            if (bins[b - 1].min_x < min_x) min_x = bins[b - 1].min_x;
+            if (bins[b - 1].min_y < min_y) min_y = bins[b - 1].min_y;
+            if (bins[b - 1].max_x > max_x) max_x = bins[b - 1].max_x;
+            if (bins[b - 1].max_y > max_y) max_y = bins[b - 1].max_y;
+            if (count == 0 || count == n) continue;
+            float cost = perimeter(min_x, min_y, max_x, max_y) * (float)count + right_cost[b];
+            if (cost < best) {
+                best = cost;
+                best_bin = b;
+            }
+        }
+
+        if (best_bin > 0) {
+            // Partition: refs in bins below best_bin go first
+            int i = 0, j = n - 1;
+            while (i <= j) {
+                if (refs[i].bin < best_bin) {
+                    i++;
+                } else {
+                    BvhBuildRef t = refs[i]; refs[i] = refs[j]; refs[j] = t;
+                    j--;
+                }
+            }
+            split = i;
+        }
+    }
+
+    int c1 = build_range(tree, refs, split, depth + 1);
+    int c2 = build_range(tree, refs + split, n - split, depth + 1);
+
+    int p = node_alloc(tree);
+    BvhNode* node = &tree->nodes[p];
+    node->child1 = c1;
+    node->child2 = c2;
+    node->height = 1 + max_int(tree->nodes[c1].height, tree->nodes[c2].height);
+    node_fit(node, &tree->nodes[c1], &tree->nodes[c2]);
+    tree->nodes[c1].parent = p;
+    tree->nodes[c2].parent = p;
+    return p;
+}
+
+// Throw away the internal nodes and build the tree over every leaf at once
+// Returns 0 (tree untouched) if out of memory
+static int bvh_rebuild(AabbTree* tree) {
+    int n = tree->leaf_count;
+    if (!node_reserve(tree, 2 * n) ||
+        !spatial_grow_buffer((void**)&tree->refs, &tree->ref_capacity, n, sizeof(BvhBuildRef))) {
+        return 0;
+    }
+
+    for (int i = 0; i < tree->node_capacity; i++) {
+        BvhNode* node = &tree->nodes[i];
+        if (node->height > 0) node_release(tree, i);
+    }
+
+    // Leaf boxes are copied out so the build sweeps contiguous memory
+    for (int k = 0; k < n; k++) {
+        BvhLeaf* o = &tree->leaves[k];
+        BvhNode* l = &tree->nodes[o->node];
+        BvhBuildRef* r = &tree->refs[k];
+        r->min_x = l->min_x;
+        r->min_y = l->min_y;
+        r->max_x = l->max_x;
+        r->max_y = l->max_y;
+        r->cx = l->min_x + l->max_x;  // Centers, doubled
+        r->cy = l->min_y + l->max_y;
+        r->node = o->node;
+        o->linked = 1;
+    }
+    tree->root = (n > 0) ? build_range(tree, tree->refs, n, 0) : -1;
+    if (tree->root >= 0) tree->nodes[tree->root].parent = -1;
+    tree->pending = 0;
+    return 1;
+}
+
+// --- UPKEEP ---
+
+// Drop leaves that weren't re-inserted since the last clear
+static void bvh_sweep(AabbTree* tree) {
+    for (int k = tree->leaf_count - 1; k >= 0; k--) {
+        if (tree->leaves[k].seen != tree->frame) leaf_remove(tree, k);
+    }
+    tree->sweep_pending = 0;
+}
+
+// Bring the tree up to date and size the traversal stack for it
+// (depth-first, each level pops one node and pushes two: height + 1 entries at most)
+static int bvh_prepare(AabbTree* tree) {
+    if (tree->sweep_pending) bvh_sweep(tree);
+
+    // Link leaves that are new or escaped their fat AABB: one at a time, or with
+    // a full rebuild when that many would degrade the tree anyway
+    if (tree->pending > 0) {
+        int rebuilt = tree->pending > BVH_REBUILD_NEW && tree->pending * 4 >= tree->leaf_count &&
+                      bvh_rebuild(tree);
+        for (int k = 0; !rebuilt && tree->pending > 0 && k < tree->leaf_count; k++) {
+            BvhLeaf* o = &tree->leaves[k];
+            if (o->linked) continue;
+            if (!leaf_link(tree, o->node)) break;  // Out of memory: retried next time
+            o->linked = 1;
+            tree->pending--;
+        }
+    }
+
+    if (tree->root < 0) return 0;
+    return spatial_grow_buffer((void**)&tree->stack, &tree->stack_capacity,
+                               tree->nodes[tree->root].height + 2, sizeof(int));
+}
+
+// --- BACKEND API ---
+
+int bvh_init(AabbTree* tree, SpatialConfig config) {
+    memset(tree, 0, sizeof(*tree));
+    tree->free_node = -1;
+    tree->root = -1;
+    tree->margin = (config.bvh_margin > 0.0f) ? config.bvh_margin : BVH_DEFAULT_MARGIN;
+    tree->frame = 1;
+    return 1;
+}
+
+void bvh_free(AabbTree* tree) {
+    free(tree->nodes);
+    free(tree->leaves);
+    free(tree->leaf_of_slot);
+    free(tree->stack);
+    free(tree->refs);
+    memset(tree, 0, sizeof(*tree));
+}
+
+void bvh_clear(AabbTree* tree) {
+    if (++tree->frame == 0) {
+        // Wrapped: zero every mark so none can match the new frame
+        for (int k = 0; k < tree->leaf_count; k++) tree->leaves[k].seen = 0;
+        tree->frame = 1;
+    }
+    tree->sweep_pending = 1;
+    tree->reinserted = 0;
+}
+
+void bvh_insert(AabbTree* tree, Entity* entity,
+                float min_x, float min_y, float max_x, float max_y) {
+    int slot = (int)ENTITY_HANDLE_INDEX(entity->id);
+
+    if (slot >= tree->slot_capacity) {
+        int old = tree->slot_capacity;
+        if (!spatial_grow_buffer((void**)&tree->leaf_of_slot, &tree->slot_capacity, slot + 1, sizeof(int))) {
+            return;
+        }
+        for (int i = old; i < tree->slot_capacity; i++) tree->leaf_of_slot[i] = -1;
+    }
+
+    int k = tree->leaf_of_slot[slot];
+    if (k >= 0 && tree->leaves[k].id != entity->id) {
+        // Slot was recycled by a different entity
+        leaf_remove(tree, k);
+        k = -1;
+    }
+
+    if (k < 0) {
+        if (!spatial_grow_buffer((void**)&tree->leaves, &tree->leaf_capacity,
+                                 tree->leaf_count + 1, sizeof(BvhLeaf))) {
+            return;
+        }
+        int n = node_alloc(tree);
+        if (n < 0) return;
+
+        // Linked into the tree by the next query
+        k = tree->leaf_count++;
+        tree->leaves[k].id = entity->id;
+        tree->leaves[k].node = n;
+        tree->leaves[k].linked = 0;
+        tree->nodes[n].leaf = k;
+        tree->leaf_of_slot[slot] = k;
+        tree->pending++;
+    }
+
+    BvhLeaf* o = &tree->leaves[k];
+    float dx = (min_x + max_x - o->min_x - o->max_x) * 0.5f;
+    float dy = (min_y + max_y - o->min_y - o->max_y) * 0.5f;
+    o->entity = entity;
+    o->min_x = min_x;
+    o->min_y = min_y;
+    o->max_x = max_x;
+    o->max_y = max_y;
+    o->layer = entity->collider.layer;
+    o->mask = entity->collider.mask;
+    o->seen = tree->frame;
+
+    BvhNode* node = &tree->nodes[o->node];
+    if (!o->linked) {
+        leaf_fatten(tree, node, o, 0.0f, 0.0f);
+        return;
+    }
+
+    // Still inside its fat AABB: the tree doesn't change
+    if (min_x >= node->min_x && min_y >= node->min_y &&
+        max_x <= node->max_x && max_y <= node->max_y) return;
+
+    leaf_unlink(tree, o->node);
+    leaf_fatten(tree, node, o, dx, dy);
+    o->linked = 0;
+    tree->pending++;
+    tree->reinserted++;
+}
+
+void bvh_remove(AabbTree* tree, Entity* entity) {
+    int slot = (int)ENTITY_HANDLE_INDEX(entity->id);
+    if (slot >= tree->slot_capacity) return;
+
+    int k = tree->leaf_of_slot[slot];
+    if (k < 0 || tree->leaves[k].id != entity->id) return;
+    leaf_remove(tree, k);
+}
+
+// Traversals test children before pushing them, so only overlapping nodes are
+// visited. Nodes are culled with their fat AABB, leaves tested with the collider AABB
+
+static inline int node_overlaps(BvhNode* n, float min_x, float min_y, float max_x, float max_y) {
+    return aabb_overlap(min_x, min_y, max_x, max_y, n->min_x, n->min_y, n->max_x, n->max_y);
+}
+
+static inline int node_hit(BvhNode* n, float x0, float y0, float dx, float dy) {
+    return segment_hits_aabb(x0, y0, dx, dy, n->min_x, n->min_y, n->max_x, n->max_y);
+}
+
+int bvh_query(AabbTree* tree, Entity* self,
+              float min_x, float min_y, float max_x, float max_y,
+              Entity** out, int max_out, int* dropped) {
+    if (!bvh_prepare(tree)) return 0;
+
+    int count = 0;
+    int* stack = tree->stack;
+    int top = 0;
+    stack[top++] = tree->root;
+
+    if (!node_overlaps(&tree->nodes[tree->root], min_x, min_y, max_x, max_y)) return 0;
+
+    while (top > 0) {
+        BvhNode* node = &tree->nodes[stack[--top]];
+
+        if (node->child1 >= 0) {
+            if (node_overlaps(&tree->nodes[node->child2], min_x, min_y, max_x, max_y)) stack[top++] = node->child2;
+            if (node_overlaps(&tree->nodes[node->child1], min_x, min_y, max_x, max_y)) stack[top++] = node->child1;
+            continue;
+        }
+
+        BvhLeaf* o = &tree->leaves[node->leaf];
+        if (o->entity == self) continue;
+        if (!aabb_overlap(min_x, min_y, max_x, max_y, o->min_x, o->min_y, o->max_x, o->max_y)) continue;
+
+        if (count < max_out) {
+            out[count++] = o->entity;
+        } else {
+            (*dropped)++;  // Keep scanning so the caller sees the real shortfall
+        }
+    }
+
+    return count;
+}
+
+// Entities whose collider AABB the segment (x0, y0) -> (x1, y1) touches
+int bvh_query_segment(AabbTree* tree, float x0, float y0, float x1, float y1,
+                      Entity** out, int max_out, int* dropped) {
+    if (!bvh_prepare(tree)) return 0;
+
+    float dx = x1 - x0;
+    float dy = y1 - y0;
+    int count = 0;
+    int* stack = tree->stack;
+    int top = 0;
+    stack[top++] = tree->root;
+
+    if (!node_hit(&tree->nodes[tree->root], x0, y0, dx, dy)) return 0;
+
+    while (top > 0) {
+        BvhNode* node = &tree->nodes[stack[--top]];
+
+        if (node->child1 >= 0) {
+            if (node_hit(&tree->nodes[node->child2], x0, y0, dx, dy)) stack[top++] = node->child2;
+            if (node_hit(&tree->nodes[node->child1], x0, y0, dx, dy)) stack[top++] = node->child1;
+            continue;
+        }
+
+        BvhLeaf* o = &tree->leaves[node->leaf];
+        if (!segment_hits_aabb(x0, y0, dx, dy, o->min_x, o->min_y, o->max_x, o->max_y)) continue;
+
+        if (count < max_out) {
+            out[count++] = o->entity;
+        } else {
+            (*dropped)++;
+        }
+    }
+
+    return count;
+}
+
+// --- PAIRS ---
+// One tree query per leaf; a pair is reported from its lower leaf index only
+
+void bvh_find_pairs(AabbTree* tree, SpatialPairList* out) {
+    if (!bvh_prepare(tree)) return;
+
+    int* stack = tree->stack;
+    for (int i = 0; i < tree->leaf_count; i++) {
+        BvhLeaf* a = &tree->leaves[i];
+        int top = 0;
+        stack[top++] = tree->root;  // Always overlaps: it contains a
+
+        while (top > 0) {
+            BvhNode* node = &tree->nodes[stack[--top]];
+
+            if (node->child1 >= 0) {
+                if (node_overlaps(&tree->nodes[node->child2], a->min_x, a->min_y, a->max_x, a->max_y)) {
+                    stack[top++] = node->child2;
+                }
+                if (node_overlaps(&tree->nodes[node->child1], a->min_x, a->min_y, a->max_x, a->max_y)) {
+                    stack[top++] = node->child1;
+                }
+                continue;
+            }
+
+            if (node->leaf <= i) continue;
+            BvhLeaf* b = &tree->leaves[node->leaf];
+            if (!layers_interact(a->layer, a->mask, b->layer, b->mask)) continue;
+            if (!aabb_overlap(a->min_x, a->min_y, a->max_x, a->max_y,
+                              b->min_x, b->min_y, b->max_x, b->max_y)) continue;
+            if (!spatial_pair_push(out, a->entity, b->entity)) return;
+        }
+    }
+}
+
+void bvh_stats(AabbTree* tree, SpatialStats* stats) {
+    bvh_prepare(tree);
+
+    // Cells = tree nodes; only leaves hold an entity (one each)
+    stats->total_cells = tree->node_count;
+    stats->occupied_cells = tree->leaf_count;
+    stats->total_entities = tree->leaf_count;
+    stats->moved_entities = tree->reinserted;
+    if (tree->leaf_count > 0) {
+        stats->max_per_cell = 1;
+        stats->avg_per_cell = 1.0f;
+    }
+}
@@ -0,0 +1,559 @@
+// spatial_hgrid.c — Hierarchical grid backend (SPATIAL_TYPE_HGRID)
+//
+// A stack of grids whose cell size doubles from one level to the next. Each
+// entry lives in exactly one cell: the one holding its AABB center, on the
+// smallest level whose cells are at least as big as the collider. So a large
+// collider costs one cell membership instead of one per covered cell, small ones
+// still get small cells, and there is no single cell size to tune.
+//
+// A collider sticks out of its cell by at most half its size, so a query on
+// level L pads its box by the largest half extent stored there (reach[L]) and
+// scans the cells under the padded box. Levels without entries are skipped.
+// Pairs on the same level come from each cell and its forward neighbours; pairs
+// across levels are found by the larger entry, which scans the finer levels with
+// their (small) padding.
+//
+// Each level is a dense CSR grid over the cells its entries cover, so there are
+// no world bounds. A level that would need many more cells than it has entries
+// (small colliders spread thinly) hands its entries to the next level up, which
+// keeps memory and empty-cell scanning proportional to the entry count.
+// Entries persist across frames, keyed by entity slot: the cells are rebuilt
+// only when an entry changed cell, spatial_clear starts a new frame and entries
+// not re-inserted before the next query are swept.
+//
+
+#include "spatial_internal.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// Level 0 cell size when SpatialConfig.cell_size is 0
+#define HGRID_DEFAULT_CELL 1.0f
+
+// A level may span this many cells per entry (plus HGRID_MIN_CELLS) before its
+// entries move up a level
+#define HGRID_CELLS_PER_ENTRY 8
+#define HGRID_MIN_CELLS 64
+
+// Cell coordinates stay well inside int range (2^29 cells each way)
+#define HGRID_CELL_LIMIT 536870912.0f
+
+// --- CELLS ---
+
+static inline int cell_coord(float v) {
+    float c = floorf(v);
+    if (!(c > -HGRID_CELL_LIMIT)) c = -HGRID_CELL_LIMIT;  // Also catches NaN
+    if (c > HGRID_CELL_LIMIT) c = HGRID_CELL_LIMIT;
+    return (int)c;
+}
+
+static inline int clamp_int(int v, int lo, int hi) {
+    return v < lo ? lo : (v > hi ? hi : v);
+}
+
+// Smallest level whose cells fit an AABB of this size (the top level takes the rest)
+static inline int level_for_size(HierarchicalGrid* grid, float size) {
+    int level = 0;
+    while (level < HGRID_LEVELS - 1 && grid->cell_size[level] < size) level++;
+    return level;
+}
+
+// Cell of the point (x, y) on a level, in the level's own coordinates
+// Returns 0 if the point is outside the level's cells (they need a rebuild)
+static inline int level_cell(HierarchicalGrid* grid, int level, float x, float y, int* cx, int* cy) {
+    if (grid->cols[level] == 0) return 0;
+
+    float inv = grid->inv_cell_size[level];
+    int x0 = cell_coord(x * inv) - grid->origin_x[level];
+    int y0 = cell_coord(y * inv) - grid->origin_y[level];
+    *cx = clamp_int(x0, 0, grid->cols[level] - 1);
+    *cy = clamp_int(y0, 0, grid->rows[level] - 1);
+    return (*cx == x0 && *cy == y0) || grid->capped[level];
+}
+
+// --- BUILD ---
+
+// Pick the level of every size level and the cell range of every level in use
+// Returns the total cell count
+static int plan_levels(HierarchicalGrid* grid) {
+    int count[HGRID_LEVELS] = {0};
+    float lo_x[HGRID_LEVELS], lo_y[HGRID_LEVELS], hi_x[HGRID_LEVELS], hi_y[HGRID_LEVELS];
+    for (int l = 0; l < HGRID_LEVELS; l++) {
+        lo_x[l] = lo_y[l] = INFINITY;
+        hi_x[l] = hi_y[l] = -INFINITY;
+    }
+
+    // Entry count and center bounds per size level
+    for (int i = 0; i < grid->entry_count; i++) {
+        HGridEntry* e = &grid->entries[i];
+        int l = e->size_level;
+        float x = (e->min_x + e->max_x) * 0.5f;
+        float y = (e->min_y + e->max_y) * 0.5f;
+        if (x < lo_x[l]) lo_x[l] = x;
+        if (x > hi_x[l]) hi_x[l] = x;
+        if (y < lo_y[l]) lo_y[l] = y;
+        if (y > hi_y[l]) hi_y[l] = y;
+        count[l]++;
+    }
+
+    // Bottom-up: size levels accumulate until a level is dense enough for all of them
+    int cells = 0;
+    int first = 0;
+    int group = 0;
+    float g_lo_x = INFINITY, g_lo_y = INFINITY, g_hi_x = -INFINITY, g_hi_y = -INFINITY;
+    grid->occupied = 0;
+
+    for (int l = 0; l < HGRID_LEVELS; l++) {
+        grid->cols[l] = grid->rows[l] = 0;
+        grid->capped[l] = 0;
+        grid->promote[l] = l;
+
+        group += count[l];
+        g_lo_x = fminf(g_lo_x, lo_x[l]);
+        g_lo_y = fminf(g_lo_y, lo_y[l]);
+        g_hi_x = fmaxf(g_hi_x, hi_x[l]);
+        g_hi_y = fmaxf(g_hi_y, hi_y[l]);
+        if (group == 0) {
+            first = l + 1;
+            continue;
+        }
+
+        float inv = grid->inv_cell_size[l];
+        int x0 = cell_coord(g_lo_x * inv), x1 = cell_coord(g_hi_x * inv);
+        int y0 = cell_coord(g_lo_y * inv), y1 = cell_coord(g_hi_y * inv);
+        if (x1 < x0) x1 = x0;  // Only NaN centers
+        if (y1 < y0) y1 = y0;
+
+        double limit = (double)group * HGRID_CELLS_PER_ENTRY + HGRID_MIN_CELLS;
+        double span_x = (double)x1 - x0 + 1.0, span_y = (double)y1 - y0 + 1.0;
+        if (span_x * span_y > limit) {
+            if (l < HGRID_LEVELS - 1) continue;  // Too sparse: try the next level up
+
+            // Nothing coarser left: keep the middle, clamp the far entries to the border
+            int max_span = (int)sqrt(limit);
+            if (span_x > max_span) {
+                x0 = (int)(((double)x0 + x1 - max_span) * 0.5);
+                x1 = x0 + max_span - 1;
+            }
+            if (span_y > max_span) {
+                y0 = (int)(((double)y0 + y1 - max_span) * 0.5);
+                y1 = y0 + max_span - 1;
+            }
+            grid->capped[l] = 1;
+        } else {
+            // One spare cell around the edges, so entries can drift before a rebuild
+            x0--; y0--; x1++; y1++;
+        }
+
+        for (int s = first; s <= l; s++) grid->promote[s] = l;
+        grid->origin_x[l] = x0;
+        grid->origin_y[l] = y0;
+        grid->cols[l] = x1 - x0 + 1;
+        grid->rows[l] = y1 - y0 + 1;
+        grid->first_cell[l] = cells;
+        cells += grid->cols[l] * grid->rows[l];
+        grid->occupied |= 1u << l;
+
+        group = 0;
+        first = l + 1;
+        g_lo_x = g_lo_y = INFINITY;
+        g_hi_x = g_hi_y = -INFINITY;
+    }
+    return cells;
+}
+
+// Counting sort of entries into cells, and into levels
+static void hgrid_build(HierarchicalGrid* grid) {
+    int cells = plan_levels(grid);
+
+    if (!spatial_grow_buffer((void**)&grid->cell_start, &grid->cell_capacity, cells + 1, sizeof(int)) ||
+        !spatial_grow_buffer((void**)&grid->cell_items, &grid->item_capacity,
+                             grid->entry_count, sizeof(int)) ||
+        !spatial_grow_buffer((void**)&grid->level_items, &grid->level_item_capacity,
+                             grid->entry_count, sizeof(int))) {
+        // Out of memory: leave the grid empty (the next insert retries)
+        for (int l = 0; l < HGRID_LEVELS; l++) grid->cols[l] = grid->rows[l] = 0;
+        memset(grid->level_start, 0, sizeof(grid->level_start));
+        grid->occupied = 0;
+        grid->cell_count = 0;
+        grid->dirty = 0;
+        return;
+    }
+    grid->cell_count = cells;
+
+    int* start = grid->cell_start;
+    memset(start, 0, (size_t)(cells + 1) * sizeof(int));
+
+    int level_count[HGRID_LEVELS] = {0};
+    for (int l = 0; l < HGRID_LEVELS; l++) grid->reach[l] = 0.0f;
+
+    for (int i = 0; i < grid->entry_count; i++) {
+        HGridEntry* e = &grid->entries[i];
+        int l = grid->promote[e->size_level];
+        level_cell(grid, l, (e->min_x + e->max_x) * 0.5f, (e->min_y + e->max_y) * 0.5f, &e->cx, &e->cy);
+        e->level = l;
+        e->bucket = grid->first_cell[l] + e->cy * grid->cols[l] + e->cx;
+        start[e->bucket]++;
+
+        float half = 0.5f * fmaxf(e->max_x - e->min_x, e->max_y - e->min_y);
+        if (half > grid->reach[l]) grid->reach[l] = half;
+        level_count[l]++;
+    }
+
+    // Inclusive prefix sum, then scatter back to front (keeps insertion order per cell)
+    int sum = 0;
+    for (int c = 0; c < cells; c++) {
+        sum += start[c];
+        start[c] = sum;
+    }
+    start[cells] = sum;
+    for (int i = grid->entry_count - 1; i >= 0; i--) {
+        grid->cell_items[--start[grid->entries[i].bucket]] = i;
+    }
+
+    // Same for levels
+    sum = 0;
+    for (int l = 0; l < HGRID_LEVELS; l++) {
+        sum += level_count[l];
+        grid->level_start[l] = sum;
+    }
+    grid->level_start[HGRID_LEVELS] = sum;
+    for (int i = grid->entry_count - 1; i >= 0; i--) {
+        grid->level_items[--grid->level_start[grid->entries[i].level]] = i;
+    }
+
+    grid->dirty = 0;
+}
+
+// --- ENTRIES ---
+
+// Swap-remove entry k (the cells are rebuilt on the next query)
+static void entry_remove(HierarchicalGrid* grid, int k) {
+    grid->entry_of_slot[ENTITY_HANDLE_INDEX(grid->entries[k].id)] = -1;
+
+    int last = --grid->entry_count;
+    if (k != last) {
+        grid->entries[k] = grid->entries[last];
+        grid->entry_of_slot[ENTITY_HANDLE_INDEX(grid->entries[k].id)] = k;
+    }
+    grid->dirty = 1;
+}
+
+// Drop entries that weren't re-inserted since the last clear
+static void hgrid_sweep(HierarchicalGrid* grid) {
+    for (int k = grid->entry_count - 1; k >= 0; k--) {
+        if (grid->entries[k].seen != grid->frame) entry_remove(grid, k);
+    }
+    grid->sweep_pending = 0;
+}
+
+// Bring the cells up to date before reading them
+static void hgrid_prepare(HierarchicalGrid* grid) {
+    if (grid->sweep_pending) hgrid_sweep(grid);
+    if (grid->dirty) hgrid_build(grid);
+}
+
+// Cells of a level whose entries can overlap the box (level coordinates)
+// Returns 0 when the range covers more cells than the level has entries
+// (cheaper to walk the level's entries then)
+static int level_range(HierarchicalGrid* grid, int level,
+                       float min_x, float min_y, float max_x, float max_y,
+                       int* x0, int* y0, int* x1, int* y1) {
+    float pad = grid->reach[level];
+    float inv = grid->inv_cell_size[level];
+    int cols = grid->cols[level], rows = grid->rows[level];
+    *x0 = clamp_int(cell_coord((min_x - pad) * inv) - grid->origin_x[level], 0, cols - 1);
+    *y0 = clamp_int(cell_coord((min_y - pad) * inv) - grid->origin_y[level], 0, rows - 1);
+    *x1 = clamp_int(cell_coord((max_x + pad) * inv) - grid->origin_x[level], 0, cols - 1);
+    *y1 = clamp_int(cell_coord((max_y + pad) * inv) - grid->origin_y[level], 0, rows - 1);
+
+    int range_cells = (*x1 - *x0 + 1) * (*y1 - *y0 + 1);
+    return range_cells <= grid->level_start[level + 1] - grid->level_start[level];
+}
+
+// --- BACKEND API ---
+
+int hgrid_init(HierarchicalGrid* grid, SpatialConfig config) {
+    memset(grid, 0, sizeof(*grid));
+
+    float cell = (config.cell_size > 0.0f) ? config.cell_size : HGRID_DEFAULT_CELL;
+    for (int l = 0; l < HGRID_LEVELS; l++) {
+        grid->cell_size[l] = cell;
+        grid->inv_cell_size[l] = 1.0f / cell;
+        grid->promote[l] = l;
+        cell *= 2.0f;
+    }
+
+    grid->cell_start = calloc(1, sizeof(int));
+    if (!grid->cell_start) return 0;
+    grid->cell_capacity = 1;
+
+    grid->frame = 1;
+    return 1;
+}
+
+void hgrid_free(HierarchicalGrid* grid) {
+    free(grid->entries);
+    free(grid->entry_of_slot);
+    free(grid->cell_start);
+    free(grid->cell_items);
+    free(grid->level_items);
+    memset(grid, 0, sizeof(*grid));
+}
+
+void hgrid_clear(HierarchicalGrid* grid) {
+    if (++grid->frame == 0) {
+        // Wrapped: reset the marks so no stale entry looks current
+        for (int k = 0; k < grid->entry_count; k++) grid->entries[k].seen = 0;
+        grid->frame = 1;
+    }
+    grid->sweep_pending = 1;
+    grid->moved = 0;
+}
+
+void hgrid_insert(HierarchicalGrid* grid, Entity* entity,
+                  float min_x, float min_y, float max_x, float max_y) {
+    int slot = (int)ENTITY_HANDLE_INDEX(entity->id);
+    if (slot >= grid->entry_slot_capacity) {
+        int old = grid->entry_slot_capacity;
+        if (!spatial_grow_buffer((void**)&grid->entry_of_slot, &grid->entry_slot_capacity,
+                                 slot + 1, sizeof(int))) {
+            return;
+        }
+        for (int i = old; i < grid->entry_slot_capacity; i++) grid->entry_of_slot[i] = -1;
+    }
+
+    float size = fmaxf(max_x - min_x, max_y - min_y);
+    int size_level = level_for_size(grid, size);
+    int level = grid->promote[size_level];
+    int cx, cy;
+    int fits = level_cell(grid, level, (min_x + max_x) * 0.5f, (min_y + max_y) * 0.5f, &cx, &cy);
+
+    int k = grid->entry_of_slot[slot];
+    if (k >= 0 && grid->entries[k].id != entity->id) {
+        // Slot was recycled by a different entity
+        entry_remove(grid, k);
+        k = -1;
+    }
+
+    HGridEntry* e;
+    if (k < 0) {
+        // New entry; it's placed by the next build
+        if (!spatial_grow_buffer((void**)&grid->entries, &grid->entry_capacity,
+                                 grid->entry_count + 1, sizeof(HGridEntry))) {
+            return;
+        }
+        k = grid->entry_count++;
+        grid->entry_of_slot[slot] = k;
+        e = &grid->entries[k];
+        e->id = entity->id;
+        grid->dirty = 1;
+    } else {
+        e = &grid->entries[k];
+        if (!fits || e->level != level || e->cx != cx || e->cy != cy) {
+            grid->dirty = 1;
+            grid->moved++;
+        } else if (0.5f * size > grid->reach[level]) {
+            grid->reach[level] = 0.5f * size;  // Grew in place: widen the padding now
+        }
+    }
+
+    e->entity = entity;
+    e->seen = grid->frame;
+    e->min_x = min_x;
+    e->min_y = min_y;
+    e->max_x = max_x;
+    e->max_y = max_y;
+    e->layer = entity->collider.layer;
+    e->mask = entity->collider.mask;
+    e->size_level = size_level;
+}
+
+void hgrid_remove(HierarchicalGrid* grid, Entity* entity) {
+    int slot = (int)ENTITY_HANDLE_INDEX(entity->id);
+    if (slot >= grid->entry_slot_capacity) return;
+
+    int k = grid->entry_of_slot[slot];
+    if (k >= 0 && grid->entries[k].id == entity->id) entry_remove(grid, k);
+}
+
+// Report entry k if it overlaps the box; returns the new count
+static inline int query_test(HierarchicalGrid* grid, int k, Entity* self,
+                             float min_x, float min_y, float max_x, float max_y,
+                             Entity** out, int max_out, int count, int* dropped) {
+    HGridEntry* e = &grid->entries[k];
+    if (e->entity == self) return count;
+    if (!aabb_overlap(min_x, min_y, max_x, max_y, e->min_x, e->min_y, e->max_x, e->max_y)) return count;
+
+    if (count < max_out) {
+        out[count++] = e->entity;
+    } else {
+        (*dropped)++;  // Keep scanning so the caller sees the real shortfall
+    }
+    return count;
+}
+
+// Entries sit in one cell only, so no de-duplication is needed
+int hgrid_query(HierarchicalGrid* grid, Entity* self,
+                float min_x, float min_y, float max_x, float max_y,
+                Entity** out, int max_out, int* dropped) {
+    hgrid_prepare(grid);
+
+    int count = 0;
+    for (int level = 0; level < HGRID_LEVELS; level++) {
+        if (!(grid->occupied & (1u << level))) continue;
+
+        int x0, y0, x1, y1;
+        if (!level_range(grid, level, min_x, min_y, max_x, max_y, &x0, &y0, &x1, &y1)) {
+            int end = grid->level_start[level + 1];
+            for (int i = grid->level_start[level]; i < end; i++) {
+                count = query_test(grid, grid->level_items[i], self, min_x, min_y, max_x, max_y,
+                                   out, max_out, count, dropped);
+            }
+            continue;
+        }
+
+        for (int cy = y0; cy <= y1; cy++) {
+            // Cells of a row are contiguous, and so are their items
+            int row = grid->first_cell[level] + cy * grid->cols[level];
+            int end = grid->cell_start[row + x1 + 1];
+            for (int i = grid->cell_start[row + x0]; i < end; i++) {
+                count = query_test(grid, grid->cell_items[i], self, min_x, min_y, max_x, max_y,
+                                   out, max_out, count, dropped);
+            }
+        }
+    }
+    return count;
+}
+
+// --- PAIRS ---
+
+// Returns 0 if the pair buffer could not grow
+static inline int pair_test(HGridEntry* a, HGridEntry* b, SpatialPairList* out) {
+    if (!aabb_overlap(a->min_x, a->min_y, a->max_x, a->max_y,
+                      b->min_x, b->min_y, b->max_x, b->max_y)) return 1;
+    if (!layers_interact(a->layer, a->mask, b->layer, b->mask)) return 1;
+    return spatial_pair_push(out, a->entity, b->entity);
+}
+
+// Pair entry k with items [begin, end) of cell_items
+static inline int pair_entry_items(HierarchicalGrid* grid, int k, int begin, int end, SpatialPairList* out) {
+    HGridEntry* a = &grid->entries[k];
+    for (int i = begin; i < end; i++) {
+        if (!pair_test(a, &grid->entries[grid->cell_items[i]], out)) return 0;
+    }
+    return 1;
+}
+
+// Pair entry k with the entries of a finer level whose cells its AABB can reach
+// (or, on its own level, with the entries after it when the forward neighbours
+// are not enough: only if colliders outgrew the top level's cells)
+static int pair_entry_level(HierarchicalGrid* grid, int k, int level, SpatialPairList* out) {
+    HGridEntry* a = &grid->entries[k];
+    int same = (level == a->level);
+
+    int x0, y0, x1, y1;
+    if (!level_range(grid, level, a->min_x, a->min_y, a->max_x, a->max_y, &x0, &y0, &x1, &y1)) {
+        int end = grid->level_start[level + 1];
+        for (int i = grid->level_start[level]; i < end; i++) {
+            int j = grid->level_items[i];
+            if (same && j <= k) continue;
+            if (!pair_test(a, &grid->entries[j], out)) return 0;
+        }
+        return 1;
+    }
+
+    for (int cy = y0; cy <= y1; cy++) {
+        int row = grid->first_cell[level] + cy * grid->cols[level];
+        int begin = grid->cell_start[row + x0];
+        int end = grid->cell_start[row + x1 + 1];
+        if (!same) {
+            if (!pair_entry_items(grid, k, begin, end, out)) return 0;
+            continue;
+        }
+        for (int i = begin; i < end; i++) {
+            int j = grid->cell_items[i];
+            if (j <= k) continue;
+            if (!pair_test(a, &grid->entries[j], out)) return 0;
+        }
+    }
+    return 1;
+}
+
+// Neighbour cells that pair with a cell on the same level: with every collider
+// at most one cell wide, overlaps only reach the 8 neighbours, and half of them
+// cover each neighbouring pair of cells once
+static const int forward_dx[4] = { 1, -1, 0, 1 };
+static const int forward_dy[4] = { 0,  1, 1, 1 };
+
+// Pairs whose larger entry sits in cell (cx, cy) of a level
+static int pair_cell(HierarchicalGrid* grid, int level, int cx, int cy, SpatialPairList* out) {
+    int cols = grid->cols[level], rows = grid->rows[level];
+    int b = grid->first_cell[level] + cy * cols + cx;
+    int begin = grid->cell_start[b];
+    int end = grid->cell_start[b + 1];
+    if (begin == end) return 1;
+
+    // Same level: a collider sticks out by at most reach, so two of them can only
+    // meet across neighbouring cells while 2 * reach stays within a cell
+    if (2.0f * grid->reach[level] <= grid->cell_size[level]) {
+        for (int i = begin; i < end; i++) {
+            if (!pair_entry_items(grid, grid->cell_items[i], i + 1, end, out)) return 0;
+        }
+        for (int n = 0; n < 4; n++) {
+            int nx = cx + forward_dx[n], ny = cy + forward_dy[n];
+            if (nx < 0 || nx >= cols || ny >= rows) continue;
+            int nb = b + forward_dy[n] * cols + forward_dx[n];
+            int n_begin = grid->cell_start[nb], n_end = grid->cell_start[nb + 1];
+            if (n_begin == n_end) continue;
+            for (int i = begin; i < end; i++) {
+                if (!pair_entry_items(grid, grid->cell_items[i], n_begin, n_end, out)) return 0;
+            }
+        }
+    } else {
+        for (int i = begin; i < end; i++) {
+            if (!pair_entry_level(grid, grid->cell_items[i], level, out)) return 0;
+        }
+    }
+
+    // Finer levels
+    for (int l = 0; l < level; l++) {
+        if (!(grid->occupied & (1u << l))) continue;
+        for (int i = begin; i < end; i++) {
+            if (!pair_entry_level(grid, grid->cell_items[i], l, out)) return 0;
+        }
+    }
+    return 1;
+}
+
+void hgrid_find_pairs(HierarchicalGrid* grid, SpatialPairList* out) {
+    hgrid_prepare(grid);
+
+    for (int level = 0; level < HGRID_LEVELS; level++) {
+        if (!(grid->occupied & (1u << level))) continue;
+        for (int cy = 0; cy < grid->rows[level]; cy++) {
+            for (int cx = 0; cx < grid->cols[level]; cx++) {
+                if (!pair_cell(grid, level, cx, cy, out)) return;
+            }
+        }
+    }
+}
+
+void hgrid_stats(HierarchicalGrid* grid, SpatialStats* stats) {
+    hgrid_prepare(grid);
+
+    // Cells of every level in use
+    stats->total_cells = grid->cell_count;
+    stats->total_entities = grid->entry_count;
+    stats->moved_entities = grid->moved;
+
+    for (int c = 0; c < grid->cell_count; c++) {
+        int n = grid->cell_start[c + 1] - grid->cell_start[c];
+        if (n == 0) continue;
+        stats->occupied_cells++;
+        if (n > stats->max_per_cell) stats->max_per_cell = n;
+    }
+    if (stats->occupied_cells > 0) {
+        stats->avg_per_cell = (float)grid->entry_count / (float)stats->occupied_cells;
+    }
+}
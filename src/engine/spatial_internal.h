@@ -0,0 +1,318 @@
+// spatial_internal.h — Shared pieces of the spatial backends (not part of the public API)
+//
+// spatial.c owns the SpatialIndex dispatch and the grid/hash backends;
+// other backends live in their own spatial_*.c file and are declared here.
+//
+#ifndef SPATIAL_INTERNAL_H
+#define SPATIAL_INTERNAL_H
+
+#include "spatial.h"
+#include <stddef.h>
+
+// --- SHARED HELPERS (spatial.c) ---
+
+// Grow a buffer to hold at least 'needed' elements (doubling; never shrinks)
+int spatial_grow_buffer(void** buffer, int* capacity, int needed, size_t elem_size);
+
+// Append a pair, growing the buffer if needed; returns 0 if out of memory
+int spatial_pair_push(SpatialPairList* out, Entity* a, Entity* b);
+
+// AABB of an entity's collider
+void spatial_entity_bounds(Entity* e, float* out_min_x, float* out_min_y,
+                           float* out_max_x, float* out_max_y);
+
+// Would these two colliders interact at all? (either one's mask hits the other's layer)
+static inline int layers_interact(uint32_t layer_a, uint32_t mask_a, uint32_t layer_b, uint32_t mask_b) {
+    return (mask_a & layer_b) || (mask_b & layer_a);
+}
+
+static inline int aabb_overlap(float a_min_x, float a_min_y, float a_max_x, float a_max_y,
+                               float b_min_x, float b_min_y, float b_max_x, float b_max_y) {
+    return a_min_x <= b_max_x && b_min_x <= a_max_x &&
+           a_min_y <= b_max_y && b_min_y <= a_max_y;
+}
+
+// Does the segment (x0, y0) + t * (dx, dy), t in [0, 1], touch the AABB? (slab test)
+static inline int segment_hits_aabb(float x0, float y0, float dx, float dy,
+                                    float min_x, float min_y, float max_x, float max_y) {
+    float t_min = 0.0f, t_max = 1.0f;
+
+    if (dx != 0.0f) {
+        float inv = 1.0f / dx;
+        float t1 = (min_x - x0) * inv, t2 = (max_x - x0) * inv;
+        if (t1 > t2) { float t = t1; t1 = t2; t2 = t; }
+        if (t1 > t_min) t_min = t1;
+        if (t2 < t_max) t_max = t2;
+    } else if (x0 < min_x || x0 > max_x) {
+        return 0;
+    }
+
+    if (dy != 0.0f) {
+        float inv = 1.0f / dy;
+        float t1 = (min_y - y0) * inv, t2 = (max_y - y0) * inv;
+        if (t1 > t2) { float t = t1; t1 = t2; t2 = t; }
+        if (t1 > t_min) t_min = t1;
+        if (t2 < t_max) t_max = t2;
+    } else if (y0 < min_y || y0 > max_y) {
+        return 0;
+    }
+
+    return t_min <= t_max;
+}
+
+// --- LOOSE QUADTREE (spatial_quadtree.c) ---
+
+typedef struct {
+    Entity* entity;
+    EntityHandle id;        // Detects a recycled entity slot
+    float min_x, min_y;     // Collider AABB
+    float max_x, max_y;
+    uint32_t layer, mask;
+    int node;               // Node holding this object
+    int prev, next;         // Links in the node's object list (-1 = none)
+    unsigned int seen;      // Frame this object was last inserted
+} QuadObject;
+
+typedef struct {
+    float cx, cy;           // Center
+    float half;             // Half size of the tight cell (loose bounds are 2x)
+    int depth;
+    int parent;             // -1 for the root
+    int children[4];        // -1 = not allocated; children[0] doubles as the free-list link
+    int first_object;       // Head of this node's object list
+    int object_count;       // Objects in this node
+    int subtree_count;      // Objects in this node and below (empty subtrees are pruned)
+    float min_x, min_y;     // Tight AABB of every object in the subtree (refreshed before
+    float max_x, max_y;     // queries; traversals cull with it instead of the loose bounds)
+} QuadNode;
+
+typedef struct {
+    QuadNode* nodes;        // Node pool (index 0 is the root)
+    int node_capacity;
+    int node_count;         // Nodes in use
+    int free_node;          // Pool free list (-1 = empty)
+
+    QuadObject* objects;    // Dense, swap-remove
+    int object_count;
+    int object_capacity;
+
+    int* object_of_slot;    // Entity slot index -> object index (-1 = none)
+    int slot_capacity;
+
+    float root_size;        // Full size of the root cell (world is [0, root_size)^2)
+    int max_depth;
+
+    unsigned int frame;     // Bumped by clear; objects not re-inserted are swept
+    int sweep_pending;
+    int bounds_dirty;       // Objects inserted/removed since the subtree bounds were refreshed
+
+    int reinserted;         // Objects that changed node since the last clear
+} LooseQuadtree;
+
+int  quadtree_init(LooseQuadtree* tree, SpatialConfig config);
+void quadtree_free(LooseQuadtree* tree);
+void quadtree_clear(LooseQuadtree* tree);
+void quadtree_insert(LooseQuadtree* tree, Entity* entity,
+                     float min_x, float min_y, float max_x, float max_y);
+void quadtree_remove(LooseQuadtree* tree, Entity* entity);
+int  quadtree_query(LooseQuadtree* tree, Entity* self,
+                    float min_x, float min_y, float max_x, float max_y,
+                    Entity** out, int max_out, int* dropped);
+void quadtree_find_pairs(LooseQuadtree* tree, SpatialPairList* out);
+void quadtree_stats(LooseQuadtree* tree, SpatialStats* stats);
+
+// --- SWEEP AND PRUNE (spatial_sap.c) ---
+
+typedef struct {
+    float value;
+    int data;               // Proxy index * 2, +1 for a max endpoint
+} SapEndpoint;
+
+typedef struct {
+    Entity* entity;
+    EntityHandle id;        // Detects a recycled entity slot
+    float min_x, min_y;     // Collider AABB
+    float max_x, max_y;
+    uint32_t layer, mask;
+    unsigned int seen;      // Frame this proxy was last inserted
+    int dead;               // Slot was recycled; dropped by the next sweep
+} SapProxy;
+
+typedef struct {
+    SapProxy* proxies;
+    int proxy_count;
+    int proxy_capacity;
+    int sorted_count;       // Proxies [0, sorted_count) have endpoints in the axis lists
+
+    int* proxy_of_slot;     // Entity slot index -> proxy index (-1 = none)
+    int slot_capacity;
+
+    SapEndpoint* axis[2];   // Endpoints sorted along x and y (2 per proxy)
+    int axis_capacity[2];
+    float max_width;        // Widest proxy along x (bounds the query scan window)
+
+    unsigned long long* pair_keys;  // Overlapping proxy pairs (open addressing, power-of-two size)
+    int pair_capacity;
+    int pair_count;
+
+    int* scratch;           // Remap table for sweeps / active list for full rebuilds
+    int scratch_capacity;
+
+    unsigned int frame;     // Bumped by clear; proxies not re-inserted are swept
+    int sweep_pending;
+    int dirty;              // Inserts since the endpoints were last sorted
+
+    int moved;              // Proxies whose bounds changed since the last clear
+} SweepAndPrune;
+
+int  sap_init(SweepAndPrune* sap);
+void sap_free(SweepAndPrune* sap);
+void sap_clear(SweepAndPrune* sap);
+void sap_insert(SweepAndPrune* sap, Entity* entity,
+                float min_x, float min_y, float max_x, float max_y);
+void sap_remove(SweepAndPrune* sap, Entity* entity);
+int  sap_query(SweepAndPrune* sap, Entity* self,
+               float min_x, float min_y, float max_x, float max_y,
+               Entity** out, int max_out, int* dropped);
+void sap_find_pairs(SweepAndPrune* sap, SpatialPairList* out);
+void sap_stats(SweepAndPrune* sap, SpatialStats* stats);
+
+// --- DYNAMIC AABB TREE (spatial_bvh.c) ---
+
+typedef struct {
+    float min_x, min_y;     // Fat AABB: a leaf's collider AABB plus margin, or the
+    float max_x, max_y;     // union of both children for an internal node
+    int parent;             // -1 for the root; doubles as the free-list link
+    int child1, child2;     // -1 for a leaf
+    int height;             // 0 for a leaf, -1 for a free node
+    int leaf;               // Leaf nodes: index into leaves[]
+} BvhNode;
+
+typedef struct {
+    Entity* entity;
+    EntityHandle id;        // Detects a recycled entity slot
+    float min_x, min_y;     // Collider AABB (the node holds the fattened one)
+    float max_x, max_y;
+    uint32_t layer, mask;
+    int node;               // Leaf node in the tree
+    int linked;             // 0 while waiting to be (re)linked by the next query
+    unsigned int seen;      // Frame this leaf was last inserted
+} BvhLeaf;
+
+// Leaf box copied out for a bulk build
+typedef struct {
+    float min_x, min_y, max_x, max_y;
+    float cx, cy;           // Center, doubled
+    int node;
+    int bin;
+} BvhBuildRef;
+
+typedef struct {
+    BvhNode* nodes;         // Node pool
+    int node_capacity;
+    int node_count;         // Nodes in use
+    int free_node;          // Pool free list (-1 = empty)
+    int root;               // -1 = empty tree
+
+    BvhLeaf* leaves;        // Dense, swap-remove
+    int leaf_count;
+    int leaf_capacity;
+
+    int* leaf_of_slot;      // Entity slot index -> leaf index (-1 = none)
+    int slot_capacity;
+
+    int* stack;             // Traversal stack (sized from the root height)
+    int stack_capacity;
+
+    BvhBuildRef* refs;      // Scratch for bulk builds
+    int ref_capacity;
+
+    float margin;           // Fattening added around each collider AABB
+
+    unsigned int frame;     // Bumped by clear; leaves not re-inserted are swept
+    int sweep_pending;
+    int pending;            // Leaves not linked into the tree yet
+
+    int reinserted;         // Leaves that left their fat AABB since the last clear
+} AabbTree;
+
+int  bvh_init(AabbTree* tree, SpatialConfig config);
+void bvh_free(AabbTree* tree);
+void bvh_clear(AabbTree* tree);
+void bvh_insert(AabbTree* tree, Entity* entity,
+                float min_x, float min_y, float max_x, float max_y);
+void bvh_remove(AabbTree* tree, Entity* entity);
+int  bvh_query(AabbTree* tree, Entity* self,
+               float min_x, float min_y, float max_x, float max_y,
+               Entity** out, int max_out, int* dropped);
+int  bvh_query_segment(AabbTree* tree, float x0, float y0, float x1, float y1,
+                       Entity** out, int max_out, int* dropped);
+void bvh_find_pairs(AabbTree* tree, SpatialPairList* out);
+void bvh_stats(AabbTree* tree, SpatialStats* stats);
+
+// --- HIERARCHICAL GRID (spatial_hgrid.c) ---
+
+#define HGRID_LEVELS 32     // Cell size doubles per level; one bit each in HierarchicalGrid.occupied
+
+typedef struct {
+    Entity* entity;
+    EntityHandle id;        // Detects a recycled entity slot
+    unsigned int seen;      // Frame this entry was last inserted
+    float min_x, min_y;     // Collider AABB
+    float max_x, max_y;
+    uint32_t layer, mask;
+    int size_level;         // Smallest level whose cells are at least as big as the collider
+    int level;              // Level it is stored on (size_level, or coarser if that one was too sparse)
+    int cx, cy;             // Cell holding the AABB center on that level
+    int bucket;             // Index of that cell in cell_start
+} HGridEntry;
+
+typedef struct {
+    float cell_size[HGRID_LEVELS];
+    float inv_cell_size[HGRID_LEVELS];
+    float reach[HGRID_LEVELS];      // Largest half extent stored per level (query padding)
+    int promote[HGRID_LEVELS];      // Size level -> level its entries are stored on
+
+    // Each level is a dense grid over the cells its entries covered at the last build
+    int origin_x[HGRID_LEVELS];     // First column / row
+    int origin_y[HGRID_LEVELS];
+    int cols[HGRID_LEVELS];         // 0 = level not in use
+    int rows[HGRID_LEVELS];
+    int first_cell[HGRID_LEVELS];   // Offset of the level's cells in cell_start
+    int capped[HGRID_LEVELS];       // Top level too sparse even so: far entries are clamped to its border
+    uint32_t occupied;              // Bit L set = level L holds entries
+    int level_start[HGRID_LEVELS + 1];  // Level L owns level_items[level_start[L] .. level_start[L+1])
+    int* level_items;               // Entry indices grouped by level
+    int level_item_capacity;
+
+    HGridEntry* entries;    // Live entries (swap-remove)
+    int entry_count;
+    int entry_capacity;
+    int* entry_of_slot;     // Entity slot index -> entry index (-1 = none)
+    int entry_slot_capacity;
+
+    int* cell_start;        // cell_count + 1 offsets (CSR, all levels back to back)
+    int cell_count;
+    int cell_capacity;
+    int* cell_items;        // Entry indices grouped by cell
+    int item_capacity;
+
+    unsigned int frame;     // Bumped by clear; entries not re-inserted are swept
+    int sweep_pending;
+    int dirty;              // An entry appeared, disappeared or changed cell since the last build
+    int moved;              // Entries whose cell changed since the last clear
+} HierarchicalGrid;
+
+int  hgrid_init(HierarchicalGrid* grid, SpatialConfig config);
+void hgrid_free(HierarchicalGrid* grid);
+void hgrid_clear(HierarchicalGrid* grid);
+void hgrid_insert(HierarchicalGrid* grid, Entity* entity,
+                  float min_x, float min_y, float max_x, float max_y);
+void hgrid_remove(HierarchicalGrid* grid, Entity* entity);
+int  hgrid_query(HierarchicalGrid* grid, Entity* self,
+                 float min_x, float min_y, float max_x, float max_y,
+                 Entity** out, int max_out, int* dropped);
+void hgrid_find_pairs(HierarchicalGrid* grid, SpatialPairList* out);
+void hgrid_stats(HierarchicalGrid* grid, SpatialStats* stats);
+
+#endif
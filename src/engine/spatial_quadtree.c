@@ -0,0 +1,511 @@
+// spatial_quadtree.c — Loose quadtree backend (SPATIAL_TYPE_QUADTREE)
+//
+// Each object lives in exactly one node: the deepest one whose cell is at least
+// as big as the object, picked by the object's center. A node's loose bounds are
+// twice its cell, so an object stays put while it wanders within them, and is only
+// unlinked/relinked once it leaves them (or shrinks enough to fit a level deeper).
+//
+// Objects persist across frames, keyed by entity slot. spatial_clear starts a new
+// frame; anything not re-inserted before the next query is swept out. Nodes come
+// from a pool with a free list, and empty subtrees are returned to it.
+//
+// Loose bounds of neighbouring nodes overlap a lot, so queries and pair finding
+// cull with each subtree's tight AABB instead, refreshed in one pass per frame.
+//
+// Measured ("bench mixed": 20000 16px + 8 512px colliders), this beats a grid
+// sized to the big colliders (~5.5 vs ~10 ms per frame) but NOT a fine grid sized
+// to the small ones, nor HGRID (~2.5 ms each): the CSR grid has no per-cell cap,
+// so a few big colliders spanning many cells are cheap. Prefer the fine grid or
+// HGRID for mixed sizes; don't pick this backend expecting a win there.
+//
+
+#include "spatial_internal.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define QUADTREE_DEFAULT_DEPTH 8
+#define QUADTREE_MAX_DEPTH 20
+
+// --- NODES ---
+
+static int node_alloc(LooseQuadtree* tree, int parent, float cx, float cy, float half, int depth) {
+    int n = tree->free_node;
+    if (n >= 0) {
+        tree->free_node = tree->nodes[n].children[0];
+    } else {
+        int used = tree->node_capacity;
+        if (!spatial_grow_buffer((void**)&tree->nodes, &tree->node_capacity, used + 1, sizeof(QuadNode))) {
+            return -1;
+        }
+        // Thread the new tail onto the free list (slot 'used' is taken right away)
+        for (int i = tree->node_capacity - 1; i > used; i--) {
+            tree->nodes[i].depth = -1;
+            tree->nodes[i].children[0] = tree->free_node;
+            tree->free_node = i;
+        }
+        n = used;
+    }
+
+    QuadNode* node = &tree->nodes[n];
+    node->cx = cx;
+    node->cy = cy;
+    node->half = half;
+    node->depth = depth;
+    node->parent = parent;
+    node->children[0] = node->children[1] = node->children[2] = node->children[3] = -1;
+    node->first_object = -1;
+    node->object_count = 0;
+    node->subtree_count = 0;
+    tree->node_count++;
+    return n;
+}
+
+static void node_release(LooseQuadtree* tree, int n) {
+    tree->nodes[n].depth = -1;  // Marks the slot as free for the stats walk
+    tree->nodes[n].children[0] = tree->free_node;
+    tree->free_node = n;
+    tree->node_count--;
+}
+
+// Quadrant of (x, y) within node n: bit 0 = right half, bit 1 = bottom half
+static inline int node_quadrant(QuadNode* node, float x, float y) {
+    return (x >= node->cx ? 1 : 0) | (y >= node->cy ? 2 : 0);
+}
+
+// Is the AABB inside the node's loose bounds? (the root takes anything)
+static inline int node_contains(QuadNode* node, int n, QuadObject* o) {
+    if (n == 0) return 1;
+    float r = node->half * 2.0f;
+    return o->min_x >= node->cx - r && o->max_x <= node->cx + r &&
+           o->min_y >= node->cy - r && o->max_y <= node->cy + r;
+}
+
+// Would the child on the object's side of node n hold it? (loose half = node->half)
+static inline int child_contains(QuadNode* node, QuadObject* o, float x, float y) {
+    float q = node->half * 0.5f;
+    float ccx = node->cx + (x >= node->cx ? q : -q);
+    float ccy = node->cy + (y >= node->cy ? q : -q);
+    float r = node->half;
+    return o->min_x >= ccx - r && o->max_x <= ccx + r &&
+           o->min_y >= ccy - r && o->max_y <= ccy + r;
+}
+
+// Deepest level whose cells are at least as large as the object
+static int depth_for_size(LooseQuadtree* tree, QuadObject* o) {
+    float w = o->max_x - o->min_x;
+    float h = o->max_y - o->min_y;
+    float extent = (w > h) ? w : h;
+
+    int depth = 0;
+    float size = tree->root_size;
+    while (depth < tree->max_depth && extent <= size * 0.5f) {
+        size *= 0.5f;
+        depth++;
+    }
+    return depth;
+}
+
+// --- OBJECT LISTS ---
+
+static void object_link(LooseQuadtree* tree, int k, int n) {
+    QuadObject* o = &tree->objects[k];
+    QuadNode* node = &tree->nodes[n];
+
+    o->node = n;
+    o->prev = -1;
+    o->next = node->first_object;
+    if (node->first_object >= 0) tree->objects[node->first_object].prev = k;
+    node->first_object = k;
+    node->object_count++;
+
+    for (int p = n; p >= 0; p = tree->nodes[p].parent) {
+        tree->nodes[p].subtree_count++;
+    }
+}
+
+static void object_unlink(LooseQuadtree* tree, int k) {
+    QuadObject* o = &tree->objects[k];
+    int n = o->node;
+    if (n < 0) return;
+
+    if (o->prev >= 0) tree->objects[o->prev].next = o->next;
+    else tree->nodes[n].first_object = o->next;
+    if (o->next >= 0) tree->objects[o->next].prev = o->prev;
+    tree->nodes[n].object_count--;
+    o->node = -1;
+
+    // Walk up, handing emptied subtrees back to the pool
+    while (n >= 0) {
+        QuadNode* node = &tree->nodes[n];
+        int parent = node->parent;
+        if (--node->subtree_count == 0 && parent >= 0) {
+            QuadNode* p = &tree->nodes[parent];
+            for (int c = 0; c < 4; c++) {
+                if (p->children[c] == n) p->children[c] = -1;
+            }
+            node_release(tree, n);
+        }
+        n = parent;
+    }
+}
+
+// Descend from the root to the object's node, creating nodes on the way
+// Stops early if the next child's loose bounds can't hold it (e.g. outside the world)
+static int object_place(LooseQuadtree* tree, QuadObject* o) {
+    float x = (o->min_x + o->max_x) * 0.5f;
+    float y = (o->min_y + o->max_y) * 0.5f;
+    int target = depth_for_size(tree, o);
+
+    int n = 0;
+    while (tree->nodes[n].depth < target) {
+        QuadNode* node = &tree->nodes[n];
+        if (!child_contains(node, o, x, y)) break;
+
+        int q = node_quadrant(node, x, y);
+        int child = node->children[q];
+        if (child < 0) {
+            float h = node->half * 0.5f;
+            float ccx = node->cx + ((q & 1) ? h : -h);
+            float ccy = node->cy + ((q & 2) ? h : -h);
+            child = node_alloc(tree, n, ccx, ccy, h, node->depth + 1);
+            if (child < 0) break;  // Out of memory: keep it in the parent
+            tree->nodes[n].children[q] = child;
+        }
+        n = child;
+    }
+    return n;
+}
+
+// Can the object stay in its node? It must still be inside the loose bounds, and
+// must not fit a level deeper (a grown object may stay in a deeper node)
+static int object_fits(LooseQuadtree* tree, QuadObject* o) {
+    QuadNode* node = &tree->nodes[o->node];
+    if (!node_contains(node, o->node, o)) return 0;
+    if (node->depth >= depth_for_size(tree, o)) return 1;
+
+    float x = (o->min_x + o->max_x) * 0.5f;
+    float y = (o->min_y + o->max_y) * 0.5f;
+    return !child_contains(node, o, x, y);
+}
+
+// Swap-remove object k
+static void object_remove(LooseQuadtree* tree, int k) {
+    object_unlink(tree, k);
+    tree->object_of_slot[ENTITY_HANDLE_INDEX(tree->objects[k].id)] = -1;
+
+    int last = --tree->object_count;
+    if (k == last) return;
+
+    QuadObject* o = &tree->objects[k];
+    *o = tree->objects[last];
+    if (o->node >= 0) {
+        if (o->prev >= 0) tree->objects[o->prev].next = k;
+        else tree->nodes[o->node].first_object = k;
+        if (o->next >= 0) tree->objects[o->next].prev = k;
+    }
+    tree->object_of_slot[ENTITY_HANDLE_INDEX(o->id)] = k;
+}
+
+// Drop objects that weren't re-inserted since the last clear
+static void quadtree_sweep(LooseQuadtree* tree) {
+    for (int k = tree->object_count - 1; k >= 0; k--) {
+        if (tree->objects[k].seen != tree->frame) object_remove(tree, k);
+    }
+    tree->sweep_pending = 0;
+}
+
+// Recompute the tight subtree bounds (post-order; empty nodes get inverted bounds)
+static void refresh_bounds(LooseQuadtree* tree, int n) {
+    QuadNode* node = &tree->nodes[n];
+    float min_x = INFINITY, min_y = INFINITY;
+    float max_x = -INFINITY, max_y = -INFINITY;
+
+    for (int k = node->first_object; k >= 0; k = tree->objects[k].next) {
+        QuadObject* o = &tree->objects[k];
+        if (o->min_x < min_x) min_x = o->min_x;
+        if (o->min_y < min_y) min_y = o->min_y;
+        if (o->max_x > max_x) max_x = o->max_x;
+        if (o->max_y > max_y) max_y = o->max_y;
+    }
+    for (int c = 0; c < 4; c++) {
+        int child = node->children[c];
+        if (child < 0) continue;
+        refresh_bounds(tree, child);
+        QuadNode* cn = &tree->nodes[child];
+        if (cn->min_x < min_x) min_x = cn->min_x;
+        if (cn->min_y < min_y) min_y = cn->min_y;
+        if (cn->max_x > max_x) max_x = cn->max_x;
+        if (cn->max_y > max_y) max_y = cn->max_y;
+    }
+    node->min_x = min_x;
+    node->min_y = min_y;
+    node->max_x = max_x;
+    node->max_y = max_y;
+}
+
+// Bring the tree up to date before reading it
+static void quadtree_prepare(LooseQuadtree* tree) {
+    if (tree->sweep_pending) quadtree_sweep(tree);
+    if (tree->bounds_dirty) {
+        refresh_bounds(tree, 0);
+        tree->bounds_dirty = 0;
+    }
+}
+
+// --- BACKEND API ---
+
+int quadtree_init(LooseQuadtree* tree, SpatialConfig config) {
+    memset(tree, 0, sizeof(*tree));
+    tree->free_node = -1;
+
+    tree->root_size = (config.world_width > config.world_height) ? config.world_width : config.world_height;
+    if (tree->root_size <= 0.0f) return 0;
+
+    tree->max_depth = (config.quadtree_depth > 0) ? config.quadtree_depth : QUADTREE_DEFAULT_DEPTH;
+    if (tree->max_depth > QUADTREE_MAX_DEPTH) tree->max_depth = QUADTREE_MAX_DEPTH;
+
+    float half = tree->root_size * 0.5f;
+    if (node_alloc(tree, -1, half, half, half, 0) != 0) {
+        free(tree->nodes);
+        return 0;
+    }
+    tree->frame = 1;
+    return 1;
+}
+
+void quadtree_free(LooseQuadtree* tree) {
+    free(tree->nodes);
+    free(tree->objects);
+    free(tree->object_of_slot);
+    memset(tree, 0, sizeof(*tree));
+}
+
+void quadtree_clear(LooseQuadtree* tree) {
+    if (++tree->frame == 0) {
+        // Wrapped: zero every mark so none can match the new frame
+        for (int k = 0; k < tree->object_count; k++) tree->objects[k].seen = 0;
+        tree->frame = 1;
+    }
+    tree->sweep_pending = 1;
+    tree->bounds_dirty = 1;
+    tree->reinserted = 0;
+}
+
+void quadtree_insert(LooseQuadtree* tree, Entity* entity,
+                     float min_x, float min_y, float max_x, float max_y) {
+    int slot = (int)ENTITY_HANDLE_INDEX(entity->id);
+
+    if (slot >= tree->slot_capacity) {
+        int old = tree->slot_capacity;
+        if (!spatial_grow_buffer((void**)&tree->object_of_slot, &tree->slot_capacity, slot + 1, sizeof(int))) {
+            return;
+        }
+        for (int i = old; i < tree->slot_capacity; i++) tree->object_of_slot[i] = -1;
+    }
+
+    int k = tree->object_of_slot[slot];
+    if (k >= 0 && tree->objects[k].id != entity->id) {
+        // Slot was recycled by a different entity
+        object_remove(tree, k);
+        k = -1;
+    }
+    if (k < 0) {
+        if (!spatial_grow_buffer((void**)&tree->objects, &tree->object_capacity,
+                                 tree->object_count + 1, sizeof(QuadObject))) {
+            return;
+        }
+        k = tree->object_count++;
+        tree->objects[k].id = entity->id;
+        tree->objects[k].node = -1;
+        tree->object_of_slot[slot] = k;
+    }
+
+    QuadObject* o = &tree->objects[k];
+    o->entity = entity;
+    o->min_x = min_x;
+    o->min_y = min_y;
+    o->max_x = max_x;
+    o->max_y = max_y;
+    o->layer = entity->collider.layer;
+    o->mask = entity->collider.mask;
+    o->seen = tree->frame;
+    tree->bounds_dirty = 1;
+
+    if (o->node >= 0 && object_fits(tree, o)) return;
+
+    object_unlink(tree, k);
+    int n = object_place(tree, o);  // May grow the node pool (o stays valid)
+    object_link(tree, k, n);
+    tree->reinserted++;
+}
+
+void quadtree_remove(LooseQuadtree* tree, Entity* entity) {
+    int slot = (int)ENTITY_HANDLE_INDEX(entity->id);
+    if (slot >= tree->slot_capacity) return;
+
+    int k = tree->object_of_slot[slot];
+    if (k < 0 || tree->objects[k].id != entity->id) return;
+    object_remove(tree, k);
+    tree->bounds_dirty = 1;
+}
+
+// Traversals visit only nodes whose subtree bounds (the tight AABB of everything
+// below them) overlap the box, using an explicit stack (at most 3 siblings wait per level)
+#define QUADTREE_STACK_SIZE (3 * QUADTREE_MAX_DEPTH + 4)
+
+// Objects sit in one node only, so no de-duplication is needed
+int quadtree_query(LooseQuadtree* tree, Entity* self,
+                   float min_x, float min_y, float max_x, float max_y,
+                   Entity** out, int max_out, int* dropped) {
+    quadtree_prepare(tree);
+
+    int count = 0;
+    int stack[QUADTREE_STACK_SIZE];
+    int top = 0;
+    stack[top++] = 0;
+
+    while (top > 0) {
+        QuadNode* node = &tree->nodes[stack[--top]];
+        if (!aabb_overlap(min_x, min_y, max_x, max_y,
+                          node->min_x, node->min_y, node->max_x, node->max_y)) continue;
+
+        for (int k = node->first_object; k >= 0; k = tree->objects[k].next) {
+            QuadObject* o = &tree->objects[k];
+            if (o->entity == self) continue;
+            if (!aabb_overlap(min_x, min_y, max_x, max_y, o->min_x, o->min_y, o->max_x, o->max_y)) continue;
+
+            if (count < max_out) {
+                out[count++] = o->entity;
+            } else {
+                (*dropped)++;  // Keep scanning so the caller sees the real shortfall
+            }
+        }
+
+        for (int c = 0; c < 4; c++) {
+            if (node->children[c] >= 0) stack[top++] = node->children[c];
+        }
+    }
+
+    return count;
+}
+
+// --- PAIRS ---
+// Dual traversal: self(N) pairs up a subtree, cross(A, B) pairs two disjoint
+// same-depth subtrees. Node pairs whose subtree bounds don't overlap are pruned
+// as a whole, and each object pair is visited exactly once.
+
+static inline int bounds_overlap(QuadNode* a, QuadNode* b) {
+    return aabb_overlap(a->min_x, a->min_y, a->max_x, a->max_y,
+                        b->min_x, b->min_y, b->max_x, b->max_y);
+}
+
+// Returns 0 if the pair buffer could not grow
+static inline int pair_test(QuadObject* a, QuadObject* b, SpatialPairList* out) {
+    if (!layers_interact(a->layer, a->mask, b->layer, b->mask)) return 1;
+    if (!aabb_overlap(a->min_x, a->min_y, a->max_x, a->max_y,
+                      b->min_x, b->min_y, b->max_x, b->max_y)) return 1;
+    return spatial_pair_push(out, a->entity, b->entity);
+}
+
+// One object against everything under node 'start'
+static int pairs_object_subtree(LooseQuadtree* tree, QuadObject* a, int start, SpatialPairList* out) {
+    int stack[QUADTREE_STACK_SIZE];
+    int top = 0;
+    stack[top++] = start;
+
+    while (top > 0) {
+        QuadNode* node = &tree->nodes[stack[--top]];
+        if (!aabb_overlap(a->min_x, a->min_y, a->max_x, a->max_y,
+                          node->min_x, node->min_y, node->max_x, node->max_y)) continue;
+
+        for (int j = node->first_object; j >= 0; j = tree->objects[j].next) {
+            if (!pair_test(a, &tree->objects[j], out)) return 0;
+        }
+        for (int c = 0; c < 4; c++) {
+            if (node->children[c] >= 0) stack[top++] = node->children[c];
+        }
+    }
+    return 1;
+}
+
+// A node's own objects against all of its children's subtrees
+static int pairs_objects_children(LooseQuadtree* tree, int n, int other, SpatialPairList* out) {
+    for (int i = tree->nodes[n].first_object; i >= 0; i = tree->objects[i].next) {
+        for (int c = 0; c < 4; c++) {
+            int child = tree->nodes[other].children[c];
+            if (child >= 0 && !pairs_object_subtree(tree, &tree->objects[i], child, out)) return 0;
+        }
+    }
+    return 1;
+}
+
+// Every pair between the subtrees of a and b (same depth, bounds overlap)
+static int pairs_cross(LooseQuadtree* tree, int a, int b, SpatialPairList* out) {
+    for (int i = tree->nodes[a].first_object; i >= 0; i = tree->objects[i].next) {
+        for (int j = tree->nodes[b].first_object; j >= 0; j = tree->objects[j].next) {
+            if (!pair_test(&tree->objects[i], &tree->objects[j], out)) return 0;
+        }
+    }
+    if (!pairs_objects_children(tree, a, b, out)) return 0;
+    if (!pairs_objects_children(tree, b, a, out)) return 0;
+
+    for (int ca = 0; ca < 4; ca++) {
+        int child_a = tree->nodes[a].children[ca];
+        if (child_a < 0) continue;
+        for (int cb = 0; cb < 4; cb++) {
+            int child_b = tree->nodes[b].children[cb];
+            if (child_b < 0 || !bounds_overlap(&tree->nodes[child_a], &tree->nodes[child_b])) continue;
+            if (!pairs_cross(tree, child_a, child_b, out)) return 0;
+        }
+    }
+    return 1;
+}
+
+// Every pair within the subtree of n
+static int pairs_self(LooseQuadtree* tree, int n, SpatialPairList* out) {
+    for (int i = tree->nodes[n].first_object; i >= 0; i = tree->objects[i].next) {
+        for (int j = tree->objects[i].next; j >= 0; j = tree->objects[j].next) {
+            if (!pair_test(&tree->objects[i], &tree->objects[j], out)) return 0;
+        }
+    }
+    if (!pairs_objects_children(tree, n, n, out)) return 0;
+
+    for (int c = 0; c < 4; c++) {
+        int child = tree->nodes[n].children[c];
+        if (child < 0) continue;
+        if (!pairs_self(tree, child, out)) return 0;
+
+        for (int d = c + 1; d < 4; d++) {
+            int other = tree->nodes[n].children[d];
+            if (other < 0 || !bounds_overlap(&tree->nodes[child], &tree->nodes[other])) continue;
+            if (!pairs_cross(tree, child, other, out)) return 0;
+        }
+    }
+    return 1;
+}
+
+void quadtree_find_pairs(LooseQuadtree* tree, SpatialPairList* out) {
+    quadtree_prepare(tree);
+    pairs_self(tree, 0, out);
+}
+
+void quadtree_stats(LooseQuadtree* tree, SpatialStats* stats) {
+    quadtree_prepare(tree);
+
+    stats->total_cells = tree->node_count;
+    stats->total_entities = tree->object_count;
+    stats->moved_entities = tree->reinserted;
+
+    int total_in_occupied = 0;
+    for (int n = 0; n < tree->node_capacity; n++) {
+        QuadNode* node = &tree->nodes[n];
+        if (node->depth < 0 || node->object_count == 0) continue;
+        stats->occupied_cells++;
+        total_in_occupied += node->object_count;
+        if (node->object_count > stats->max_per_cell) stats->max_per_cell = node->object_count;
+    }
+    if (stats->occupied_cells > 0) {
+        stats->avg_per_cell = (float)total_in_occupied / (float)stats->occupied_cells;
+    }
+}
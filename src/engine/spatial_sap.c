@@ -0,0 +1,467 @@
+// spatial_sap.c — Sweep and prune backend (SPATIAL_TYPE_SAP)
+//
+// Every proxy has a min and a max endpoint on each axis, kept in two sorted
+// lists that persist across frames. After the bounds change, each list is
+// re-sorted with insertion sort, which is near O(n) when bodies move a little
+// per step. Every swap is an event: a min passing a max means two boxes may have
+// started overlapping, a max passing a min means they separated. Events keep a
+// persistent set of overlapping pairs up to date, and spatial_find_pairs just
+// reads that set.
+//
+// Proxies are keyed by entity slot like the quadtree's objects: spatial_clear
+// starts a new frame and proxies not re-inserted before the next query are swept.
+// Big changes (many new proxies, or motion large enough to make insertion sort
+// expensive) fall back to a full sort and one sweep along x.
+//
+
+#include "spatial_internal.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define SAP_PAIR_EMPTY 0xFFFFFFFFFFFFFFFFull
+
+// New proxies per frame above which a full rebuild beats inserting them one by one
+#define SAP_REBUILD_NEW 64
+
+// Insertion-sort swaps allowed per endpoint before giving up on coherence
+#define SAP_SWAP_BUDGET 16
+
+// --- PAIR SET ---
+// Linear probing with backward-shift deletion (no tombstones), kept under 50% load
+
+static inline unsigned long long pair_key(int a, int b) {
+    if (a > b) { int t = a; a = b; b = t; }
+    return ((unsigned long long)(unsigned int)a << 32) | (unsigned int)b;
+}
+
+static inline unsigned int pair_hash(unsigned long long key) {
+    key ^= key >> 31;
+    key *= 0xBF58476D1CE4E5B9ull;
+    key ^= key >> 29;
+    return (unsigned int)key;
+}
+
+// Allocate an empty table of 'capacity' slots (power of two)
+static int pairs_alloc(SweepAndPrune* sap, int capacity) {
+    unsigned long long* keys = malloc((size_t)capacity * sizeof(unsigned long long));
+    if (!keys) return 0;
+    memset(keys, 0xFF, (size_t)capacity * sizeof(unsigned long long));
+    free(sap->pair_keys);
+    sap->pair_keys = keys;
+    sap->pair_capacity = capacity;
+    sap->pair_count = 0;
+    return 1;
+}
+
+static void pairs_put(SweepAndPrune* sap, unsigned long long key) {
+    unsigned int mask = (unsigned int)sap->pair_capacity - 1;
+    unsigned int i = pair_hash(key) & mask;
+    while (sap->pair_keys[i] != SAP_PAIR_EMPTY) {
+        if (sap->pair_keys[i] == key) return;
+        i = (i + 1) & mask;
+    }
+    sap->pair_keys[i] = key;
+    sap->pair_count++;
+}
+
+// Re-insert every pair into a fresh table, renumbering proxies through 'remap'
+// (pairs with a removed proxy are dropped); remap == NULL keeps the numbers
+static int pairs_rehash(SweepAndPrune* sap, int capacity, const int* remap) {
+    unsigned long long* old = sap->pair_keys;
+    int old_capacity = sap->pair_capacity;
+
+    sap->pair_keys = NULL;
+    if (!pairs_alloc(sap, capacity)) {
+        sap->pair_keys = old;
+        sap->pair_capacity = old_capacity;
+        return 0;
+    }
+
+    for (int i = 0; i < old_capacity; i++) {
+        unsigned long long key = old[i];
+        if (key == SAP_PAIR_EMPTY) continue;
+        if (remap) {
+            int a = remap[key >> 32];
+            int b = remap[key & 0xFFFFFFFFu];
+            if (a < 0 || b < 0) continue;
+            key = pair_key(a, b);
+        }
+        pairs_put(sap, key);
+    }
+    free(old);
+    return 1;
+}
+
+static void pairs_add(SweepAndPrune* sap, int a, int b) {
+    if ((sap->pair_count + 1) * 2 > sap->pair_capacity &&
+        !pairs_rehash(sap, sap->pair_capacity * 2, NULL)) {
+        return;
+    }
+    pairs_put(sap, pair_key(a, b));
+}
+
+static void pairs_remove(SweepAndPrune* sap, int a, int b) {
+    unsigned long long key = pair_key(a, b);
+    unsigned int mask = (unsigned int)sap->pair_capacity - 1;
+    unsigned int i = pair_hash(key) & mask;
+
+    while (sap->pair_keys[i] != key) {
+        if (sap->pair_keys[i] == SAP_PAIR_EMPTY) return;  // Not in the set
+        i = (i + 1) & mask;
+    }
+
+    // Shift later members of the probe run back so lookups never hit a gap
+    unsigned int j = i;
+    for (;;) {
+        j = (j + 1) & mask;
+        unsigned long long k = sap->pair_keys[j];
+        if (k == SAP_PAIR_EMPTY) break;
+        unsigned int home = pair_hash(k) & mask;
+        int movable = (i <= j) ? (home <= i || home > j) : (home <= i && home > j);
+        if (movable) {
+            sap->pair_keys[i] = k;
+            i = j;
+        }
+    }
+    sap->pair_keys[i] = SAP_PAIR_EMPTY;
+    sap->pair_count--;
+}
+
+// --- ENDPOINTS ---
+
+static inline int proxies_overlap(SweepAndPrune* sap, int a, int b) {
+    SapProxy* pa = &sap->proxies[a];
+    SapProxy* pb = &sap->proxies[b];
+    return aabb_overlap(pa->min_x, pa->min_y, pa->max_x, pa->max_y,
+                        pb->min_x, pb->min_y, pb->max_x, pb->max_y);
+}
+
+// Sort order: by value, and a min before a max at the same value, so touching
+// boxes count as overlapping (same as aabb_overlap)
+static inline int endpoint_after(SapEndpoint a, SapEndpoint b) {
+    return a.value > b.value || (a.value == b.value && (a.data & 1) && !(b.data & 1));
+}
+
+static int endpoint_compare(const void* pa, const void* pb) {
+    const SapEndpoint* a = pa;
+    const SapEndpoint* b = pb;
+    if (a->value < b->value) return -1;
+    if (a->value > b->value) return 1;
+    if ((a->data & 1) != (b->data & 1)) return (a->data & 1) ? 1 : -1;
+    return (a->data > b->data) - (a->data < b->data);  // Deterministic tie-break
+}
+
+static inline float endpoint_value(SapProxy* p, int axis, int is_max) {
+    if (axis == 0) return is_max ? p->max_x : p->min_x;
+    return is_max ? p->max_y : p->min_y;
+}
+
+// Insertion sort of one axis, turning swaps into pair events
+// Returns 0 if the swap budget ran out (the caller does a full rebuild)
+static int sort_axis(SweepAndPrune* sap, int axis) {
+    SapEndpoint* e = sap->axis[axis];
+    int n = sap->sorted_count * 2;
+    long budget = (long)n * SAP_SWAP_BUDGET + 1024;
+
+    for (int i = 1; i < n; i++) {
+        SapEndpoint key = e[i];
+        int j = i - 1;
+
+        while (j >= 0 && endpoint_after(e[j], key)) {
+            if (--budget < 0) {
+                e[j + 1] = key;  // Leave a valid permutation for the rebuild
+                return 0;
+            }
+
+            int a = key.data >> 1;
+            int b = e[j].data >> 1;
+            if (a != b) {
+                if (!(key.data & 1) && (e[j].data & 1)) {
+                    // A min moved below a max: overlapping on this axis now
+                    if (proxies_overlap(sap, a, b)) pairs_add(sap, a, b);
+                } else if ((key.data & 1) && !(e[j].data & 1)) {
+                    // A max moved below a min: separated on this axis
+                    pairs_remove(sap, a, b);
+                }
+            }
+            e[j + 1] = e[j];
+            j--;
+        }
+        e[j + 1] = key;
+    }
+    return 1;
+}
+
+// Sort both axes from scratch and find the overlapping pairs with one x sweep
+static void full_rebuild(SweepAndPrune* sap) {
+    int n = sap->sorted_count * 2;
+    for (int axis = 0; axis < 2; axis++) {
+        qsort(sap->axis[axis], (size_t)n, sizeof(SapEndpoint), endpoint_compare);
+    }
+
+    int capacity = 64;
+    while (capacity < sap->pair_count * 2 && capacity < (1 << 30)) capacity *= 2;
+    if (!pairs_alloc(sap, capacity)) return;
+
+    // Active list: proxies whose x interval is open at the sweep position
+    // (scratch holds the list in [0, sorted_count) and each proxy's slot after it)
+    if (!spatial_grow_buffer((void**)&sap->scratch, &sap->scratch_capacity,
+                             sap->sorted_count * 2, sizeof(int))) {
+        return;
+    }
+    int* active = sap->scratch;
+    int* position = sap->scratch + sap->sorted_count;
+    int active_count = 0;
+
+    SapEndpoint* e = sap->axis[0];
+    for (int i = 0; i < n; i++) {
+        int p = e[i].data >> 1;
+        if (e[i].data & 1) {
+            int at = position[p];
+            active[at] = active[--active_count];
+            position[active[at]] = at;
+            continue;
+        }
+
+        SapProxy* pp = &sap->proxies[p];
+        for (int k = 0; k < active_count; k++) {
+            SapProxy* q = &sap->proxies[active[k]];
+            if (pp->min_y <= q->max_y && q->min_y <= pp->max_y) pairs_add(sap, p, active[k]);
+        }
+        position[p] = active_count;
+        active[active_count++] = p;
+    }
+}
+
+// Drop swept/recycled proxies, keeping the survivors (and their endpoints) in order
+static void sap_sweep(SweepAndPrune* sap) {
+    sap->sweep_pending = 0;
+
+    if (!spatial_grow_buffer((void**)&sap->scratch, &sap->scratch_capacity,
+                             sap->proxy_count, sizeof(int))) {
+        return;
+    }
+    int* remap = sap->scratch;
+
+    int kept = 0;
+    int kept_sorted = 0;
+    for (int k = 0; k < sap->proxy_count; k++) {
+        SapProxy* p = &sap->proxies[k];
+        if (p->dead || p->seen != sap->frame) {
+            int slot = (int)ENTITY_HANDLE_INDEX(p->id);
+            if (sap->proxy_of_slot[slot] == k) sap->proxy_of_slot[slot] = -1;
+            remap[k] = -1;
+            continue;
+        }
+        remap[k] = kept;
+        if (k < sap->sorted_count) kept_sorted++;
+        kept++;
+    }
+    if (kept == sap->proxy_count) return;
+
+    for (int k = 0; k < sap->proxy_count; k++) {
+        if (remap[k] < 0) continue;
+        sap->proxies[remap[k]] = sap->proxies[k];
+        sap->proxy_of_slot[ENTITY_HANDLE_INDEX(sap->proxies[remap[k]].id)] = remap[k];
+    }
+
+    for (int axis = 0; axis < 2; axis++) {
+        SapEndpoint* e = sap->axis[axis];
+        int out = 0;
+        for (int i = 0; i < sap->sorted_count * 2; i++) {
+            int p = remap[e[i].data >> 1];
+            if (p < 0) continue;
+            e[out].value = e[i].value;
+            e[out].data = (p << 1) | (e[i].data & 1);
+            out++;
+        }
+    }
+
+    pairs_rehash(sap, sap->pair_capacity, remap);
+    sap->proxy_count = kept;
+    sap->sorted_count = kept_sorted;
+}
+
+// Bring endpoints and the pair set up to date with the latest inserts
+static void sap_prepare(SweepAndPrune* sap) {
+    if (sap->sweep_pending) sap_sweep(sap);
+    if (!sap->dirty) return;
+    sap->dirty = 0;
+
+    int n = sap->proxy_count * 2;
+    if (!spatial_grow_buffer((void**)&sap->axis[0], &sap->axis_capacity[0], n, sizeof(SapEndpoint)) ||
+        !spatial_grow_buffer((void**)&sap->axis[1], &sap->axis_capacity[1], n, sizeof(SapEndpoint))) {
+        return;
+    }
+
+    // New proxies start at the end of each list and are sorted into place
+    int added = sap->proxy_count - sap->sorted_count;
+    for (int k = sap->sorted_count; k < sap->proxy_count; k++) {
+        for (int axis = 0; axis < 2; axis++) {
+            sap->axis[axis][2 * k].data = k << 1;
+            sap->axis[axis][2 * k + 1].data = (k << 1) | 1;
+        }
+    }
+    sap->sorted_count = sap->proxy_count;
+
+    // Refresh endpoint values in list order (the order itself is last frame's)
+    float max_width = 0.0f;
+    for (int axis = 0; axis < 2; axis++) {
+        SapEndpoint* e = sap->axis[axis];
+        for (int i = 0; i < n; i++) {
+            e[i].value = endpoint_value(&sap->proxies[e[i].data >> 1], axis, e[i].data & 1);
+        }
+    }
+    for (int k = 0; k < sap->proxy_count; k++) {
+        float w = sap->proxies[k].max_x - sap->proxies[k].min_x;
+        if (w > max_width) max_width = w;
+    }
+    sap->max_width = max_width;
+
+    if (added > SAP_REBUILD_NEW || !sort_axis(sap, 0) || !sort_axis(sap, 1)) {
+        full_rebuild(sap);
+    }
+}
+
+// --- BACKEND API ---
+
+int sap_init(SweepAndPrune* sap) {
+    memset(sap, 0, sizeof(*sap));
+    if (!pairs_alloc(sap, 1024)) return 0;
+    sap->frame = 1;
+    return 1;
+}
+
+void sap_free(SweepAndPrune* sap) {
+    free(sap->proxies);
+    free(sap->proxy_of_slot);
+    free(sap->axis[0]);
+    free(sap->axis[1]);
+    free(sap->pair_keys);
+    free(sap->scratch);
+    memset(sap, 0, sizeof(*sap));
+}
+
+void sap_clear(SweepAndPrune* sap) {
+    if (++sap->frame == 0) {
+        // Wrapped: zero every mark so none can match the new frame
+        for (int k = 0; k < sap->proxy_count; k++) sap->proxies[k].seen = 0;
+        sap->frame = 1;
+    }
+    sap->sweep_pending = 1;
+    sap->dirty = 1;
+    sap->moved = 0;
+}
+
+void sap_insert(SweepAndPrune* sap, Entity* entity,
+                float min_x, float min_y, float max_x, float max_y) {
+    int slot = (int)ENTITY_HANDLE_INDEX(entity->id);
+
+    if (slot >= sap->slot_capacity) {
+        int old = sap->slot_capacity;
+        if (!spatial_grow_buffer((void**)&sap->proxy_of_slot, &sap->slot_capacity, slot + 1, sizeof(int))) {
+            return;
+        }
+        for (int i = old; i < sap->slot_capacity; i++) sap->proxy_of_slot[i] = -1;
+    }
+
+    int k = sap->proxy_of_slot[slot];
+    if (k >= 0 && sap->proxies[k].id != entity->id) {
+        // Slot was recycled by a different entity: retire the old proxy
+        sap->proxies[k].dead = 1;
+        sap->sweep_pending = 1;
+        k = -1;
+    }
+    if (k < 0) {
+        if (!spatial_grow_buffer((void**)&sap->proxies, &sap->proxy_capacity,
+                                 sap->proxy_count + 1, sizeof(SapProxy))) {
+            return;
+        }
+        k = sap->proxy_count++;
+        sap->proxies[k].id = entity->id;
+        sap->proxies[k].dead = 0;
+        sap->proxy_of_slot[slot] = k;
+    } else {
+        SapProxy* p = &sap->proxies[k];
+        if (p->min_x != min_x || p->min_y != min_y || p->max_x != max_x || p->max_y != max_y) {
+            sap->moved++;
+        }
+    }
+
+    SapProxy* p = &sap->proxies[k];
+    p->entity = entity;
+    p->min_x = min_x;
+    p->min_y = min_y;
+    p->max_x = max_x;
+    p->max_y = max_y;
+    p->layer = entity->collider.layer;
+    p->mask = entity->collider.mask;
+    p->seen = sap->frame;
+    sap->dirty = 1;
+}
+
+void sap_remove(SweepAndPrune* sap, Entity* entity) {
+    int slot = (int)ENTITY_HANDLE_INDEX(entity->id);
+    if (slot >= sap->slot_capacity) return;
+
+    int k = sap->proxy_of_slot[slot];
+    if (k < 0 || sap->proxies[k].id != entity->id) return;
+    sap->proxies[k].dead = 1;
+    sap->sweep_pending = 1;
+}
+
+// Scan min endpoints along x from (min_x - widest proxy) to max_x
+int sap_query(SweepAndPrune* sap, Entity* self,
+              float min_x, float min_y, float max_x, float max_y,
+              Entity** out, int max_out, int* dropped) {
+    sap_prepare(sap);
+
+    SapEndpoint* e = sap->axis[0];
+    int n = sap->sorted_count * 2;
+    float from = min_x - sap->max_width;
+
+    // First endpoint with value >= from
+    int lo = 0, hi = n;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (e[mid].value < from) lo = mid + 1;
+        else hi = mid;
+    }
+
+    int count = 0;
+    for (int i = lo; i < n && e[i].value <= max_x; i++) {
+        if (e[i].data & 1) continue;
+        SapProxy* p = &sap->proxies[e[i].data >> 1];
+        if (p->entity == self) continue;
+        if (!aabb_overlap(min_x, min_y, max_x, max_y, p->min_x, p->min_y, p->max_x, p->max_y)) continue;
+
+        if (count < max_out) {
+            out[count++] = p->entity;
+        } else {
+            (*dropped)++;  // Keep scanning so the caller sees the real shortfall
+        }
+    }
+    return count;
+}
+
+void sap_find_pairs(SweepAndPrune* sap, SpatialPairList* out) {
+    sap_prepare(sap);
+
+    // The set holds every overlapping pair; only the layer filter is left
+    for (int i = 0; i < sap->pair_capacity; i++) {
+        unsigned long long key = sap->pair_keys[i];
+        if (key == SAP_PAIR_EMPTY) continue;
+
+        SapProxy* a = &sap->proxies[key >> 32];
+        SapProxy* b = &sap->proxies[key & 0xFFFFFFFFu];
+        if (!layers_interact(a->layer, a->mask, b->layer, b->mask)) continue;
+        if (!spatial_pair_push(out, a->entity, b->entity)) return;
+    }
+}
+
+void sap_stats(SweepAndPrune* sap, SpatialStats* stats) {
+    sap_prepare(sap);
+
+    stats->total_entities = sap->proxy_count;
+    stats->moved_entities = sap->moved;
+}
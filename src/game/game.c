@@ -76,7 +76,7 @@ void init_game(GameState *state) {
     Entity *player = spawn_sprite(state, tex_boat, 1000, 1000);
     player->casts_shadow = 1;
     player->scale = 0.3f;
-    player->tag = TAG_PLAYER;
+    entity_set_tag(state, player, TAG_PLAYER);
     player->collider.layer = LAYER_PLAYER;
     player->collider.mask = LAYER_WALL | LAYER_ENEMY;
     player->restitution = 0.3f;
@@ -93,7 +93,7 @@ void init_game(GameState *state) {
         barrel->restitution = 1.0f;   // Perfect bounce - no energy loss
         barrel->collider.type = SHAPE_CIRCLE;
         barrel->collider.circle.radius = 16.0f;
-        barrel->tag = TAG_BARREL;
+        entity_set_tag(state, barrel, TAG_BARREL);
         barrel->vel_x = randf(-200, 200);
         barrel->vel_y = randf(-200, 200);
         barrel->collider.layer = LAYER_ENEMY;
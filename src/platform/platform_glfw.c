@@ -5,6 +5,7 @@
 
 #include "../engine/engine.h"
 #include "../engine/input.h"
+#include "../engine/entity.h"
 #include "../engine/resources.h"
 #include "../engine/font.h"
 #include "../engine/profiler.h"
@@ -260,6 +261,8 @@ int main() {
     }
 
     close_game(state);
+    engine_shutdown();
+    entity_shutdown(state);
     free(state);
     font_shutdown();
     resources_shutdown();  // Free all cached resources
@@ -0,0 +1,561 @@
+// test_spatial.c — Spatial index backends vs. brute force
+//
+// Drives each backend through frames of random inserts, moves and removals, the
+// way physics_update does: moving entities are re-inserted after spatial_clear
+// (the ones left out are dropped), statics live in the static layer and go
+// through spatial_insert_static / spatial_update / spatial_remove. Every frame,
+// spatial_find_pairs must report exactly the pairs an O(n^2) AABB check finds,
+// each once, and box/point/segment queries with random masks must return exactly
+// the entities a linear scan finds, and ray/shape casts must hit what a linear
+// scan of exact shape tests hits first. Returns non-zero on any mismatch.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "spatial.h"
+
+#define WORLD 2048.0f
+#define ENTITY_COUNT 600
+#define FRAME_COUNT 60
+
+static unsigned int g_rng = 12345;
+
+static float test_randf(float min, float max) {
+    g_rng ^= g_rng << 13;
+    g_rng ^= g_rng >> 17;
+    g_rng ^= g_rng << 5;
+    return min + (float)(g_rng >> 8) / 16777216.0f * (max - min);
+}
+
+static int test_chance(float p) {
+    return test_randf(0.0f, 1.0f) < p;
+}
+
+// --- TEST WORLD ---
+// Mixed sizes (mostly small, some large, a few bigger than any grid cell), circles
+// and rects, three layers with random masks
+
+typedef struct {
+    Entity entities[ENTITY_COUNT];
+    int alive[ENTITY_COUNT];
+    int is_static[ENTITY_COUNT];
+    unsigned int generation[ENTITY_COUNT];
+} TestWorld;
+
+static void entity_bounds(const Entity* e, float* min_x, float* min_y, float* max_x, float* max_y) {
+    float cx = e->x + e->collider.offset_x;
+    float cy = e->y + e->collider.offset_y;
+    float hw, hh;
+    if (e->collider.type == SHAPE_CIRCLE) {
+        hw = hh = e->collider.circle.radius;
+    } else {
+        hw = e->collider.rect.width / 2.0f;
+        hh = e->collider.rect.height / 2.0f;
+    }
+    *min_x = cx - hw;
+    *min_y = cy - hh;
+    *max_x = cx + hw;
+    *max_y = cy + hh;
+}
+
+static float random_size(void) {
+    float p = test_randf(0.0f, 1.0f);
+    if (p < 0.80f) return test_randf(2.0f, 12.0f);
+    if (p < 0.96f) return test_randf(12.0f, 70.0f);
+    return test_randf(70.0f, 300.0f);
+}
+
+// New entity in slot i (a fresh generation, so a recycled slot gets a new handle)
+static void spawn(TestWorld* w, int i, int is_static) {
+    Entity* e = &w->entities[i];
+    memset(e, 0, sizeof(Entity));
+    e->id = ENTITY_MAKE_HANDLE(i, ++w->generation[i]);
+    e->active = 1;
+    e->x = test_randf(0.0f, WORLD);
+    e->y = test_randf(0.0f, WORLD);
+
+    e->collider.active = 1;
+    if (test_chance(0.5f)) {
+        e->collider.type = SHAPE_CIRCLE;
+        e->collider.circle.radius = random_size() / 2.0f;
+    } else {
+        e->collider.type = SHAPE_RECT;
+        e->collider.rect.width = random_size();
+        e->collider.rect.height = test_chance(0.2f) ? random_size() * 4.0f : random_size();
+    }
+    if (test_chance(0.2f)) {
+        e->collider.offset_x = test_randf(-8.0f, 8.0f);
+        e->collider.offset_y = test_randf(-8.0f, 8.0f);
+    }
+    e->collider.layer = 1u << (int)test_randf(0.0f, 2.99f);
+    e->collider.mask = (uint32_t)test_randf(0.0f, 7.99f);
+
+    w->alive[i] = 1;
+    w->is_static[i] = is_static;
+}
+
+static void kill(TestWorld* w, int i) {
+    w->entities[i].active = 0;
+    w->alive[i] = 0;
+}
+
+// One frame of changes. Statics are kept in the index as they change; moving
+// entities are only re-inserted afterwards (see run_frames)
+static void mutate(TestWorld* w, SpatialIndex* index) {
+    for (int i = 0; i < ENTITY_COUNT; i++) {
+        Entity* e = &w->entities[i];
+
+        if (!w->alive[i]) {
+            if (!test_chance(0.05f)) continue;
+            spawn(w, i, test_chance(0.3f));
+            if (w->is_static[i]) spatial_insert_static(index, e);
+            continue;
+        }
+
+        if (test_chance(0.03f)) {
+            kill(w, i);
+            // Moving ones are dropped by not being re-inserted; some get removed now
+            if (w->is_static[i] || test_chance(0.5f)) spatial_remove(index, e);
+            continue;
+        }
+
+        if (w->is_static[i]) {
+            if (!test_chance(0.05f)) continue;
+            if (test_chance(0.5f)) {
+                e->x = test_randf(0.0f, WORLD);
+            } else {
+                e->collider.layer = 1u << (int)test_randf(0.0f, 2.99f);
+            }
+            spatial_update(index, e);
+            continue;
+        }
+
+        // Mostly small steps (frame coherence), now and then a jump
+        if (test_chance(0.05f)) {
+            e->x = test_randf(0.0f, WORLD);
+            e->y = test_randf(0.0f, WORLD);
+        } else {
+            e->x += test_randf(-6.0f, 6.0f);
+            e->y += test_randf(-6.0f, 6.0f);
+            if (e->x < 0.0f) e->x = 0.0f;
+            if (e->x > WORLD) e->x = WORLD;
+            if (e->y < 0.0f) e->y = 0.0f;
+            if (e->y > WORLD) e->y = WORLD;
+        }
+    }
+}
+
+// --- PAIRS ---
+
+static int compare_ints(const void* a, const void* b) {
+    int x = *(const int*)a, y = *(const int*)b;
+    return (x > y) - (x < y);
+}
+
+static int overlap(const Entity* a, const Entity* b) {
+    float a0x, a0y, a1x, a1y, b0x, b0y, b1x, b1y;
+    entity_bounds(a, &a0x, &a0y, &a1x, &a1y);
+    entity_bounds(b, &b0x, &b0y, &b1x, &b1y);
+    return a0x <= b1x && b0x <= a1x && a0y <= b1y && b0y <= a1y;
+}
+
+static int check_pairs(TestWorld* w, SpatialIndex* index, SpatialPairList* pairs, const char* name, int frame) {
+    static int want[ENTITY_COUNT * ENTITY_COUNT / 2];
+    static int got[ENTITY_COUNT * ENTITY_COUNT / 2];
+    int want_count = 0;
+
+    for (int i = 0; i < ENTITY_COUNT; i++) {
+        if (!w->alive[i]) continue;
+        const Entity* a = &w->entities[i];
+        for (int j = i + 1; j < ENTITY_COUNT; j++) {
+            if (!w->alive[j] || (w->is_static[i] && w->is_static[j])) continue;
+            const Entity* b = &w->entities[j];
+            if (!(a->collider.mask & b->collider.layer) && !(b->collider.mask & a->collider.layer)) continue;
+            if (overlap(a, b)) want[want_count++] = i * ENTITY_COUNT + j;
+        }
+    }
+
+    int n = spatial_find_pairs(index, pairs);
+    for (int k = 0; k < n; k++) {
+        int a = (int)(pairs->pairs[k].a - w->entities);
+        int b = (int)(pairs->pairs[k].b - w->entities);
+        if (!w->alive[a] || !w->alive[b]) {
+            printf("FAIL %s frame %d: pair with a removed entity (%d, %d)\n", name, frame, a, b);
+            return 1;
+        }
+        if (w->is_static[a]) {
+            printf("FAIL %s frame %d: static entity %d reported as 'a'\n", name, frame, a);
+            return 1;
+        }
+        got[k] = a < b ? a * ENTITY_COUNT + b : b * ENTITY_COUNT + a;
+    }
+
+    qsort(want, (size_t)want_count, sizeof(int), compare_ints);
+    qsort(got, (size_t)n, sizeof(int), compare_ints);
+    for (int k = 1; k < n; k++) {
+        if (got[k] == got[k - 1]) {
+            printf("FAIL %s frame %d: pair (%d, %d) reported twice\n", name, frame,
+                   got[k] / ENTITY_COUNT, got[k] % ENTITY_COUNT);
+            return 1;
+        }
+    }
+    if (n != want_count || memcmp(got, want, (size_t)n * sizeof(int)) != 0) {
+        printf("FAIL %s frame %d: %d pairs, brute force finds %d\n", name, frame, n, want_count);
+        return 1;
+    }
+    return 0;
+}
+
+// --- REGION QUERIES ---
+
+#define QUERIES_PER_FRAME 40
+
+static uint32_t random_mask(void) {
+    return test_chance(0.5f) ? ~0u : (uint32_t)test_randf(0.0f, 7.99f);
+}
+
+// Same slab test the index uses, so borderline touches agree
+static int segment_touches(float x0, float y0, float x1, float y1, const Entity* e) {
+    float min_x, min_y, max_x, max_y;
+    entity_bounds(e, &min_x, &min_y, &max_x, &max_y);
+    float d[2] = { x1 - x0, y1 - y0 };
+    float p[2] = { x0, y0 };
+    float lo[2] = { min_x, min_y }, hi[2] = { max_x, max_y };
+    float t_min = 0.0f, t_max = 1.0f;
+    for (int axis = 0; axis < 2; axis++) {
+        if (d[axis] != 0.0f) {
+            float inv = 1.0f / d[axis];
+            float t1 = (lo[axis] - p[axis]) * inv, t2 = (hi[axis] - p[axis]) * inv;
+            if (t1 > t2) { float t = t1; t1 = t2; t2 = t; }
+            if (t1 > t_min) t_min = t1;
+            if (t2 < t_max) t_max = t2;
+        } else if (p[axis] < lo[axis] || p[axis] > hi[axis]) {
+            return 0;
+        }
+    }
+    return t_min <= t_max;
+}
+
+// kind: 0 = box, 1 = point, 2 = segment
+static int check_region(TestWorld* w, SpatialIndex* index, int kind, const char* name, int frame) {
+    static const char* kinds[3] = { "box", "point", "segment" };
+    static Entity* out[ENTITY_COUNT * 2];
+    static int want[ENTITY_COUNT];
+    static int got[ENTITY_COUNT * 2];
+
+    float x0 = test_randf(-100.0f, WORLD + 100.0f);
+    float y0 = test_randf(-100.0f, WORLD + 100.0f);
+    float x1 = x0, y1 = y0;
+    if (kind == 0) {
+        x1 = x0 + test_randf(0.0f, 400.0f);
+        y1 = y0 + test_randf(0.0f, 400.0f);
+    } else if (kind == 2) {
+        // Some axis-aligned, some across most of the world
+        float len = test_chance(0.2f) ? WORLD : 300.0f;
+        if (!test_chance(0.1f)) x1 = x0 + test_randf(-len, len);
+        if (!test_chance(0.1f)) y1 = y0 + test_randf(-len, len);
+    }
+    uint32_t mask = random_mask();
+
+    int want_count = 0;
+    for (int i = 0; i < ENTITY_COUNT; i++) {
+        if (!w->alive[i]) continue;
+        const Entity* e = &w->entities[i];
+        if (mask != ~0u && !(e->collider.layer & mask)) continue;
+        int hit;
+        if (kind == 2) {
+            hit = segment_touches(x0, y0, x1, y1, e);
+        } else {
+            float min_x, min_y, max_x, max_y;
+            entity_bounds(e, &min_x, &min_y, &max_x, &max_y);
+            hit = x0 <= max_x && min_x <= x1 && y0 <= max_y && min_y <= y1;
+        }
+        if (hit) want[want_count++] = i;
+    }
+
+    int n;
+    if (kind == 0) {
+        n = spatial_query_box(index, x0, y0, x1, y1, mask, out, ENTITY_COUNT * 2);
+    } else if (kind == 1) {
+        n = spatial_query_point(index, x0, y0, mask, out, ENTITY_COUNT * 2);
+    } else {
+        n = spatial_query_segment(index, x0, y0, x1, y1, mask, out, ENTITY_COUNT * 2);
+    }
+    for (int k = 0; k < n; k++) got[k] = (int)(out[k] - w->entities);
+
+    qsort(got, (size_t)n, sizeof(int), compare_ints);
+    for (int k = 1; k < n; k++) {
+        if (got[k] == got[k - 1]) {
+            printf("FAIL %s frame %d: %s query reported %d twice\n", name, frame, kinds[kind], got[k]);
+            return 1;
+        }
+    }
+    if (n != want_count || memcmp(got, want, (size_t)n * sizeof(int)) != 0) {
+        printf("FAIL %s frame %d: %s query (%.1f, %.1f)-(%.1f, %.1f) mask %x found %d, brute force %d\n",
+               name, frame, kinds[kind], x0, y0, x1, y1, (unsigned int)mask, n, want_count);
+        return 1;
+    }
+    return 0;
+}
+
+static int check_regions(TestWorld* w, SpatialIndex* index, const char* name, int frame) {
+    for (int q = 0; q < QUERIES_PER_FRAME; q++) {
+        if (check_region(w, index, q % 3, name, frame)) return 1;
+    }
+    return 0;
+}
+
+// --- RAY AND SHAPE CASTS ---
+// Reference: for each entity, the first t at which the cast's circle touches its
+// collider, in doubles. A rect grown by r is the union of two boxes (grown along x
+// and along y) and four corner circles; the start is outside all of them, so the
+// earliest entry into any one is the answer. Tangent hits are fragile in floats, so
+// the index only has to agree with the colliders grown and shrunk by CAST_EPSILON
+
+#define CASTS_PER_FRAME 30
+#define CAST_EPSILON 1e-3
+#define CAST_TOLERANCE 1e-4
+#define CAST_MISS 2.0
+
+// First t in [0, 1] at which (x0, y0) + t * (dx, dy) is within r of (cx, cy), from outside
+static double ref_circle(double x0, double y0, double dx, double dy, double cx, double cy, double r) {
+    double mx = x0 - cx, my = y0 - cy;
+    double a = dx * dx + dy * dy;
+    double b = mx * dx + my * dy;
+    double c = mx * mx + my * my - r * r;
+    double disc = b * b - a * c;
+    if (r <= 0.0 || c < 0.0 || disc < 0.0) return CAST_MISS;
+    double t = (-b - sqrt(disc)) / a;
+    return (t >= 0.0 && t <= 1.0) ? t : CAST_MISS;
+}
+
+static double ref_box(double x0, double y0, double dx, double dy,
+                      double min_x, double min_y, double max_x, double max_y) {
+    double t_enter = 0.0, t_exit = 1.0;
+    double p[2] = { x0, y0 }, d[2] = { dx, dy };
+    double lo[2] = { min_x, min_y }, hi[2] = { max_x, max_y };
+    for (int axis = 0; axis < 2; axis++) {
+        if (d[axis] == 0.0) {
+            if (p[axis] < lo[axis] || p[axis] > hi[axis]) return CAST_MISS;
+            continue;
+        }
+        double t1 = (lo[axis] - p[axis]) / d[axis], t2 = (hi[axis] - p[axis]) / d[axis];
+        if (t1 > t2) { double t = t1; t1 = t2; t2 = t; }
+        if (t1 > t_enter) t_enter = t1;
+        if (t2 < t_exit) t_exit = t2;
+    }
+    return t_enter <= t_exit ? t_enter : CAST_MISS;
+}
+
+// 'grow' is added to the collider's extents (not to the cast radius)
+static double ref_cast_entity(const Entity* e, double x0, double y0, double x1, double y1,
+                              double radius, double grow) {
+    double cx = (double)e->x + e->collider.offset_x;
+    double cy = (double)e->y + e->collider.offset_y;
+    double dx = x1 - x0, dy = y1 - y0;
+
+    if (e->collider.type == SHAPE_CIRCLE) {
+        double r = e->collider.circle.radius;
+        if ((x0 - cx) * (x0 - cx) + (y0 - cy) * (y0 - cy) < (r + radius) * (r + radius)) return CAST_MISS;
+        return ref_circle(x0, y0, dx, dy, cx, cy, r + grow + radius);
+    }
+
+    double hw = e->collider.rect.width / 2.0, hh = e->collider.rect.height / 2.0;
+    double qx = fmax(fabs(x0 - cx) - hw, 0.0), qy = fmax(fabs(y0 - cy) - hh, 0.0);
+    if ((qx == 0.0 && qy == 0.0) || qx * qx + qy * qy < radius * radius) return CAST_MISS;
+
+    hw += grow;
+    hh += grow;
+    double t = ref_box(x0, y0, dx, dy, cx - hw - radius, cy - hh, cx + hw + radius, cy + hh);
+    double t2 = ref_box(x0, y0, dx, dy, cx - hw, cy - hh - radius, cx + hw, cy + hh + radius);
+    if (t2 < t) t = t2;
+    for (int corner = 0; corner < 4; corner++) {
+        double kx = (corner & 1) ? cx + hw : cx - hw;
+        double ky = (corner & 2) ? cy + hh : cy - hh;
+        double tc = ref_circle(x0, y0, dx, dy, kx, ky, radius);
+        if (tc < t) t = tc;
+    }
+    return t;
+}
+
+static double ref_cast(TestWorld* w, double x0, double y0, double x1, double y1, double radius,
+                       uint32_t mask, double grow) {
+    double best = CAST_MISS;
+    for (int i = 0; i < ENTITY_COUNT; i++) {
+        if (!w->alive[i]) continue;
+        const Entity* e = &w->entities[i];
+        if (mask != ~0u && !(e->collider.layer & mask)) continue;
+        double t = ref_cast_entity(e, x0, y0, x1, y1, radius, grow);
+        if (t < best) best = t;
+    }
+    return best;
+}
+
+// The hit (or miss) must lie between the reference with the colliders grown and
+// shrunk, and so must the entity reported
+static int check_hit(TestWorld* w, const SpatialHit* hit, int was_hit, float x0, float y0, float x1, float y1,
+                     float radius, uint32_t mask, const char* what, const char* name, int frame) {
+    double f = was_hit ? hit->fraction : CAST_MISS;
+    double early = ref_cast(w, x0, y0, x1, y1, radius, mask, CAST_EPSILON);
+    double late = ref_cast(w, x0, y0, x1, y1, radius, mask, -CAST_EPSILON);
+    const char* problem = NULL;
+
+    if (was_hit != (hit->entity != NULL)) {
+        problem = "return value and hit disagree";
+    } else if (f < early - CAST_TOLERANCE || f > late + CAST_TOLERANCE) {
+        problem = was_hit ? "wrong fraction" : "missed";
+    } else if (was_hit) {
+        int i = (int)(hit->entity - w->entities);
+        if (i < 0 || i >= ENTITY_COUNT || !w->alive[i]) {
+            problem = "hit a removed entity";
+        } else if (mask != ~0u && !(hit->entity->collider.layer & mask)) {
+            problem = "hit an entity the mask excludes";
+        } else if (ref_cast_entity(hit->entity, x0, y0, x1, y1, radius, CAST_EPSILON) > f + CAST_TOLERANCE ||
+                   ref_cast_entity(hit->entity, x0, y0, x1, y1, radius, -CAST_EPSILON) < f - CAST_TOLERANCE) {
+            problem = "entity not hit at that fraction";
+        }
+    }
+    if (!problem) return 0;
+
+    printf("FAIL %s frame %d: %s (%.1f, %.1f)-(%.1f, %.1f) r %.2f mask %x: %s (fraction %.5f, brute force %.5f..%.5f)\n",
+           name, frame, what, x0, y0, x1, y1, radius, (unsigned int)mask, problem, f, early, late);
+    return 1;
+}
+
+// Start: anywhere, or an entity's own center (which the cast must skip)
+static void random_cast(TestWorld* w, SpatialRay* ray) {
+    int i = (int)test_randf(0.0f, ENTITY_COUNT - 0.01f);
+    if (w->alive[i] && test_chance(0.3f)) {
+        ray->x0 = w->entities[i].x + w->entities[i].collider.offset_x;
+        ray->y0 = w->entities[i].y + w->entities[i].collider.offset_y;
+    } else {
+        ray->x0 = test_randf(-100.0f, WORLD + 100.0f);
+        ray->y0 = test_randf(-100.0f, WORLD + 100.0f);
+    }
+    float len = test_randf(20.0f, test_chance(0.2f) ? WORLD : 300.0f);
+    float dx, dy;
+    if (test_chance(0.1f)) {
+        // Axis-aligned
+        dx = test_chance(0.5f) ? len : 0.0f;
+        dy = dx == 0.0f ? len : 0.0f;
+        if (test_chance(0.5f)) { dx = -dx; dy = -dy; }
+    } else {
+        float angle = test_randf(0.0f, 6.2831853f);
+        dx = len * cosf(angle);
+        dy = len * sinf(angle);
+    }
+    ray->x1 = ray->x0 + dx;
+    ray->y1 = ray->y0 + dy;
+}
+
+static int check_casts(TestWorld* w, SpatialIndex* index, const char* name, int frame) {
+    SpatialRay rays[CASTS_PER_FRAME];
+    SpatialHit hits[CASTS_PER_FRAME];
+    for (int k = 0; k < CASTS_PER_FRAME; k++) random_cast(w, &rays[k]);
+
+    for (int k = 0; k < CASTS_PER_FRAME; k++) {
+        SpatialRay* r = &rays[k];
+        uint32_t mask = random_mask();
+        SpatialHit hit;
+        int was_hit;
+        if (k % 2 == 0) {
+            was_hit = spatial_raycast(index, r->x0, r->y0, r->x1, r->y1, mask, &hit);
+            if (check_hit(w, &hit, was_hit, r->x0, r->y0, r->x1, r->y1, 0.0f, mask, "raycast", name, frame)) return 1;
+        } else {
+            float radius = test_randf(0.5f, 30.0f);
+            was_hit = spatial_shapecast(index, r->x0, r->y0, r->x1, r->y1, radius, mask, &hit);
+            if (check_hit(w, &hit, was_hit, r->x0, r->y0, r->x1, r->y1, radius, mask, "shapecast", name, frame)) return 1;
+        }
+    }
+
+    uint32_t mask = random_mask();
+    int hit_count = spatial_raycast_batch(index, rays, CASTS_PER_FRAME, mask, hits);
+    int counted = 0;
+    for (int k = 0; k < CASTS_PER_FRAME; k++) {
+        SpatialRay* r = &rays[k];
+        counted += hits[k].entity != NULL;
+        if (check_hit(w, &hits[k], hits[k].entity != NULL, r->x0, r->y0, r->x1, r->y1, 0.0f, mask,
+                      "raycast_batch", name, frame)) {
+            return 1;
+        }
+    }
+    if (counted != hit_count) {
+        printf("FAIL %s frame %d: raycast_batch returned %d, %d rays hit\n", name, frame, hit_count, counted);
+        return 1;
+    }
+    return 0;
+}
+
+// --- BACKENDS ---
+
+static int run_frames(SpatialConfig config, const char* name) {
+    static TestWorld w;
+    memset(&w, 0, sizeof(w));
+    g_rng = 12345;
+
+    SpatialIndex* index = spatial_create(config);
+    if (!index) {
+        printf("FAIL %s: spatial_create\n", name);
+        return 1;
+    }
+    SpatialPairList pairs = {0};
+
+    for (int i = 0; i < ENTITY_COUNT; i++) {
+        if (!test_chance(0.7f)) continue;
+        spawn(&w, i, test_chance(0.3f));
+        if (w.is_static[i]) spatial_insert_static(index, &w.entities[i]);
+    }
+
+    int failed = 0;
+    for (int frame = 0; frame < FRAME_COUNT && !failed; frame++) {
+        spatial_clear(index);
+        mutate(&w, index);
+        for (int i = 0; i < ENTITY_COUNT; i++) {
+            if (w.alive[i] && !w.is_static[i]) spatial_insert(index, &w.entities[i]);
+        }
+        failed = check_pairs(&w, index, &pairs, name, frame) ||
+                 check_regions(&w, index, name, frame) ||
+                 check_casts(&w, index, name, frame);
+    }
+
+    if (!failed) printf("ok   %-24s %d frames\n", name, FRAME_COUNT);
+    spatial_pair_list_free(&pairs);
+    spatial_destroy(index);
+    return failed;
+}
+
+int main(void) {
+    SpatialConfig grid = { .type = SPATIAL_TYPE_GRID, .world_width = WORLD, .world_height = WORLD, .cell_size = 64.0f };
+    SpatialConfig hash = grid;
+    hash.type = SPATIAL_TYPE_HASH;
+    SpatialConfig quadtree = grid;
+    quadtree.type = SPATIAL_TYPE_QUADTREE;
+    SpatialConfig sap = grid;
+    sap.type = SPATIAL_TYPE_SAP;
+    SpatialConfig bvh = grid;
+    bvh.type = SPATIAL_TYPE_BVH;
+    SpatialConfig grid_bvh = grid;
+    grid_bvh.use_static_type = 1;
+    grid_bvh.static_type = SPATIAL_TYPE_BVH;
+    SpatialConfig hgrid = grid;
+    hgrid.type = SPATIAL_TYPE_HGRID;
+    hgrid.cell_size = 0.0f;  // Default smallest level, so the colliders spread over many levels
+    SpatialConfig hgrid8 = hgrid;
+    hgrid8.cell_size = 8.0f;
+
+    int failed = 0;
+    failed += run_frames(grid, "grid");
+    failed += run_frames(hash, "hash");
+    failed += run_frames(quadtree, "quadtree");
+    failed += run_frames(sap, "sap");
+    failed += run_frames(bvh, "bvh");
+    failed += run_frames(grid_bvh, "grid + bvh statics");
+    failed += run_frames(hgrid, "hgrid");
+    failed += run_frames(hgrid8, "hgrid (cell 8)");
+
+    printf(failed ? "%d check(s) FAILED\n" : "All checks passed\n", failed);
+    return failed ? 1 : 0;
+}